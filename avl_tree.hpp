@@ -28,6 +28,9 @@ public:
     typedef typename base::link_type link_type;
     typedef typename base::iterator iterator;
 
+    // 只重写了其中一个重载，其余重载要显式引入，否则会被隐藏
+    using base::insert;
+    using base::remove;
 
     virtual iterator insert(link_type node) {
         link_type &root = base::getRoot();
@@ -35,13 +38,13 @@ public:
         link_type parent = nullptr;
         while (*pos) {
             parent = *pos;
-            if (node->key < (*pos)->key)
+            if (MAP_LESS(this, node->key, (*pos)->key))
                 pos = &((*pos)->left);
-            else if (node->key > (*pos)->key)
+            else if (MAP_LESS(this, (*pos)->key, node->key))
                 pos = &((*pos)->right);
             else {
                 (*pos)->value = node->value;
-                delete node;
+                this->destroy_node(node);
                 return iterator(*pos);
             }
         }
@@ -58,7 +61,7 @@ public:
         if (nullptr == node) return itor;
         ++itor;
         _remove_replace(&root, node, &parent);
-        delete(node);
+        this->destroy_node(node);
         base::dec();
         avl_rebalance(parent);
         return itor;
@@ -68,6 +71,34 @@ public:
         return AVL_TREE;
     }
 
+protected:
+    /* join 的秩就是高度，节点中已经存着 */
+    virtual bool join_rank(link_type root, size_t *rank) const {
+        *rank = join_height(root);
+        return true;
+    }
+
+    virtual size_t child_rank(link_type, size_t, link_type child) const {
+        return join_height(child);
+    }
+
+    /**
+     * Blelloch 等 Just Join for Parallel Ordered Sets 中的 AVL join：
+     * 两边高度差不超过 1 时直接以 k 为根；否则沿较高一侧的边缘下降到高度相当处接上，
+     * 回溯时至多在每层做一次单旋或双旋，代价 O(|h(l) - h(r)| + 1)。
+     */
+    virtual link_type join_node(link_type l, size_t, link_type k, link_type r, size_t, size_t *rank) {
+        link_type t;
+        if (join_height(l) > join_height(r) + 1)
+            t = join_right(l, k, r);
+        else if (join_height(r) > join_height(l) + 1)
+            t = join_left(l, k, r);
+        else
+            t = join_attach(l, k, r);
+        *rank = t->height;
+        return t;
+    }
+
 ////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////
 private:
@@ -94,6 +125,7 @@ private:
         T1   T2     Left Rotation(x)     T2   T3
     */
     link_type avl_right_rotate(link_type y) {
+        MAP_STAT(this, rotations, 1);
         link_type x = y->left;
         link_type T2 = x->right;
         link_type parent = y->parent;
@@ -121,6 +153,7 @@ private:
     }
 
     link_type avl_left_rotate(link_type x) {
+        MAP_STAT(this, rotations, 1);
         link_type y = x->right;
         link_type T2 = y->left;
         link_type parent = x->parent;
@@ -150,8 +183,59 @@ private:
 
 
 
+    /* 以下用于 join，作用在已经摘下的子树上，不碰 root，返回新的子树根 */
+    static size_t join_height(link_type node) {
+        return nullptr == node ? 0 : node->height;
+    }
+
+    static link_type join_attach(link_type l, link_type k, link_type r) {
+        base::__join_attach(l, k, r);
+        k->height = 1 + MAX(join_height(l), join_height(r));
+        return k;
+    }
+
+    static link_type join_rotate_left(link_type x) {
+        link_type y = x->right;
+        return join_attach(join_attach(x->left, x, y->left), y, y->right);
+    }
+
+    static link_type join_rotate_right(link_type y) {
+        link_type x = y->left;
+        return join_attach(x->left, x, join_attach(x->right, y, y->right));
+    }
+
+    /* l 比 r 高 2 以上 */
+    static link_type join_right(link_type l, link_type k, link_type r) {
+        link_type c = l->right;
+        if (join_height(c) <= join_height(r) + 1) {
+            link_type t = join_attach(c, k, r);
+            if (join_height(t) <= join_height(l->left) + 1)
+                return join_attach(l->left, l, t);
+            return join_rotate_left(join_attach(l->left, l, join_rotate_right(t)));
+        }
+        link_type t = join_right(c, k, r);
+        link_type u = join_attach(l->left, l, t);
+        if (join_height(t) <= join_height(l->left) + 1) return u;
+        return join_rotate_left(u);
+    }
+
+    static link_type join_left(link_type l, link_type k, link_type r) {
+        link_type c = r->left;
+        if (join_height(c) <= join_height(l) + 1) {
+            link_type t = join_attach(l, k, c);
+            if (join_height(t) <= join_height(r->right) + 1)
+                return join_attach(t, r, r->right);
+            return join_rotate_right(join_attach(join_rotate_left(t), r, r->right));
+        }
+        link_type t = join_left(l, k, c);
+        link_type u = join_attach(t, r, r->right);
+        if (join_height(t) <= join_height(r->right) + 1) return u;
+        return join_rotate_right(u);
+    }
+
     void avl_rebalance(link_type node) {
         if (nullptr == node) return;
+        MAP_STAT(this, fixups, 1);
         size_t height = avl_update_height(node);
         int factor = avl_balance_factor(node);
 
@@ -14,6 +14,23 @@
 #include "avl_tree.hpp"
 #include "rb_tree.hpp"
 #include "llrb_tree.hpp"
+#include "veb_tree.hpp"
+#include "small_map.hpp"
+#include "flat_map.hpp"
+#include "mmap_tree.hpp"
+#include "serialize.hpp"
+#include "durable_map.hpp"
+#include "sharded_map.hpp"
+#include "rcu_map.hpp"
+#include "persistent_map.hpp"
+#include "concurrent_avl.hpp"
+#include "skiplist.hpp"
+#include "latency.hpp"
+#include "workload.hpp"
+
+#include <thread>
+#include <atomic>
+#include <cmath>
 
 #define TEST_COUNTS  2000000UL
 
@@ -22,53 +39,1010 @@ typedef avl_map<size_t, size_t>  avl_type;
 typedef rbt_map<size_t, size_t>  rbt_type;
 typedef llrb_map<size_t, size_t> llrb_type;
 
-base_type *bst = new base_type(); 
-base_type *avl = new avl_type(); 
-base_type *rbt = new rbt_type(); 
-base_type *llrb = new llrb_type();
-
 size_t *nums = get_rand_array1(TEST_COUNTS);
 
-static void insert(benchmark::State& state) {
-    base_type *ptr = (base_type *)state.range(0);
-    for (auto _ : state)
+/* make benchmark_stats 时，把计时部分的操作计数平摊到每次操作，作为自定义计数器输出 */
+static void report_stats(benchmark::State& state, const map_stats &delta, double ops) {
+#ifdef MAP_STATS
+    state.counters["cmp/op"] = delta.comparisons / ops;
+    state.counters["rot/op"] = delta.rotations / ops;
+    state.counters["recolor/op"] = delta.recolors / ops;
+    state.counters["fixup/op"] = delta.fixups / ops;
+    state.counters["alloc/op"] = delta.allocations / ops;
+    if (delta.lookups)
+        state.counters["visit/find"] = (double)delta.visited / delta.lookups;
+#else
+    (void)state;
+    (void)delta;
+    (void)ops;
+#endif
+}
+
+#ifdef MAP_STATS
+/* after - before，逐个字段相减后累加到 sum */
+static void add_stats(map_stats &sum, const map_stats &before, const map_stats &after) {
+    sum.comparisons += after.comparisons - before.comparisons;
+    sum.rotations += after.rotations - before.rotations;
+    sum.recolors += after.recolors - before.recolors;
+    sum.fixups += after.fixups - before.fixups;
+    sum.lookups += after.lookups - before.lookups;
+    sum.visited += after.visited - before.visited;
+    sum.allocations += after.allocations - before.allocations;
+}
+#endif
+
+/**
+ * insert/find/_delete 的夹具。state.range(0) 为元素个数，从 1K 到 16M 每次乘 4，
+ * 跨过 L1/L2/LLC 和 TLB 的覆盖范围：
+ *   - SetUp() 用固定种子生成 n 个 64 位随机键和一个与插入顺序无关的访问顺序，结果可复现；
+ *   - 每一轮都在暂停计时的状态下新建一棵树，find/_delete 还要先插好全部键，
+ *     计时的只有被测的 n 次操作，轮与轮之间、基准与基准之间互不影响；
+ *   - 输出 items_per_second 和 bytes/entry（树中有 n 个元素时 memory_usage() 的总和，
+ *     含分配器开销，见 memory_usage.hpp）。
+ */
+#define FIXTURE_MIN  (1 << 10)
+#define FIXTURE_MAX  (1 << 24)
+#define FIXTURE_SEED 20210907ULL
+
+enum { OP_INSERT, OP_FIND, OP_DELETE };
+
+template <typename Tree>
+class map_fixture : public benchmark::Fixture {
+public:
+    std::vector<uint64_t> keys, order;
+
+    void SetUp(const benchmark::State& state) override {
+        size_t n = state.range(0);
+        keys = make_keys(KEY_UNIFORM, n, FIXTURE_SEED);
+        order = keys;
+        xoshiro256 rng(FIXTURE_SEED + 1);
+        for (size_t i = n; i > 1; i--)
+            std::swap(order[i - 1], order[rng.below(i)]);
+    }
+
+    void TearDown(const benchmark::State&) override {
+        std::vector<uint64_t>().swap(keys);
+        std::vector<uint64_t>().swap(order);
+    }
+
+    void run(benchmark::State& state, int op) {
+        size_t n = keys.size(), hits = 0;
+        map_stats delta = map_stats();
+        map_memory mem;
+        for (auto _ : state) {
+            state.PauseTiming();
+            Tree *tree = new Tree();
+            if (OP_INSERT != op)
+                for (auto k : keys) tree->insert(k, k);
+#ifdef MAP_STATS
+            map_stats before = tree->stats();
+#endif
+            if (OP_INSERT != op) mem = tree->memory_usage();
+            state.ResumeTiming();
+
+            if (OP_INSERT == op)
+                for (auto k : keys) tree->insert(k, k);
+            else if (OP_FIND == op)
+                for (auto k : order) hits += nullptr != tree->find(k);
+            else
+                for (auto k : order) tree->remove(k);
+
+            state.PauseTiming();
+#ifdef MAP_STATS
+            add_stats(delta, before, tree->stats());
+#endif
+            if (OP_INSERT == op) mem = tree->memory_usage();
+            delete tree;
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(hits);
+        state.SetItemsProcessed(state.iterations() * n);
+        state.counters["bytes/entry"] = n ? (double)mem.total() / n : 0;
+        report_stats(state, delta, (double)state.iterations() * n);
+    }
+};
+
+#define MAP_FIXTURE(name, op, Tree)                                                         \
+    BENCHMARK_TEMPLATE_DEFINE_F(map_fixture, name, Tree)(benchmark::State& state) {         \
+        run(state, op);                                                                     \
+    }                                                                                       \
+    BENCHMARK_REGISTER_F(map_fixture, name)->RangeMultiplier(4)->Range(FIXTURE_MIN, FIXTURE_MAX) \
+        ->Unit(benchmark::kMillisecond)
+
+MAP_FIXTURE(insert_bst, OP_INSERT, base_type);
+MAP_FIXTURE(insert_avl, OP_INSERT, avl_type);
+MAP_FIXTURE(insert_rbt, OP_INSERT, rbt_type);
+MAP_FIXTURE(insert_llrb, OP_INSERT, llrb_type);
+
+MAP_FIXTURE(find_bst, OP_FIND, base_type);
+MAP_FIXTURE(find_avl, OP_FIND, avl_type);
+MAP_FIXTURE(find_rbt, OP_FIND, rbt_type);
+MAP_FIXTURE(find_llrb, OP_FIND, llrb_type);
+
+MAP_FIXTURE(delete_bst, OP_DELETE, base_type);
+MAP_FIXTURE(delete_avl, OP_DELETE, avl_type);
+MAP_FIXTURE(delete_rbt, OP_DELETE, rbt_type);
+MAP_FIXTURE(delete_llrb, OP_DELETE, llrb_type);
+
+
+
+/* 不同规模下随机查找：指针式红黑树、compact 之后的红黑树、vEB 快照 */
+#define SWEEP_MIN    10000L
+#define SWEEP_MAX    100000000L
+
+enum { LAYOUT_RBT, LAYOUT_RBT_COMPACT, LAYOUT_VEB };
+
+template <int layout>
+static void find_sweep(benchmark::State& state) {
+    size_t i, n = state.range(0), hits = 0;
+    size_t *keys = get_rand_array1(n);
+    base_type *tree = new rbt_type();
+    veb_map<size_t, size_t> *veb = nullptr;
+
+    for (i = 0; i < n; i++)
+        tree->insert(keys[i], keys[i]);
+    if (LAYOUT_RBT_COMPACT == layout)
+        tree->compact();
+    if (LAYOUT_VEB == layout) {
+        veb = new veb_map<size_t, size_t>(*tree);
+        delete tree;
+        tree = nullptr;
+    }
+    randomed(keys, n);
+
+    i = 0;
+    if (veb) {
+        for (auto _ : state) {
+            hits += nullptr != veb->find(keys[i]);
+            if (++i == n) i = 0;
+        }
+    } else {
+        for (auto _ : state) {
+            hits += nullptr != tree->find(keys[i]);
+            if (++i == n) i = 0;
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+
+    delete veb;
+    delete tree;
+    drop_random_array(keys);
+}
+
+BENCHMARK_TEMPLATE(find_sweep, LAYOUT_RBT)->RangeMultiplier(10)->Range(SWEEP_MIN, SWEEP_MAX);
+BENCHMARK_TEMPLATE(find_sweep, LAYOUT_RBT_COMPACT)->RangeMultiplier(10)->Range(SWEEP_MIN, SWEEP_MAX);
+BENCHMARK_TEMPLATE(find_sweep, LAYOUT_VEB)->RangeMultiplier(10)->Range(SWEEP_MIN, SWEEP_MAX);
+
+
+
+/* 上百万个只有几个元素的小 map：建立、逐个查找、销毁 */
+#define TINY_MAPS    (1UL << 20)
+
+template <typename Map>
+static void tiny_maps(benchmark::State& state) {
+    size_t entries = state.range(0), hits = 0;
+    size_t *keys = get_rand_array2(TINY_MAPS * entries);
+
+    for (auto _ : state) {
+        Map *maps = new Map[TINY_MAPS];
+        for (size_t m = 0; m < TINY_MAPS; m++)
+            for (size_t i = 0; i < entries; i++)
+                maps[m].insert(keys[m * entries + i], i);
+        for (size_t m = 0; m < TINY_MAPS; m++)
+            for (size_t i = 0; i < entries; i++)
+                hits += nullptr != maps[m].find(keys[m * entries + i]);
+        delete [] maps;
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations() * TINY_MAPS * entries);
+    drop_random_array(keys);
+}
+
+BENCHMARK_TEMPLATE(tiny_maps, rbt_type)->Arg(4)->Arg(8)->Arg(16)->Arg(32);
+BENCHMARK_TEMPLATE(tiny_maps, small_map<size_t, size_t, 16>)->Arg(4)->Arg(8)->Arg(16)->Arg(32);
+
+
+
+/**
+ * 读写混合：map 中保持 MIX_LIVE 个键，写操作按自己的计数轮流插入一个新键或删除最老的键，
+ * 与读写的比例无关，live 集合的大小始终在 MIX_LIVE 和 MIX_LIVE + 1 之间。
+ * state.range(0) 是读操作所占的百分比。
+ */
+#define MIX_LIVE     1000000UL
+
+template <typename Map>
+static void read_write_mix(benchmark::State& state) {
+    size_t reads = state.range(0), total = 2 * MIX_LIVE;
+    size_t lo = 0, hi = MIX_LIVE, op = 0, writes = 0, hits = 0, seed = 1;
+    size_t *keys = get_rand_array1(total);
+    Map *map = new Map();
+
+    for (size_t i = 0; i < MIX_LIVE; i++)
+        map->insert(keys[i], i);
+
+    for (auto _ : state) {
+        if (op++ % 100 < reads) {
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            hits += nullptr != map->find(keys[(lo + (seed >> 33) % MIX_LIVE) % total]);
+        } else if (0 == (writes++ & 1)) {
+            map->insert(keys[hi++ % total], op);
+        } else {
+            map->remove(keys[lo++ % total]);
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+
+    delete map;
+    drop_random_array(keys);
+}
+
+BENCHMARK_TEMPLATE(read_write_mix, rbt_type)->ArgName("read%")->Arg(0)->Arg(50)->Arg(90)->Arg(99);
+BENCHMARK_TEMPLATE(read_write_mix, flat_map<size_t, size_t>)->ArgName("read%")->Arg(0)->Arg(50)->Arg(90)->Arg(99);
+
+
+
+/* 进程重启后恢复 TEST_COUNTS 个元素：重新插入 vs. mmap 已保存的文件 */
+#define STARTUP_FILE "/tmp/bst_map_startup.bin"
+
+static void startup_reinsert(benchmark::State& state) {
+    for (auto _ : state) {
+        rbt_type tree;
+        for (size_t i = 0; i < TEST_COUNTS; i++)
+            tree.insert(nums[i], nums[i]);
+        benchmark::DoNotOptimize(tree.find(nums[0]));
+    }
+}
+
+static void startup_mmap(benchmark::State& state) {
+    rbt_type tree;
     for (size_t i = 0; i < TEST_COUNTS; i++)
-        ptr->insert(nums[i], nums[i]);
+        tree.insert(nums[i], nums[i]);
+    tree.save(STARTUP_FILE);
+
+    for (auto _ : state) {
+        mmap_map<size_t, size_t> file;
+        file.open_mmap(STARTUP_FILE);
+        benchmark::DoNotOptimize(file.find(nums[0]));
+    }
+    unlink(STARTUP_FILE);
 }
 
-BENCHMARK(insert)->ArgName("bst")->Arg((int64_t)bst);
-BENCHMARK(insert)->ArgName("avl")->Arg((int64_t)avl);
-BENCHMARK(insert)->ArgName("rbt")->Arg((int64_t)rbt);
-BENCHMARK(insert)->ArgName("llrb")->Arg((int64_t)llrb);
+BENCHMARK(startup_reinsert)->Unit(benchmark::kMillisecond);
+BENCHMARK(startup_mmap)->Unit(benchmark::kMillisecond);
 
 
-static void find(benchmark::State& state) {
-    base_type *ptr = (base_type *)state.range(0);
-    for (auto _ : state)
+
+/* 流式加载 TEST_COUNTS 个元素，state.range(0) 为 0 时定长差值，1 时变长编码 */
+#define STREAM_FILE "/tmp/bst_map_stream.bin"
+
+static void bulk_load(benchmark::State& state) {
+    rbt_type tree;
+    stream_stats stats = {0, 0, 0};
     for (size_t i = 0; i < TEST_COUNTS; i++)
-        ptr->find(nums[i]);
+        tree.insert(nums[i], nums[i]);
+    stream_save(tree, STREAM_FILE, state.range(0) ? STREAM_VARINT : 0, &stats);
+
+    for (auto _ : state) {
+        rbt_type load;
+        stream_load(load, STREAM_FILE);
+        benchmark::DoNotOptimize(load.find(nums[0]));
+    }
+    state.SetBytesProcessed(state.iterations() * stats.bytes);
+    state.SetItemsProcessed(state.iterations() * TEST_COUNTS);
+    unlink(STREAM_FILE);
+}
+
+BENCHMARK(bulk_load)->ArgName("varint")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+
+
+/* 持续写入吞吐，state.range(0) 为一次 fdatasync 覆盖的操作数 */
+#define DURABLE_FILE "/tmp/bst_map_durable"
+
+static void durable_unlink() {
+    unlink(DURABLE_FILE ".snap");
+    unlink(DURABLE_FILE ".log");
+}
+
+static void durable_write(benchmark::State& state) {
+    size_t i = 0;
+    durable_unlink();
+    durable_map<size_t, size_t> db;
+    db.open(DURABLE_FILE, state.range(0), 0);
+
+    for (auto _ : state) {
+        db.insert(nums[i % TEST_COUNTS], i);
+        i++;
+    }
+    db.sync();
+    state.SetItemsProcessed(state.iterations());
+    db.close();
+    durable_unlink();
+}
+
+/* 恢复 TEST_COUNTS 个元素：一半在快照里，另一半（含覆盖写）在日志里 */
+static void durable_recover(benchmark::State& state) {
+    durable_unlink();
+    {
+        durable_map<size_t, size_t> db;
+        db.open(DURABLE_FILE, 4096, 0);
+        for (size_t i = 0; i < TEST_COUNTS / 2; i++)
+            db.insert(nums[i], i);
+        db.checkpoint();
+        for (size_t i = TEST_COUNTS / 4; i < TEST_COUNTS; i++)
+            db.insert(nums[i], i);
+    }
+
+    stream_stats stats = {0, 0, 0};
+    for (auto _ : state) {
+        durable_map<size_t, size_t> db;
+        db.open(DURABLE_FILE, 4096, 0, &stats);
+        benchmark::DoNotOptimize(db.find(nums[0]));
+    }
+    state.SetBytesProcessed(state.iterations() * stats.bytes);
+    state.SetItemsProcessed(state.iterations() * stats.records);
+    durable_unlink();
+}
+
+BENCHMARK(durable_write)->ArgName("group")->Arg(1)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(durable_recover)->Unit(benchmark::kMillisecond);
+
+
+
+/**
+ * 多线程 90% 查找、10% 插入删除，state.range(0) 为分片数，
+ * 1 个分片相当于整个 rbt_map 外面套一把全局锁。
+ */
+#define SHARD_LIVE 1000000UL
+
+static sharded_map<size_t, size_t> *shared_map = nullptr;
+
+static void sharded_mix(benchmark::State& state) {
+    if (0 == state.thread_index()) {
+        shared_map = new sharded_map<size_t, size_t>(state.range(0));
+        for (size_t i = 0; i < SHARD_LIVE; i++)
+            shared_map->insert(nums[i], i);
+    }
+
+    size_t seed = state.thread_index() + 1, op = 0, writes = 0, hits = 0;
+    for (auto _ : state) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        size_t key = nums[(seed >> 33) % TEST_COUNTS];
+        if (op++ % 10)
+            hits += shared_map->find(key);
+        else if (0 == (writes++ & 1))     /* 写操作单独计数，插入、删除交替 */
+            shared_map->insert(key, op);
+        else
+            shared_map->remove(key);
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+
+    if (0 == state.thread_index()) {
+        delete shared_map;
+        shared_map = nullptr;
+    }
+}
+
+BENCHMARK(sharded_mix)->ArgName("shards")->Arg(1)->Arg(SHARD_DEFAULT)->ThreadRange(1, 8)->UseRealTime();
+
+
+
+/**
+ * 一个写者以固定速率 RCU_WRITE_RATE 次/秒删除再插回随机键，读者线程无锁查找，
+ * 读者总吞吐应随线程数（核数）线性增长。
+ */
+#define RCU_WRITE_RATE 20000
+
+static rcu_rbt_map<size_t, size_t> *rcu_tree = nullptr;
+static std::atomic<bool> rcu_stop(false);
+static std::thread rcu_writer;
+
+static void rcu_readers(benchmark::State& state) {
+    if (0 == state.thread_index()) {
+        rcu_tree = new rcu_rbt_map<size_t, size_t>();
+        for (size_t i = 0; i < SHARD_LIVE; i++)
+            rcu_tree->insert(nums[i], i);
+        rcu_stop = false;
+        rcu_writer = std::thread([]() {
+            auto period = std::chrono::nanoseconds(1000000000 / RCU_WRITE_RATE);
+            auto next = std::chrono::steady_clock::now();
+            size_t seed = 7;
+            while (!rcu_stop.load(std::memory_order_relaxed)) {
+                seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+                size_t i = (seed >> 33) % SHARD_LIVE;
+                rcu_tree->remove(nums[i]);
+                rcu_tree->insert(nums[i], i);
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+        });
+    }
+
+    size_t seed = state.thread_index() + 1, hits = 0;
+    for (auto _ : state) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        hits += rcu_tree->lookup(nums[(seed >> 33) % SHARD_LIVE]);
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+
+    if (0 == state.thread_index()) {
+        rcu_stop = true;
+        rcu_writer.join();
+        delete rcu_tree;
+        rcu_tree = nullptr;
+    }
+}
+
+BENCHMARK(rcu_readers)->ThreadRange(1, 8)->UseRealTime();
+
+
+
+/**
+ * 写放大：SHARD_LIVE 个元素上反复删除再插回随机键。
+ * state.range(0) 为重新拍快照的间隔，0 表示没有快照，持有快照时路径上的节点都要复制。
+ */
+static void persistent_write(benchmark::State& state) {
+    persistent_map<size_t, size_t> map;
+    persistent_map<size_t, size_t>::snapshot snap;
+    size_t every = state.range(0), op = 0, seed = 1;
+    for (size_t i = 0; i < SHARD_LIVE; i++)
+        map.insert(nums[i], i);
+    map.copies = 0;
+
+    for (auto _ : state) {
+        if (every && op % every == 0) snap = map.snap();
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        size_t i = (seed >> 33) % SHARD_LIVE;
+        map.remove(nums[i]);
+        map.insert(nums[i], op++);
+    }
+    state.counters["copies/op"] = (double)map.copies / state.iterations();
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void mutable_write(benchmark::State& state) {
+    rbt_type map;
+    size_t op = 0, seed = 1;
+    for (size_t i = 0; i < SHARD_LIVE; i++)
+        map.insert(nums[i], i);
+
+    for (auto _ : state) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        size_t i = (seed >> 33) % SHARD_LIVE;
+        map.remove(nums[i]);
+        map.insert(nums[i], op++);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(mutable_write);
+BENCHMARK(persistent_write)->ArgName("snap_every")->Arg(0)->Arg(1000)->Arg(1);
+
+/* 完整扫描一个快照，每轮扫描之间写入 SNAP_WRITES 次，快照与当前版本逐渐分叉 */
+#define SNAP_WRITES 10000
+
+static void snapshot_scan(benchmark::State& state) {
+    persistent_map<size_t, size_t> map;
+    size_t op = 0, sum = 0;
+    for (size_t i = 0; i < SHARD_LIVE; i++)
+        map.insert(nums[i], i);
+
+    for (auto _ : state) {
+        auto snap = map.snap();
+        state.PauseTiming();
+        for (size_t i = 0; i < SNAP_WRITES; i++, op++)
+            map.insert(nums[op % SHARD_LIVE], op);
+        state.ResumeTiming();
+        for (auto i = snap.begin(); i != snap.end(); ++i)
+            sum += *i;
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * SHARD_LIVE);
+}
+
+BENCHMARK(snapshot_scan)->Unit(benchmark::kMillisecond);
+
+
+
+/* workload.hpp 的 Zipfian 名次再经 nums 映射成键，热点散落在整个键空间里 */
+static const zipf_gen &zipf() {
+    static zipf_gen z(TEST_COUNTS);
+    return z;
+}
+
+/**
+ * 多线程 90% 查找、10% 插入删除，state.range(0) 为 0 时键均匀分布，为 1 时服从 Zipfian。
+ * 对比细粒度的 concurrent_avl_map 和按哈希分片、每片一把读写锁的 sharded_map，
+ * Zipfian 下热点集中在少数几片上，分片锁的争用更明显。
+ */
+template <typename Map>
+static Map *mix_map = nullptr;
+
+template <typename Map>
+static void concurrent_mix(benchmark::State& state) {
+    const zipf_gen &z = zipf();
+    bool skewed = state.range(0);
+    if (0 == state.thread_index()) {
+        mix_map<Map> = new Map();
+        for (size_t i = 0; i < SHARD_LIVE; i++)
+            mix_map<Map>->insert(nums[i], i);
+    }
+
+    size_t seed = state.thread_index() + 1, op = 0, writes = 0, hits = 0;
+    for (auto _ : state) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        size_t rank = skewed ? z((seed >> 11) * 0x1.0p-53) : (seed >> 33) % TEST_COUNTS;
+        size_t key = nums[rank];
+        if (op++ % 10)
+            hits += mix_map<Map>->find(key);
+        else if (0 == (writes++ & 1))     /* 写操作单独计数，插入、删除交替 */
+            mix_map<Map>->insert(key, op);
+        else
+            mix_map<Map>->remove(key);
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+
+    if (0 == state.thread_index()) {
+        delete mix_map<Map>;
+        mix_map<Map> = nullptr;
+    }
+}
+
+BENCHMARK_TEMPLATE(concurrent_mix, concurrent_avl_map<size_t, size_t>)
+    ->ArgName("zipf")->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(concurrent_mix, sharded_map<size_t, size_t>)
+    ->ArgName("zipf")->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
+
+/**
+ * 单线程：插入 SHARD_LIVE 个随机键、逐个查找、再逐个删除，对比 skiplist_map 与 rbt_map，
+ * bytes/entry 为 memory_usage() 的总和，含分配器开销。多线程对比见 concurrent_mix。
+ */
+
+template <typename Map>
+static void ordered_ops(benchmark::State& state) {
+    size_t hits = 0, bytes = 0;
+    for (auto _ : state) {
+        Map map;
+        for (size_t i = 0; i < SHARD_LIVE; i++)
+            map.insert(nums[i], i);
+        bytes = map.memory_usage().total();
+        for (size_t i = 0; i < SHARD_LIVE; i++)
+            hits += map.find(nums[i]) ? 1 : 0;
+        for (size_t i = 0; i < SHARD_LIVE; i++)
+            map.remove(nums[i]);
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations() * SHARD_LIVE * 3);
+    state.counters["bytes/entry"] = (double)bytes / SHARD_LIVE;
 }
 
-BENCHMARK(find)->ArgName("bst")->Arg((int64_t)bst);
-BENCHMARK(find)->ArgName("avl")->Arg((int64_t)avl);
-BENCHMARK(find)->ArgName("rbt")->Arg((int64_t)rbt);
-BENCHMARK(find)->ArgName("llrb")->Arg((int64_t)llrb);
+BENCHMARK_TEMPLATE(ordered_ops, rbt_type)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ordered_ops, skiplist_map<size_t, size_t>)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(concurrent_mix, skiplist_map<size_t, size_t>)
+    ->ArgName("zipf")->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
+
+/**
+ * 由 get_rand_array1() 的 BUILD_COUNTS 个乱序键并行建树，state.range(0) 为建树线程数，
+ * 包括排序、去重和连接，不含释放。
+ */
+#define BUILD_COUNTS 20000000UL
+
+template <typename Tree>
+static void parallel_build(benchmark::State& state) {
+    static size_t *keys = get_rand_array1(BUILD_COUNTS);
+    size_t threads = state.range(0);
+    for (auto _ : state) {
+        Tree *tree = new Tree();
+        tree->assign_parallel(keys, keys, BUILD_COUNTS, threads);
+        state.PauseTiming();
+        assert(tree->size == BUILD_COUNTS);
+        delete tree;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * BUILD_COUNTS);
+}
+
+BENCHMARK_TEMPLATE(parallel_build, rbt_type)->ArgName("threads")->RangeMultiplier(2)->Range(1, 16)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(parallel_build, avl_type)->ArgName("threads")->RangeMultiplier(2)->Range(1, 16)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * 对 REDUCE_COUNTS 个元素的树求值的和，state.range(0) 为线程池中的工作线程数，0 表示调用者顺序迭代。
+ * 池在计时之外建好，计的是切分、分发、遍历和按序合并。
+ */
+#define REDUCE_COUNTS 4000000UL
+
+template <typename Tree>
+static void parallel_reduce(benchmark::State& state) {
+    static Tree *tree = nullptr;
+    if (nullptr == tree) {
+        size_t *keys = get_rand_array1(REDUCE_COUNTS);
+        tree = new Tree();
+        tree->assign_parallel(keys, keys, REDUCE_COUNTS, 1);
+        drop_random_array(keys);
+    }
+    size_t workers = state.range(0);
+    std::unique_ptr<thread_pool> pool(workers ? new thread_pool(workers) : nullptr);
+    auto value = [](const size_t &, size_t &v) { return v; };
+    auto add = [](size_t a, size_t b) { return a + b; };
+    for (auto _ : state) {
+        size_t sum = 0;
+        if (pool)
+            sum = tree->parallel_reduce((size_t)0, value, add, *pool);
+        else
+            for (auto it = tree->begin(); it != tree->end(); ++it) sum += *it;
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * REDUCE_COUNTS);
+}
+
+BENCHMARK_TEMPLATE(parallel_reduce, rbt_type)->ArgName("workers")->Arg(0)->RangeMultiplier(2)->Range(1, 8)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * BATCH_TREE 个元素的树上，先插入 BATCH_SIZE 个新键，再把它们删掉，树回到原样。
+ * state.range(0) 为 apply_batch() 的线程数，0 表示逐条 insert/remove。
+ */
+#define BATCH_TREE 1000000UL
+#define BATCH_SIZE 100000UL
+
+template <typename Tree>
+static void batch_apply(benchmark::State& state) {
+    static size_t *keys = get_rand_array1(BATCH_TREE + BATCH_SIZE);
+    size_t threads = state.range(0);
+    Tree tree;
+    tree.assign_parallel(keys, keys, BATCH_TREE, 1);
+
+    std::vector<typename Tree::update_type> inserts, erases;
+    for (size_t i = BATCH_TREE; i < BATCH_TREE + BATCH_SIZE; i++) {
+        inserts.push_back({keys[i], keys[i], false});
+        erases.push_back({keys[i], 0, true});
+    }
+    for (auto _ : state) {
+        if (threads) {
+            tree.apply_batch(inserts, threads);
+            tree.apply_batch(erases, threads);
+        } else {
+            for (auto &u : inserts) tree.insert(u.key, u.value);
+            for (auto &u : erases) tree.remove(u.key);
+        }
+    }
+    assert(tree.size == BATCH_TREE);
+    state.SetItemsProcessed(state.iterations() * BATCH_SIZE * 2);
+}
+
+BENCHMARK_TEMPLATE(batch_apply, rbt_type)->ArgName("threads")->Arg(0)->RangeMultiplier(2)->Range(1, 8)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(batch_apply, avl_type)->ArgName("threads")->Arg(0)->RangeMultiplier(2)->Range(1, 8)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * 任务调度的开销，用来确定各个并行算法的粒度下限。state.range(0) 为工作线程数。
+ * task_spawn：调用者一次 spawn SPAWN_TASKS 个空任务再 sync，全部经注入队列，计的是单个任务的往返开销；
+ * task_fib：嵌套 fork/join 求 fib(FIB_N)，n 小于 state.range(1) 时顺序计算，
+ * 计数器 steals 为被偷走的任务占 spawn 总数的比例。
+ */
+#define SPAWN_TASKS 10000
+#define FIB_N       27
+
+static void task_spawn(benchmark::State& state) {
+    thread_pool pool(state.range(0));
+    for (auto _ : state) {
+        task_group group(pool);
+        for (size_t i = 0; i < SPAWN_TASKS; i++)
+            group.spawn([]() {});
+        group.sync();
+    }
+    state.SetItemsProcessed(state.iterations() * SPAWN_TASKS);
+}
 
+static size_t bench_fib(thread_pool &pool, size_t n, size_t cutoff) {
+    if (n < 2) return n;
+    if (n < cutoff) return bench_fib(pool, n - 1, cutoff) + bench_fib(pool, n - 2, cutoff);
+    size_t a, b;
+    task_group group(pool);
+    group.spawn([&]() { a = bench_fib(pool, n - 1, cutoff); });
+    b = bench_fib(pool, n - 2, cutoff);
+    group.sync();
+    return a + b;
+}
 
+/* bench_fib() 中 spawn 的次数 */
+static size_t fib_spawns(size_t n, size_t cutoff) {
+    if (n < 2 || n < cutoff) return 0;
+    return 1 + fib_spawns(n - 1, cutoff) + fib_spawns(n - 2, cutoff);
+}
 
-static void _delete(benchmark::State& state) {
-    base_type *ptr = (base_type *)state.range(0);
+static void task_fib(benchmark::State& state) {
+    thread_pool pool(state.range(0));
+    size_t cutoff = state.range(1), steals = pool.steals();
     for (auto _ : state)
-    for (size_t i = 0; i < TEST_COUNTS; i++)
-        ptr->remove(nums[i]);
+        benchmark::DoNotOptimize(bench_fib(pool, FIB_N, cutoff));
+    size_t spawns = state.iterations() * fib_spawns(FIB_N, cutoff);
+    state.SetItemsProcessed(spawns);
+    state.counters["steals"] = (double)(pool.steals() - steals) / spawns;
+}
+
+BENCHMARK(task_spawn)->ArgName("workers")->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+BENCHMARK(task_fib)->ArgNames({"workers", "cutoff"})->ArgsProduct({{1, 2, 4, 8}, {2, 12, 18}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+/**
+ * 尾延迟：逐次计时单个操作，把 p50/p90/p99/p99.9/max（纳秒）作为计数器输出。
+ * state.range(0) 为操作：0 insert、1 find、2 remove；每一轮从新建的表开始，
+ * find/remove 之前先插入全部键，准备工作不计时，查找和删除的顺序与插入无关。
+ * 计时本身约几十纳秒，计入每个样本；一轮就有 LATENCY_COUNTS 个样本，只跑一轮。
+ */
+#define LATENCY_COUNTS 1000000UL
+
+static size_t *latency_order = get_rand_array1(LATENCY_COUNTS);
+
+template <typename Map>
+static void op_latency(benchmark::State& state) {
+    int op = state.range(0);
+    latency_histogram hist;
+    for (auto _ : state) {
+        state.PauseTiming();
+        Map *map = new Map();
+        if (op)
+            for (size_t i = 0; i < LATENCY_COUNTS; i++)
+                map->insert(nums[i], nums[i]);
+        state.ResumeTiming();
+
+        for (size_t i = 0; i < LATENCY_COUNTS; i++) {
+            uint64_t tic = latency_now();
+            if (0 == op)
+                map->insert(nums[i], nums[i]);
+            else if (1 == op)
+                benchmark::DoNotOptimize(map->find(nums[latency_order[i]]));
+            else
+                map->remove(nums[latency_order[i]]);
+            hist.record(latency_now() - tic);
+        }
+
+        state.PauseTiming();
+        delete map;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * LATENCY_COUNTS);
+    state.counters["p50"] = hist.percentile(50);
+    state.counters["p90"] = hist.percentile(90);
+    state.counters["p99"] = hist.percentile(99);
+    state.counters["p99.9"] = hist.percentile(99.9);
+    state.counters["max"] = hist.max();
+}
+
+BENCHMARK_TEMPLATE(op_latency, base_type)->ArgName("op")->DenseRange(0, 2)->Iterations(1);
+BENCHMARK_TEMPLATE(op_latency, avl_type)->ArgName("op")->DenseRange(0, 2)->Iterations(1);
+BENCHMARK_TEMPLATE(op_latency, rbt_type)->ArgName("op")->DenseRange(0, 2)->Iterations(1);
+BENCHMARK_TEMPLATE(op_latency, llrb_type)->ArgName("op")->DenseRange(0, 2)->Iterations(1);
+BENCHMARK_TEMPLATE(op_latency, flat_map<size_t, size_t>)->ArgName("op")->DenseRange(0, 2)->Iterations(1);
+BENCHMARK_TEMPLATE(op_latency, persistent_map<size_t, size_t>)->ArgName("op")->DenseRange(0, 2)->Iterations(1);
+BENCHMARK_TEMPLATE(op_latency, concurrent_avl_map<size_t, size_t>)->ArgName("op")->DenseRange(0, 2)->Iterations(1);
+BENCHMARK_TEMPLATE(op_latency, skiplist_map<size_t, size_t>)->ArgName("op")->DenseRange(0, 2)->Iterations(1);
+
+
+/**
+ * 由 workload.hpp 生成的键和操作序列驱动各个引擎。
+ * key_order：按 state.range(0) 的分布插入 DIST_COUNTS 个键（重复的覆盖），再按同样的顺序查找一遍；
+ * 有序的键会让不平衡的 bst 退化成链表，bst 只跑无序的分布。
+ * bst_map 一族另外输出建好的树的高度和成功查找的平均路径长度（helper.hpp 的 shape()），
+ * 把查找耗时与形状对应起来。
+ */
+#define DIST_COUNTS   1000000UL
+#define WORKLOAD_SEED 20211019ULL
+
+template <typename Map>
+static void report_shape(benchmark::State& state, Map &map, std::true_type) {
+    tree_shape s = shape(map);       /* 只用到高度和路径长度，不统计颜色 */
+    state.counters["height"] = s.height;
+    state.counters["avg_path"] = s.avg_path();
+}
+
+template <typename Map>
+static void report_shape(benchmark::State&, Map &, std::false_type) {}
+
+template <typename Map>
+static void key_order(benchmark::State& state) {
+    std::vector<uint64_t> keys = make_keys((key_dist)state.range(0), DIST_COUNTS, WORKLOAD_SEED);
+    size_t hits = 0;
+    for (auto _ : state) {
+        Map map;
+        for (auto k : keys)
+            map.insert(k, k);
+        for (auto k : keys)
+            hits += map.find(k) ? 1 : 0;
+        state.PauseTiming();
+        report_shape(state, map, std::is_base_of<base_type, Map>());
+        state.ResumeTiming();
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetLabel(KEY_DIST_NAMES[state.range(0)]);
+    state.SetItemsProcessed(state.iterations() * DIST_COUNTS * 2);
+}
+
+BENCHMARK_TEMPLATE(key_order, base_type)->ArgName("dist")->Arg(KEY_UNIFORM)->Arg(KEY_ZIPF)->Arg(KEY_CLUSTERED)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(key_order, avl_type)->ArgName("dist")->DenseRange(0, KEY_DISTS - 1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(key_order, rbt_type)->ArgName("dist")->DenseRange(0, KEY_DISTS - 1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(key_order, llrb_type)->ArgName("dist")->DenseRange(0, KEY_DISTS - 1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(key_order, flat_map<size_t, size_t>)->ArgName("dist")->DenseRange(0, KEY_DISTS - 1)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(key_order, persistent_map<size_t, size_t>)->ArgName("dist")->DenseRange(0, KEY_DISTS - 1)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(key_order, concurrent_avl_map<size_t, size_t>)->ArgName("dist")->DenseRange(0, KEY_DISTS - 1)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(key_order, skiplist_map<size_t, size_t>)->ArgName("dist")->DenseRange(0, KEY_DISTS - 1)
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * ycsb：装载 YCSB_RECORDS 条记录（不计时），再执行 state.range(0) 对应的 workload（0 ~ 5 为 A ~ F）。
+ * update 覆盖已有的值，rmw 先查找再写回；scan 需要从某个键起按序迭代，
+ * 只有 bst_map 一族支持，E 只在这几种树上运行。
+ */
+#define YCSB_RECORDS  1000000UL
+#define YCSB_OPS      1000000UL
+
+static size_t ycsb_scan(base_type &map, size_t key, size_t len, std::true_type) {
+    base_type::link_type node = map.find(key);
+    size_t n = 0;
+    if (nullptr == node) return 0;
+    for (base_type::iterator i(node); i != map.end() && n < len; ++i) n++;
+    return n;
+}
+
+template <typename Map>
+static size_t ycsb_scan(Map &, size_t, size_t, std::false_type) {
+    return 0;
 }
 
-BENCHMARK(_delete)->ArgName("bst")->Arg((int64_t)bst);
-BENCHMARK(_delete)->ArgName("avl")->Arg((int64_t)avl);
-BENCHMARK(_delete)->ArgName("rbt")->Arg((int64_t)rbt);
-BENCHMARK(_delete)->ArgName("llrb")->Arg((int64_t)llrb);
+template <typename Map>
+static void ycsb(benchmark::State& state) {
+    char workload = 'A' + state.range(0);
+    size_t hits = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        Map *map = new Map();
+        for (size_t i = 0; i < YCSB_RECORDS; i++)
+            map->insert(ycsb_workload::key(i), i);
+        ycsb_workload gen(workload, YCSB_RECORDS, WORKLOAD_SEED);
+        state.ResumeTiming();
 
+        for (size_t i = 0; i < YCSB_OPS; i++) {
+            ycsb_op op = gen.next();
+            switch (op.type) {
+            case YCSB_READ:
+                hits += map->find(op.key) ? 1 : 0;
+                break;
+            case YCSB_UPDATE:
+            case YCSB_INSERT:
+                map->insert(op.key, i);
+                break;
+            case YCSB_RMW:
+                hits += map->find(op.key) ? 1 : 0;
+                map->insert(op.key, i);
+                break;
+            case YCSB_SCAN:
+                hits += ycsb_scan(*map, op.key, op.scan, std::is_base_of<base_type, Map>());
+                break;
+            }
+        }
+
+        state.PauseTiming();
+        delete map;
+        state.ResumeTiming();
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetLabel(std::string(1, workload));
+    state.SetItemsProcessed(state.iterations() * YCSB_OPS);
+}
+
+BENCHMARK_TEMPLATE(ycsb, base_type)->ArgName("workload")->DenseRange(0, 5)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ycsb, avl_type)->ArgName("workload")->DenseRange(0, 5)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ycsb, rbt_type)->ArgName("workload")->DenseRange(0, 5)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ycsb, llrb_type)->ArgName("workload")->DenseRange(0, 5)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ycsb, flat_map<size_t, size_t>)->ArgName("workload")->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(5)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ycsb, persistent_map<size_t, size_t>)->ArgName("workload")->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(5)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ycsb, concurrent_avl_map<size_t, size_t>)->ArgName("workload")->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(5)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ycsb, skiplist_map<size_t, size_t>)->ArgName("workload")->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(5)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ycsb, sharded_map<size_t, size_t>)->ArgName("workload")->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(5)
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * rss_growth：插入 RSS_COUNTS 个随机键，测进程常驻内存（/proc/self/statm）和 malloc 在用字节数
+ * （mallinfo2）的增长，与 memory_usage() 的估计放在一起，都摊到每个元素：
+ *   - 测量前先 heap_trim()，把之前的基准释放的内存还给系统；仍留在空闲链表里的内存会被复用，
+ *     所以 rss/entry 偏小，单独运行（--benchmark_filter=rss_）最准；
+ *   - rss_arena 把同样的键排序去重后用 assign_sorted() 建树，节点在一整块 arena 中，
+ *     与逐个 new 的节点对比块头开销；
+ *   - flat_map 逐个插入 2000 万个键要归并上千次，不在其中。
+ * 键数组在测量开始之前生成，不计入增长。
+ */
+#define RSS_COUNTS 20000000UL
+
+static const std::vector<uint64_t> &rss_keys() {
+    static std::vector<uint64_t> keys = make_keys(KEY_UNIFORM, RSS_COUNTS, WORKLOAD_SEED);
+    return keys;
+}
+
+template <typename Map>
+static void rss_report(benchmark::State& state, const Map &map, size_t entries, size_t rss, size_t heap) {
+    map_memory m = map.memory_usage();
+    state.counters["rss/entry"] = ((double)resident_bytes() - rss) / entries;
+    state.counters["heap/entry"] = ((double)heap_bytes() - heap) / entries;
+    state.counters["est/entry"] = (double)m.total() / entries;
+    state.counters["node/entry"] = (double)m.nodes / entries;
+}
+
+template <typename Map>
+static void rss_growth(benchmark::State& state) {
+    const std::vector<uint64_t> &keys = rss_keys();
+    for (auto _ : state) {
+        state.PauseTiming();
+        heap_trim();
+        size_t rss = resident_bytes(), heap = heap_bytes();
+        Map *map = new Map();
+        state.ResumeTiming();
+
+        for (auto k : keys)
+            map->insert(k, k);
+
+        state.PauseTiming();
+        rss_report(state, *map, keys.size(), rss, heap);
+        delete map;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <typename Tree>
+static void rss_arena(benchmark::State& state) {
+    std::vector<uint64_t> keys = rss_keys();
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (auto _ : state) {
+        state.PauseTiming();
+        heap_trim();
+        size_t rss = resident_bytes(), heap = heap_bytes(), i = 0;
+        Tree *tree = new Tree();
+        state.ResumeTiming();
+
+        tree->assign_sorted(keys.size(), [&](size_t &key, size_t &value) {
+            key = value = keys[i++];
+            return true;
+        });
+
+        state.PauseTiming();
+        rss_report(state, *tree, keys.size(), rss, heap);
+        delete tree;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
 
+BENCHMARK_TEMPLATE(rss_growth, base_type)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_growth, avl_type)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_growth, rbt_type)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_growth, llrb_type)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_growth, persistent_map<size_t, size_t>)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_growth, concurrent_avl_map<size_t, size_t>)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_growth, skiplist_map<size_t, size_t>)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_growth, sharded_map<size_t, size_t>)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_arena, base_type)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_arena, avl_type)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_arena, rbt_type)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(rss_arena, llrb_type)->Iterations(1)->Unit(benchmark::kMillisecond);
 
 BENCHMARK_MAIN();
 
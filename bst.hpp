@@ -1,6 +1,89 @@
 #ifndef __BALANCED_BINARY_SEARCH_TREE_HPP__
 #define __BALANCED_BINARY_SEARCH_TREE_HPP__
 #include "helper.hpp"
+#include "parallel_sort.hpp"
+#include "thread_pool.hpp"
+#include "memory_usage.hpp"
+
+#include <new>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <functional>
+#include <type_traits>
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/**
+ * 发布一个子指针（或根指针）。并发读者（见 rcu_map.hpp）不加锁地沿 left/right 下降，
+ * release 保证读者经由新指针看到的节点内容是完整的；单线程时与普通赋值一样。
+ */
+#define rcu_assign_pointer(p, v)   __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/**
+ * 操作计数，编译时加 -DMAP_STATS 打开（make benchmark_stats），否则下面的宏只剩原来的表达式，不多一条指令，
+ * 树里也没有计数器成员，stats()/reset_stats() 不存在。
+ * 计数器是 relaxed 原子量，const 的 find() 可以在多个线程中同时调用；
+ * 多线程的 apply_batch()/parallel_*() 中只在调用者线程计数，join 中的旋转不计入。
+ */
+#ifdef MAP_STATS
+#define MAP_STAT(tree, field, n)    ((tree)->counters.field.fetch_add((n), std::memory_order_relaxed))
+#else
+#define MAP_STAT(tree, field, n)    ((void)0)
+#endif
+#define MAP_LESS(tree, a, b)        (MAP_STAT(tree, comparisons, 1), (a) < (b))
+#define MAP_EQUAL(tree, a, b)       (MAP_STAT(tree, comparisons, 1), (a) == (b))
+
+struct map_stats {
+    size_t comparisons;     /* 键的比较 */
+    size_t rotations;
+    size_t recolors;        /* 改写节点颜色 */
+    size_t fixups;          /* 插入、删除后向上修复的步数（avl 回溯的层数，红黑树修复循环的次数） */
+    size_t lookups;         /* find() 的次数 */
+    size_t visited;         /* find() 经过的节点数，除以 lookups 是平均查找路径长度 */
+    size_t allocations;     /* 单个节点的分配，以及 arena 的分配（每块计一次） */
+};
+
+#ifdef MAP_STATS
+/* 树中实际累加的计数器，字段与 map_stats 一一对应，stats() 读出一份快照 */
+struct __map_counters {
+    std::atomic<size_t> comparisons;
+    std::atomic<size_t> rotations;
+    std::atomic<size_t> recolors;
+    std::atomic<size_t> fixups;
+    std::atomic<size_t> lookups;
+    std::atomic<size_t> visited;
+    std::atomic<size_t> allocations;
+
+    __map_counters() : comparisons(0), rotations(0), recolors(0), fixups(0),
+                       lookups(0), visited(0), allocations(0) {}
+
+    map_stats load() const {
+        map_stats s;
+        s.comparisons = comparisons.load(std::memory_order_relaxed);
+        s.rotations = rotations.load(std::memory_order_relaxed);
+        s.recolors = recolors.load(std::memory_order_relaxed);
+        s.fixups = fixups.load(std::memory_order_relaxed);
+        s.lookups = lookups.load(std::memory_order_relaxed);
+        s.visited = visited.load(std::memory_order_relaxed);
+        s.allocations = allocations.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void reset() {
+        comparisons.store(0, std::memory_order_relaxed);
+        rotations.store(0, std::memory_order_relaxed);
+        recolors.store(0, std::memory_order_relaxed);
+        fixups.store(0, std::memory_order_relaxed);
+        lookups.store(0, std::memory_order_relaxed);
+        visited.store(0, std::memory_order_relaxed);
+        allocations.store(0, std::memory_order_relaxed);
+    }
+};
+#endif
 
 template <typename keyType, typename valueType>
 struct __node_base {
@@ -89,7 +172,7 @@ inline void link_node_base(__node_base<keyType, valueType> *parent,
 
     /* pos保存的是 &parent->left;或者 &parent->right; */
     /* 因此下面一行代码相当于 parent->left = node;或者 parent->right = node; */
-    *pos = node;        
+    rcu_assign_pointer(*pos, node);
 }
 
 /* 删除节点node, 用以右子树的最大值来替换 */
@@ -119,26 +202,26 @@ void _remove_replace(__node_base<keyType, valueType> **root,
 
         if (parent) {
             if (parent == old) {
-                parent->right = child;
+                rcu_assign_pointer(parent->right, child);
                 parent = node;
             } else
-                parent->left = child;
+                rcu_assign_pointer(parent->left, child);
         } else 
-            *root = child;
+            rcu_assign_pointer(*root, child);
 
         /* 右子树的最小节点替换删除位置的节点 */
         node->parent = old->parent;
         node->color = old->color;
-        node->right = old->right;
-        node->left = old->left;
+        rcu_assign_pointer(node->right, old->right);
+        rcu_assign_pointer(node->left, old->left);
 
         if (old->parent) {
             if (old->parent->left == old)
-                old->parent->left = node;
+                rcu_assign_pointer(old->parent->left, node);
             else
-                old->parent->right = node;
+                rcu_assign_pointer(old->parent->right, node);
         } else
-            *root = node; /* old 是根节点 */
+            rcu_assign_pointer(*root, node); /* old 是根节点 */
 
         old->left->parent = node;
         if (old->right)
@@ -152,12 +235,12 @@ void _remove_replace(__node_base<keyType, valueType> **root,
             child->parent = parent;
         if (parent) {
             if (parent->left == node)
-                parent->left = child;
+                rcu_assign_pointer(parent->left, child);
             else
-                parent->right = child;
+                rcu_assign_pointer(parent->right, child);
         }
         else
-            *root = child;
+            rcu_assign_pointer(*root, child);
     }
 
     if (chld) *chld = child;
@@ -165,9 +248,150 @@ void _remove_replace(__node_base<keyType, valueType> **root,
     if (clr) *clr = color;
 }
 
+/**
+ * 批量建树：nodes[lo, hi) 已按键严格递增排列。
+ * 取中点为根递归连接，左右子树大小最多差 1，因此同时满足 AVL 的高度约束。
+ * red_depth 为 0 时填写 AVL 高度；否则按深度着色，第 red_depth 层为红色（1），其余为黑色（0），
+ * 红色只出现在最底层，每条路径上的黑节点个数相同。
+ */
+template <typename keyType, typename valueType>
+__node_base<keyType, valueType>*
+__link_halving(__node_base<keyType, valueType> *nodes, size_t lo, size_t hi,
+               size_t depth, size_t red_depth) {
+    if (lo >= hi) return nullptr;
+    size_t mid = lo + (hi - lo) / 2;
+    __node_base<keyType, valueType> *node = nodes + mid;
+
+    node->left = __link_halving(nodes, lo, mid, depth + 1, red_depth);
+    node->right = __link_halving(nodes, mid + 1, hi, depth + 1, red_depth);
+    if (node->left) node->left->parent = node;
+    if (node->right) node->right->parent = node;
+
+    if (0 == red_depth) {
+        size_t lh = node->left ? node->left->height : 0;
+        size_t rh = node->right ? node->right->height : 0;
+        node->height = 1 + MAX(lh, rh);
+    } else
+        node->color = (depth == red_depth);
+    return node;
+}
+
+/**
+ * 批量建树，得到黑高为 bh 的 2-3 树的左倾红黑树表示：
+ * 3-节点是一个黑节点带一个红色左孩子。黑高为 bh 的 2-3 树能容纳 [2^bh - 1, 3^bh - 1] 个键，
+ * 键数超出两棵子树的容量时才用 3-节点，三棵子树大小尽量均分。
+ * 左倾红黑树同时也是合法的红黑树。
+ */
+template <typename keyType, typename valueType>
+__node_base<keyType, valueType>*
+__link_23(__node_base<keyType, valueType> *nodes, size_t lo, size_t hi, size_t bh) {
+    typedef __node_base<keyType, valueType> *link_type;
+    size_t n = hi - lo, max = 1;
+    if (0 == n) return nullptr;
+    for (size_t i = 1; i < bh; i++) max *= 3;
+    max -= 1;   /* 黑高为 bh - 1 的子树最多容纳的键数 */
+
+    if (n - 1 <= 2 * max) {
+        size_t mid = lo + (n - 1) / 2;
+        link_type node = nodes + mid;
+        node->left = __link_23(nodes, lo, mid, bh - 1);
+        node->right = __link_23(nodes, mid + 1, hi, bh - 1);
+        node->color = 0;
+        if (node->left) node->left->parent = node;
+        if (node->right) node->right->parent = node;
+        return node;
+    }
+
+    size_t a = (n - 2) / 3, b = (n - 2 - a) / 2;
+    link_type red = nodes + lo + a;
+    link_type black = red + 1 + b;
+    red->left = __link_23(nodes, lo, lo + a, bh - 1);
+    red->right = __link_23(nodes, lo + a + 1, lo + a + 1 + b, bh - 1);
+    black->left = red;
+    black->right = __link_23(nodes, lo + a + 1 + b + 1, hi, bh - 1);
+    red->color = 1;
+    black->color = 0;
+    red->parent = black;
+    if (red->left) red->left->parent = red;
+    if (red->right) red->right->parent = red;
+    if (black->right) black->right->parent = black;
+    return black;
+}
+
 /*-----------------------------------------------------------------------------*/
 
+/**
+ * 节点池：一整块连续内存，节点在其中用 placement new 构造。
+ * 不做槽位复用，live 归零时整块释放。
+ */
+template <typename keyType, typename valueType>
+struct __node_arena {
+    typedef __node_base<keyType, valueType>  NODE;
+
+    NODE   *nodes;
+    size_t  capacity;
+    size_t  used;       /* 已分配出去的槽位，只增不减 */
+    size_t  live;       /* 仍在树中的节点 */
+
+    explicit __node_arena(size_t n)
+        : nodes(static_cast<NODE *>(::operator new(bytes(n)))),
+          capacity(n), used(0), live(0) {}
+
+    /* n * sizeof(NODE) 溢出时与 new[] 一样抛出 bad_array_new_length，不能分配出一块过小的内存 */
+    static size_t bytes(size_t n) {
+        if (n > SIZE_MAX / sizeof(NODE)) throw std::bad_array_new_length();
+        return n * sizeof(NODE);
+    }
+
+    bool contains(const NODE *node) const {
+        std::less<const NODE *> lt;
+        return !lt(node, nodes) && lt(node, nodes + capacity);
+    }
 
+    NODE *alloc(const keyType &key, const valueType &value) {
+        if (used >= capacity) abort();      /* NDEBUG 下也不能写出界 */
+        live++;
+        return new (nodes + used++) NODE(key, value);
+    }
+
+    void release() { ::operator delete(nodes); }
+};
+
+/**
+ * save() 写出的文件格式，可以直接 mmap 使用：
+ *   __tree_file_header | record[0] ... record[count - 1]
+ * record 按中序排列，下标即 rank；left/right 是孩子的下标而不是指针，
+ * 保留保存时树的形状，TREE_FILE_NIL 表示空。迭代只需顺序扫描 record。
+ */
+#define TREE_FILE_MAGIC  "BSTMAP01"
+#define TREE_FILE_NIL    UINT32_MAX
+
+struct __tree_file_header {
+    char     magic[8];
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t record_size;
+    uint32_t root;
+    uint64_t count;
+};
+
+template <typename keyType, typename valueType>
+struct __tree_file_record {
+    keyType   key;
+    valueType value;
+    uint32_t  left;
+    uint32_t  right;
+};
+
+/* apply_batch() 中的一条修改 */
+template <typename keyType, typename valueType>
+struct __batch_update {
+    keyType   key;
+    valueType value;
+    bool      erase;        /* true 时删除 key，忽略 value */
+};
+
+#define BATCH_GRAIN 2048    /* 子批次少于这么多条时不再分给新线程 */
 
 
 
@@ -255,21 +479,287 @@ public:
     typedef __node_base<keyType, valueType>     NODE;
     typedef __node_base<keyType, valueType>     *link_type;
     typedef _node_iterator<keyType, valueType>  iterator;
+    typedef __node_arena<keyType, valueType>    arena_type;
+    typedef __batch_update<keyType, valueType>  update_type;
 
 
     link_type root;
     size_t  size;
 
     // 辅助测试
-    void inc() {size++;}
-    void dec() {size--;}
+    // 结构发生变化时，正在进行的 compact 遍历作废，下一步重新开始
+    void inc() {size++; compact_cursor = nullptr;}
+    void dec() {size--; compact_cursor = nullptr;}
     link_type& getRoot() {return root;}
-    void setRoot(link_type node) {root = node;}
+    size_t arena_count() const {return arenas.size();}
+    void setRoot(link_type node) {rcu_assign_pointer(root, node);}
 
     // 绝不在构造和析构中调用虚函数
-    bst_map() : root(nullptr), size(0) {}
+    bst_map() : root(nullptr), size(0), compact_cursor(nullptr), compact_arena(nullptr), compact_key() {}
     virtual ~bst_map() { clear(); }
 
+    // 所有节点都经由这两个函数分配和释放，节点可能位于 arena 中
+    link_type create_node(const keyType &key, const valueType &value) {
+        return new NODE(key, value);
+    }
+
+    // 虚函数：并发读模式下摘下的节点要延迟到读者离开后才释放
+    virtual void destroy_node(link_type node) {
+        for (size_t i = 0; i < arenas.size(); i++) {
+            if (arenas[i].contains(node)) {
+                node->~NODE();
+                if (0 == --arenas[i].live && arenas[i].nodes != compact_arena) {
+                    arenas[i].release();
+                    arenas.erase(arenas.begin() + i);
+                }
+                return;
+            }
+        }
+        delete node;
+    }
+
+#ifdef MAP_STATS
+    map_stats stats() const {
+        return counters.load();
+    }
+
+    void reset_stats() {
+        counters.reset();
+    }
+#endif
+
+    /**
+     * 单独 new 的节点各带一份块头；arena 只有整块一份块头，但已释放的槽位在整块释放之前
+     * 都算作 slack。avl 的 height 与红黑树的 color 共用一个 size_t，几种树的节点一样大。
+     */
+    map_memory memory_usage() const {
+        map_memory m;
+        size_t pooled = 0;
+        for (const arena_type &arena : arenas) {
+            pooled += arena.live;
+            m.slack += (arena.capacity - arena.live) * sizeof(NODE);
+            m.overhead += malloc_overhead(arena.capacity * sizeof(NODE));
+        }
+        m.nodes = size * sizeof(NODE);
+        if (size > pooled)
+            m.overhead += (size - pooled) * malloc_overhead(sizeof(NODE));
+        m.metadata = sizeof(*this) + malloc_chunk(arenas.capacity() * sizeof(arena_type));
+        return m;
+    }
+
+    /**
+     * 把所有节点按中序搬进一块新的连续内存，树的形状和颜色/高度不变。
+     * 搬动后原有的 iterator 和 find() 返回的指针全部失效。
+     */
+    void compact() {
+        compact_step((size_t)-1);
+    }
+
+    /**
+     * 增量 compact：最多搬动 budget 个节点，遍历完成时返回 true。
+     * 两次调用之间若有插入或删除，本轮并不作废，下一次调用从第一个不小于 compact_key
+     * （下一个待搬动的键）的节点继续，已经搬进本轮 arena 的节点留在原处；
+     * 本轮中途插入到游标之前的节点留到下一轮再搬。一轮只在 arena 装满时（中途插入的
+     * 比开始时多）才追加一块，写入不断时 arena 的块数也不会随调用次数增长。
+     * 上一轮的 arena 随着其中节点被搬走而自动释放。
+     */
+    bool compact_step(size_t budget) {
+        if (nullptr == root) {
+            compact_finish();
+            return true;
+        }
+        if (nullptr == compact_arena) {             /* 新的一轮 */
+            compact_cursor = __node_base_first(root);
+            compact_key = compact_cursor->key;
+            compact_grow(size);
+        } else if (nullptr == compact_cursor) {     /* 上次之后树被修改过 */
+            compact_cursor = first_not_less(compact_key);
+        }
+        while (compact_cursor && budget--) {
+            arena_type *arena = &arenas[compact_index()];
+            if (arena->used == arena->capacity)
+                compact_grow(size - arena->live);   /* 还没搬的最多这么多个 */
+            link_type node = relocate_node(compact_cursor);
+            compact_cursor = __node_base_next(node);
+            if (compact_cursor) compact_key = compact_cursor->key;
+        }
+        if (compact_cursor) return false;
+        compact_finish();
+        return true;
+    }
+
+    /**
+     * 线性时间批量建树：清空后调用 n 次 next(key, value) 依次取得严格递增的键值对，
+     * 节点按中序连续构造在一块 arena 中，再由 link_sorted() 按各自的平衡规则连接。
+     * next 返回 false 表示数据源出错，此时已构造的节点全部释放，树为空，返回 false。
+     */
+    template <typename Source>
+    bool assign_sorted(size_t n, Source next) {
+        clear();
+        if (0 == n) return true;
+
+        keyType key = keyType();
+        valueType value = valueType();
+        arenas.push_back(arena_type(n));
+        MAP_STAT(this, allocations, 1);
+        link_type nodes = arenas.back().nodes;
+        for (size_t i = 0; i < n; i++) {
+            if (!next(key, value)) {
+                while (i) destroy_node(nodes + --i);
+                return false;
+            }
+            arenas.back().alloc(key, value);
+            assert(0 == i || nodes[i - 1].key < nodes[i].key);
+        }
+
+        root = link_sorted(nodes, n);
+        root->parent = nullptr;
+        size = n;
+        compact_cursor = nullptr;
+        return true;
+    }
+
+    /**
+     * 并行批量建树：keys/values[0, n) 无序，可以有重复的键，后出现的值覆盖先出现的。
+     *   1. 键值对交给 parallel_stable_sort()，相同的键保持输入顺序；
+     *   2. 每个线程数出自己一段中要保留的元素（同键的最后一个），前缀和得到各段的输出位置，再各自搬过去；
+     *   3. 按 link_sorted() 的中点二分形状自顶向下切 depth 层（2^depth >= threads），
+     *      得到最多 2^depth 棵子树，每棵由一个线程构造在自己的 arena 中并连接，
+     *      颜色/高度按它在整棵树中的深度计算；
+     *   4. 上方的 2^depth - 1 个节点由调用者连接。结果与 assign_sorted() 建出的树形状、颜色、高度完全相同。
+     * 跨度 O(n/p log n + p)。halving_colors() 返回 false 的子类（llrb）在第 3 步退回 assign_sorted()。
+     */
+    bool assign_parallel(const keyType *keys, const valueType *values, size_t n, size_t threads) {
+        typedef std::pair<keyType, valueType> pair_type;
+        clear();
+        if (0 == n) return true;
+        if (threads < 1) threads = 1;
+        if (threads > n) threads = n;
+
+        std::vector<pair_type> items(n), uniq(n);
+        __parallel_run(threads, [&](size_t t) {
+            size_t to = __split_point(n, threads, t + 1);
+            for (size_t i = __split_point(n, threads, t); i < to; i++)
+                items[i] = pair_type(keys[i], values[i]);
+        });
+        parallel_stable_sort(items.data(), uniq.data(), n, threads,
+            [](const pair_type &a, const pair_type &b) { return a.first < b.first; });
+
+        auto keep = [&](size_t i) { return i + 1 == n || items[i].first < items[i + 1].first; };
+        std::vector<size_t> offset(threads + 1, 0);
+        __parallel_run(threads, [&](size_t t) {
+            size_t to = __split_point(n, threads, t + 1), c = 0;
+            for (size_t i = __split_point(n, threads, t); i < to; i++)
+                c += keep(i);
+            offset[t + 1] = c;
+        });
+        for (size_t t = 0; t < threads; t++)
+            offset[t + 1] += offset[t];
+        __parallel_run(threads, [&](size_t t) {
+            size_t to = __split_point(n, threads, t + 1), o = offset[t];
+            for (size_t i = __split_point(n, threads, t); i < to; i++)
+                if (keep(i)) uniq[o++] = items[i];
+        });
+        size_t m = offset[threads];
+
+        size_t red_depth;
+        if (!halving_colors(m, &red_depth)) {
+            size_t i = 0;
+            return assign_sorted(m, [&](keyType &key, valueType &value) {
+                key = uniq[i].first;
+                value = uniq[i].second;
+                i++;
+                return true;
+            });
+        }
+
+        size_t depth = 0;
+        while (((size_t)1 << depth) < threads) depth++;
+
+        std::vector<__build_piece> pieces;
+        split_halving(pieces, 0, m, 0, depth);
+        arenas.reserve(arenas.size() + pieces.size() + 1);
+        for (auto &piece : pieces) {
+            if (piece.lo == piece.hi) continue;
+            piece.arena = arenas.size();
+            arenas.push_back(arena_type(piece.hi - piece.lo));
+            MAP_STAT(this, allocations, 1);
+        }
+
+        __parallel_run(threads, [&](size_t t) {
+            for (size_t k = t; k < pieces.size(); k += threads) {
+                __build_piece &piece = pieces[k];
+                if (piece.lo == piece.hi) continue;
+                arena_type &arena = arenas[piece.arena];
+                for (size_t i = piece.lo; i < piece.hi; i++)
+                    arena.alloc(uniq[i].first, uniq[i].second);
+                piece.root = __link_halving(arena.nodes, 0, piece.hi - piece.lo, depth, red_depth);
+            }
+        });
+
+        size_t next = 0, top = ((size_t)1 << depth) - 1;
+        if (top) {
+            arenas.push_back(arena_type(top));
+            MAP_STAT(this, allocations, 1);
+        }
+        root = link_spine(uniq.data(), pieces, next, 0, m, 0, depth, red_depth);
+        root->parent = nullptr;
+        if (top && 0 == arenas.back().live) {      /* 元素太少，上方没有用到任何节点 */
+            arenas.back().release();
+            arenas.pop_back();
+        }
+        size = m;
+        compact_cursor = nullptr;
+        return true;
+    }
+
+    /**
+     * 批量修改：updates 无序，同一个键出现多次时以最后一条为准。
+     *   1. 按键 parallel_stable_sort() 后去重；
+     *   2. 以树根的键为界把批次二分，左右子树各自递归地应用自己的子批次，
+     *      两边互不相交，前 ceil(log2 threads) 层经 __parallel_do() 交给线程池并行执行；
+     *   3. 根节点按自己那条修改更新值或删除，再用 join_node() 把左右两棵结果连回来，
+     *      删除时先摘下左树的最大节点作为新的中间节点。子树为空时，剩下的批次按中点二分直接建树。
+     * 共 O(m log(n/m + 1)) 次比较与 join，跨度 O(log n log m)。
+     * join_rank() 返回 false 的子类（bst、llrb 以及并发读的 rcu_rbt_map）按原顺序逐条 insert/remove。
+     */
+    void apply_batch(const std::vector<update_type> &updates, size_t threads = std::thread::hardware_concurrency()) {
+        size_t m = updates.size();
+        size_t rank;
+        if (0 == m) return;
+        if (threads < 1) threads = 1;
+        if (!join_rank(root, &rank)) {
+            for (const update_type &u : updates) {
+                if (!u.erase)
+                    insert(u.key, u.value);
+                else if (find(u.key))
+                    remove(u.key);
+            }
+            return;
+        }
+
+        std::vector<update_type> ops(updates), tmp(m);
+        parallel_stable_sort(ops.data(), tmp.data(), m, threads,
+            [](const update_type &a, const update_type &b) { return a.key < b.key; });
+        size_t n = 0;
+        for (size_t i = 0; i < m; i++)
+            if (i + 1 == m || ops[i].key < ops[i + 1].key) ops[n++] = ops[i];
+
+        size_t forks = 0;
+        while (((size_t)1 << forks) < threads) forks++;
+        __batch_state state;
+        root = apply_range(root, rank, ops.data(), 0, n, forks, state, &rank);
+        if (root) {
+            root->parent = nullptr;
+            join_finish(root);
+        }
+        for (link_type node : state.dead)
+            destroy_node(node);
+        size += state.delta;
+        MAP_STAT(this, allocations, state.created);
+        compact_cursor = nullptr;
+    }
+
     reference operator[](const keyType &key) {
         link_type pos = find(key);
         if (pos) 
@@ -283,8 +773,9 @@ public:
     }
 
     virtual iterator insert(const keyType &key, const valueType &value) {
-        link_type n = new NODE(key, value);
+        link_type n = create_node(key, value);
         assert(n);
+        MAP_STAT(this, allocations, 1);
         return insert(n);
     }
 
@@ -293,18 +784,18 @@ public:
         link_type parent = nullptr;
         while (*pos) {
             parent = *pos;
-            if (node->key < (*pos)->key)
+            if (MAP_LESS(this, node->key, (*pos)->key))
                 pos = &((*pos)->left);
-            else if (node->key > (*pos)->key)
+            else if (MAP_LESS(this, (*pos)->key, node->key))
                 pos = &((*pos)->right);
             else {
                 (*pos)->value = node->value;
-                delete node;
+                destroy_node(node);
                 return iterator(*pos);
             }
         }
         link_node_base(parent, node, pos);
-        size++;
+        inc();
         return iterator(node);
     }
 
@@ -319,8 +810,8 @@ public:
         if (nullptr == node) return itor;
         ++itor;
         _remove_replace(&root, node);
-        delete(node);
-        size--;
+        destroy_node(node);
+        dec();
         return itor;
     }
 
@@ -328,6 +819,7 @@ public:
         while (root) {
             remove(root);
         }
+        compact_finish();
     }
 
     bool empty() const {
@@ -336,10 +828,12 @@ public:
 
     link_type find(const keyType &key) const {
         link_type pos = root;
+        MAP_STAT(this, lookups, 1);
         while (pos) {
-            if (key < pos->key)
+            MAP_STAT(this, visited, 1);
+            if (MAP_LESS(this, key, pos->key))
                 pos = pos->left;
-            else if (key > pos->key) 
+            else if (MAP_LESS(this, pos->key, key))
                 pos = pos->right;
             else
                 return pos;
@@ -355,13 +849,443 @@ public:
         return iterator(nullptr);
     }
 
+    /**
+     * 并行中序遍历。节点里没有子树大小，按深度切分：自根向下 depth 层（2^depth 不少于块数），
+     * 每棵子树连同中序紧随其后的祖先构成一块，块之间在中序上首尾相接，交给线程池中的线程执行。
+     * fn(key, value) 会在多个线程中并发调用，同一块内按键递增；遍历期间不能修改树的结构。
+     */
+    template <typename Fn>
+    void parallel_for_each(Fn fn, thread_pool &pool = thread_pool::instance()) {
+        std::vector<__walk_piece> pieces;
+        split_depth(pieces, pool);
+        task_group group(pool);
+        for (auto &piece : pieces)
+            group.spawn([&piece, &fn]() { walk_piece(piece, fn); });
+        group.sync();
+    }
+
+    /**
+     * 并行归约：各块按中序折叠 map_fn(key, value) 的结果，再按块的顺序从 init 开始合并。
+     * reduce_fn 满足结合律时结果与顺序遍历 fold 相同，与线程数和调度无关。
+     */
+    template <typename T, typename Map, typename Reduce>
+    T parallel_reduce(T init, Map map_fn, Reduce reduce_fn, thread_pool &pool = thread_pool::instance()) {
+        std::vector<__walk_piece> pieces;
+        split_depth(pieces, pool);
+        return __ordered_reduce(pool, pieces.size(), init, [&](size_t i, T &acc) {
+            bool has = false;
+            walk_piece(pieces[i], [&](const keyType &key, valueType &value) {
+                acc = has ? reduce_fn(acc, map_fn(key, value)) : map_fn(key, value);
+                has = true;
+            });
+            return has;
+        }, reduce_fn);
+    }
+
+    /**
+     * 把树写成可重定位的文件（格式见 __tree_file_header），只支持 trivially copyable 的键值。
+     * 先写 path.tmp 再 rename，已经 mmap 了旧文件的进程不受影响。成功返回 0，失败返回 -1。
+     */
+    int save(const char *path) {
+        typedef __tree_file_record<keyType, valueType> record;
+        static_assert(std::is_trivially_copyable<keyType>::value &&
+                      std::is_trivially_copyable<valueType>::value,
+                      "save() needs trivially copyable keys and values");
+        if (size >= TREE_FILE_NIL) return -1;
+
+        std::string tmp = std::string(path) + ".tmp";
+        size_t bytes = sizeof(__tree_file_header) + size * sizeof(record);
+        int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return -1;
+        if (ftruncate(fd, bytes) < 0) {
+            close(fd);
+            unlink(tmp.c_str());
+            return -1;
+        }
+        void *addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == addr) {
+            unlink(tmp.c_str());
+            return -1;
+        }
+
+        __tree_file_header *hdr = (__tree_file_header *)addr;
+        record *records = (record *)(hdr + 1);
+        memcpy(hdr->magic, TREE_FILE_MAGIC, sizeof(hdr->magic));
+        hdr->key_size = sizeof(keyType);
+        hdr->value_size = sizeof(valueType);
+        hdr->record_size = sizeof(record);
+        hdr->count = size;
+        hdr->root = TREE_FILE_NIL;
+
+        /**
+         * 非递归中序遍历，访问到节点时它的 rank 就是已写出的个数。
+         * 左孩子被访问时父节点正好在栈顶，把 rank 记在父节点的 frame 里；
+         * 右孩子的 rank 回填到父节点已经写出的 record 中，slot 指向回填位置。
+         */
+        struct frame {
+            link_type  node;
+            uint32_t  *slot;        /* nullptr 表示是左孩子 */
+            uint32_t   left;
+        };
+        std::vector<frame> stack;
+        uint32_t rank = 0, *slot = &hdr->root;
+        link_type node = root;
+        while (node || !stack.empty()) {
+            while (node) {
+                stack.push_back(frame{node, slot, TREE_FILE_NIL});
+                slot = nullptr;
+                node = node->left;
+            }
+            frame f = stack.back();
+            stack.pop_back();
+
+            record &r = records[rank];
+            memcpy(&r.key, &f.node->key, sizeof(keyType));
+            memcpy(&r.value, &f.node->value, sizeof(valueType));
+            r.left = f.left;
+            r.right = TREE_FILE_NIL;
+            if (f.slot)
+                *f.slot = rank;
+            else
+                stack.back().left = rank;
+            rank++;
+
+            node = f.node->right;
+            slot = &r.right;
+        }
+        assert(rank == size);
+
+        munmap(addr, bytes);
+        if (rename(tmp.c_str(), path)) {
+            unlink(tmp.c_str());     /* 失败时不留下临时文件 */
+            return -1;
+        }
+        return 0;
+    }
 
     virtual const char *name() const {
         return BST_TREE;
     }
 
+protected:
+    /* 把 assign_sorted() 构造好的有序节点连接成树，返回根；各子类按自己的平衡规则重写 */
+    virtual link_type link_sorted(link_type nodes, size_t n) {
+        return __link_halving(nodes, 0, n, 0, 0);
+    }
+
+    /**
+     * link_sorted() 若按中点二分建树，给出 __link_halving() 的 red_depth 并返回 true，
+     * assign_parallel() 据此分段并行连接；其它形状返回 false。
+     */
+    virtual bool halving_colors(size_t n, size_t *red_depth) const {
+        (void)n;
+        *red_depth = 0;
+        return true;
+    }
+
+    /**
+     * apply_batch() 的平衡规则。秩用来比较两棵树的高矮，avl 为高度，rbt 为黑高。
+     * join_rank() 求整棵树的秩，返回 false 表示不支持 join；child_rank() 由父节点的秩求孩子的秩，
+     * 在 join_node() 改写 parent 的颜色/高度之前调用。
+     */
+    virtual bool join_rank(link_type root, size_t *rank) const {
+        (void)root;
+        *rank = 0;
+        return false;
+    }
+
+    virtual size_t child_rank(link_type parent, size_t rank, link_type child) const {
+        (void)parent;
+        (void)rank;
+        (void)child;
+        return 0;
+    }
+
+    /**
+     * 以 k 为中间节点连接 l 和 r（l 的键都小于 k，r 的都大于 k），返回新的根，*rank 为它的秩。
+     * 只改动三棵树内部的节点，不碰 root，可以在多个线程中对互不相交的子树同时调用。
+     */
+    virtual link_type join_node(link_type l, size_t rl, link_type k, link_type r, size_t rr, size_t *rank) {
+        (void)rl;
+        (void)rr;
+        *rank = 0;
+        return __join_attach(l, k, r);
+    }
+
+    /* 整批修改完成后对新的根做最后的调整（红黑树的根染黑） */
+    virtual void join_finish(link_type root) {
+        (void)root;
+    }
+
+    static link_type __join_attach(link_type l, link_type k, link_type r) {
+        k->left = l;
+        k->right = r;
+        if (l) l->parent = k;
+        if (r) r->parent = k;
+        return k;
+    }
+
+#ifdef MAP_STATS
+    /* 子类的 MAP_STAT(this, ...) 也要累加，所以放在 protected，其余数据成员见下 */
+    mutable __map_counters counters;
+#endif
+
+private:
+    link_type compact_cursor;           /* 下一个待搬动的节点，树被修改后置空，由 compact_key 找回 */
+    NODE     *compact_arena;            /* 进行中的一轮正在填充的 arena，空时释放要等本轮结束 */
+    keyType   compact_key;
+    std::vector<arena_type> arenas;
+
+    size_t compact_index() const {
+        size_t i = 0;
+        while (arenas[i].nodes != compact_arena) i++;
+        return i;
+    }
+
+    /* 给本轮换一块能放 n 个节点的 arena，换下来的若已经空了就释放 */
+    void compact_grow(size_t n) {
+        NODE *old = compact_arena;
+        arenas.push_back(arena_type(n));
+        MAP_STAT(this, allocations, 1);
+        compact_arena = arenas.back().nodes;
+        release_if_empty(old);
+    }
+
+    /* 结束本轮 */
+    void compact_finish() {
+        NODE *old = compact_arena;
+        compact_arena = nullptr;
+        compact_cursor = nullptr;
+        release_if_empty(old);
+    }
+
+    void release_if_empty(NODE *nodes) {
+        for (size_t i = 0; nodes && i < arenas.size(); i++) {
+            if (arenas[i].nodes == nodes) {
+                if (0 == arenas[i].live) {
+                    arenas[i].release();
+                    arenas.erase(arenas.begin() + i);
+                }
+                return;
+            }
+        }
+    }
+
+    /* 第一个不小于 key 的节点 */
+    link_type first_not_less(const keyType &key) const {
+        link_type pos = root, result = nullptr;
+        while (pos) {
+            if (pos->key < key) {
+                pos = pos->right;
+            } else {
+                result = pos;
+                pos = pos->left;
+            }
+        }
+        return result;
+    }
+
+    /* parallel_for_each() 的一块：subtree 的全部节点，然后是 after（可以为空） */
+    struct __walk_piece {
+        link_type subtree;
+        link_type after;
+    };
 
-    
+    void split_depth(std::vector<__walk_piece> &pieces, thread_pool &pool) {
+        size_t depth = 0, want = (pool.size() + 1) * PARALLEL_SPLIT;
+        while (((size_t)1 << depth) < want) depth++;
+        split_depth(pieces, root, 0, depth);
+    }
+
+    static void split_depth(std::vector<__walk_piece> &pieces, link_type node, size_t d, size_t depth) {
+        if (nullptr == node) return;
+        if (d == depth) {
+            pieces.push_back(__walk_piece{node, nullptr});
+            return;
+        }
+        split_depth(pieces, node->left, d + 1, depth);
+        if (pieces.empty() || pieces.back().after)
+            pieces.push_back(__walk_piece{nullptr, node});
+        else
+            pieces.back().after = node;     /* 上一块的最后一个节点正是 node 的中序前驱 */
+        split_depth(pieces, node->right, d + 1, depth);
+    }
+
+    /* 沿 parent 指针迭代，不递归，退化成链表的 bst 也不会爆栈 */
+    template <typename Fn>
+    static void walk_piece(const __walk_piece &piece, Fn &&fn) {
+        if (piece.subtree) {
+            link_type last = __node_base_last(piece.subtree);
+            for (link_type node = __node_base_first(piece.subtree); ; node = __node_base_next(node)) {
+                fn(node->key, node->value);
+                if (node == last) break;
+            }
+        }
+        if (piece.after) fn(piece.after->key, piece.after->value);
+    }
+
+    /* apply_batch() 一个分支的结果：节点数的变化，以及被删除、等全部连接完再释放的节点 */
+    struct __batch_state {
+        ptrdiff_t              delta;
+        size_t                 created;     /* 新分配的节点，全部完成后再计入 counters */
+        std::vector<link_type> dead;
+
+        __batch_state() : delta(0), created(0) {}
+
+        void merge(__batch_state &x) {
+            delta += x.delta;
+            created += x.created;
+            dead.insert(dead.end(), x.dead.begin(), x.dead.end());
+        }
+    };
+
+    /* 把有序去重的 ops[lo, hi) 应用到秩为 rank 的子树 t 上，返回新子树，*out 为它的秩 */
+    link_type apply_range(link_type t, size_t rank, const update_type *ops, size_t lo, size_t hi,
+                          size_t forks, __batch_state &state, size_t *out) {
+        if (lo == hi) {
+            *out = rank;
+            return t;
+        }
+        if (nullptr == t) return build_range(ops, lo, hi, forks, state, out);
+
+        link_type l = t->left, r = t->right;
+        size_t rl = child_rank(t, rank, l), rr = child_rank(t, rank, r);
+        size_t p = std::lower_bound(ops + lo, ops + hi, t->key,
+            [](const update_type &u, const keyType &key) { return u.key < key; }) - ops;
+        bool hit = p < hi && !(t->key < ops[p].key);
+        size_t q = hit ? p + 1 : p;
+
+        __batch_state side;
+        __parallel_do(forks && hi - lo >= BATCH_GRAIN,
+            [&]() { l = apply_range(l, rl, ops, lo, p, forks ? forks - 1 : 0, side, &rl); },
+            [&]() { r = apply_range(r, rr, ops, q, hi, forks ? forks - 1 : 0, state, &rr); });
+        state.merge(side);
+
+        if (hit && ops[p].erase) {
+            state.dead.push_back(t);
+            state.delta--;
+            return join2(l, rl, r, rr, out);
+        }
+        if (hit) t->value = ops[p].value;
+        return join_node(l, rl, t, r, rr, out);
+    }
+
+    /* 子树为空：按中点二分建树，删除的键直接跳过 */
+    link_type build_range(const update_type *ops, size_t lo, size_t hi, size_t forks,
+                          __batch_state &state, size_t *out) {
+        size_t rl = 0, rr = 0;
+        if (lo == hi) {
+            *out = 0;               /* 空树的秩 */
+            return nullptr;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        link_type l = nullptr, r = nullptr;
+        __batch_state side;
+        __parallel_do(forks && hi - lo >= BATCH_GRAIN,
+            [&]() { l = build_range(ops, lo, mid, forks ? forks - 1 : 0, side, &rl); },
+            [&]() { r = build_range(ops, mid + 1, hi, forks ? forks - 1 : 0, state, &rr); });
+        state.merge(side);
+
+        if (ops[mid].erase) return join2(l, rl, r, rr, out);
+        state.delta++;
+        state.created++;
+        return join_node(l, rl, create_node(ops[mid].key, ops[mid].value), r, rr, out);
+    }
+
+    /* 没有中间节点的连接：摘下 l 的最大节点作为中间节点 */
+    link_type join2(link_type l, size_t rl, link_type r, size_t rr, size_t *out) {
+        if (nullptr == l) {
+            *out = rr;
+            return r;
+        }
+        if (nullptr == r) {
+            *out = rl;
+            return l;
+        }
+        link_type k;
+        l = split_last(l, rl, &k, &rl);
+        return join_node(l, rl, k, r, rr, out);
+    }
+
+    link_type split_last(link_type t, size_t rank, link_type *last, size_t *out) {
+        link_type l = t->left, r = t->right;
+        size_t rl = child_rank(t, rank, l), rr = child_rank(t, rank, r);
+        if (nullptr == r) {
+            *last = t;
+            *out = rl;
+            return l;
+        }
+        r = split_last(r, rr, last, &rr);
+        return join_node(l, rl, t, r, rr, out);
+    }
+
+    /* assign_parallel() 中由一个线程构造的子树，对应有序数组的 [lo, hi) */
+    struct __build_piece {
+        size_t    lo, hi;
+        size_t    arena;
+        link_type root;
+    };
+
+    /* 按中点二分向下 depth 层，依次记下每个子树的区间 */
+    static void split_halving(std::vector<__build_piece> &pieces, size_t lo, size_t hi,
+                              size_t d, size_t depth) {
+        if (d == depth) {
+            pieces.push_back(__build_piece{lo, hi, 0, nullptr});
+            return;
+        }
+        if (lo >= hi) return;
+        size_t mid = lo + (hi - lo) / 2;
+        split_halving(pieces, lo, mid, d + 1, depth);
+        split_halving(pieces, mid + 1, hi, d + 1, depth);
+    }
+
+    /* 与 split_halving() 同样的顺序连接子树上方的节点，着色方式同 __link_halving() */
+    template <typename Pair>
+    link_type link_spine(const Pair *uniq, std::vector<__build_piece> &pieces, size_t &next,
+                         size_t lo, size_t hi, size_t d, size_t depth, size_t red_depth) {
+        if (d == depth) return pieces[next++].root;
+        if (lo >= hi) return nullptr;
+        size_t mid = lo + (hi - lo) / 2;
+        link_type node = arenas.back().alloc(uniq[mid].first, uniq[mid].second);
+
+        node->left = link_spine(uniq, pieces, next, lo, mid, d + 1, depth, red_depth);
+        node->right = link_spine(uniq, pieces, next, mid + 1, hi, d + 1, depth, red_depth);
+        if (node->left) node->left->parent = node;
+        if (node->right) node->right->parent = node;
+
+        if (0 == red_depth) {
+            size_t lh = node->left ? node->left->height : 0;
+            size_t rh = node->right ? node->right->height : 0;
+            node->height = 1 + MAX(lh, rh);
+        } else
+            node->color = (d == red_depth);
+        return node;
+    }
+
+    // 把 node 复制到本轮 arena（compact_arena）的下一个槽位，并让父亲和孩子指向新地址。
+    // 释放旧节点可能让排在它前面的 arena 从 vector 中移除，本轮 arena 的下标随之改变，
+    // 所以不缓存下标或 arena_type 的指针，每次经 compact_index() 按 compact_arena 重新定位
+    link_type relocate_node(link_type node) {
+        link_type n = arenas[compact_index()].alloc(node->key, node->value);
+        n->parent = node->parent;
+        n->left = node->left;
+        n->right = node->right;
+        n->color = node->color;
+
+        if (n->parent) {
+            if (n->parent->left == node)
+                n->parent->left = n;
+            else
+                n->parent->right = n;
+        } else
+            root = n;
+        if (n->left) n->left->parent = n;
+        if (n->right) n->right->parent = n;
+
+        destroy_node(node);
+        return n;
+    }
 };
 
 
@@ -1,4 +1,5 @@
 #include "avl_tree.h"
+#include "tree_stats.h"
 
 #ifndef MIN
 #define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
@@ -8,8 +9,6 @@
 #define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
 #endif 
 
-static size_t __rotates = 0;
-
 static size_t avl_height(avl_node *node) {
     return NULL == node ? 0 : node->height;
 }
@@ -54,7 +53,7 @@ static avl_node *avl_right_rotate(avl_node **root, avl_node *y) {
         parent->height = avl_update_height(parent);
 
     // printf("%s\n", __func__);
-    __rotates++;
+    TREE_STAT(TREE_STATS_AVL, rotations, 1);
     return x;
 }
 
@@ -87,7 +86,7 @@ static avl_node *avl_left_rotate(avl_node **root, avl_node *x) {
         parent->height = avl_update_height(parent);
 
     // printf("%s\n", __func__);
-    __rotates++;
+    TREE_STAT(TREE_STATS_AVL, rotations, 1);
     return y;
 }
 
@@ -97,8 +96,13 @@ static int avl_balance_factor(avl_node *node) {
 }
 
 
-static void avl_rebalance(avl_node **root, avl_node *node) {
+/* erase 非 0 时向上的层数记在删除名下 */
+static void avl_rebalance(avl_node **root, avl_node *node, int erase) {
     if (NULL == node) return;
+    if (erase)
+        TREE_STAT(TREE_STATS_AVL, erase_depth, 1);
+    else
+        TREE_STAT(TREE_STATS_AVL, insert_depth, 1);
     node->height = avl_update_height(node);
     int factor = avl_balance_factor(node);
 
@@ -163,12 +167,13 @@ static void avl_rebalance(avl_node **root, avl_node *node) {
         avl_left_rotate(root, node);
     }
 
-    avl_rebalance(root, parent);
+    avl_rebalance(root, parent, erase);
 }
 
 
 void avl_insert(avl_node **root, avl_node *node) {
-    avl_rebalance(root, node);
+    TREE_STAT(TREE_STATS_AVL, inserts, 1);
+    avl_rebalance(root, node, 0);
 }
 
 void avl_erase(avl_node **root, avl_node *node) {
@@ -226,8 +231,8 @@ void avl_erase(avl_node **root, avl_node *node) {
             *root = child;
     }
 
-    avl_rebalance(root, parent);
-
+    TREE_STAT(TREE_STATS_AVL, erases, 1);
+    avl_rebalance(root, parent, 1);
 }
 
 avl_node *avl_next(avl_node *node) {
@@ -277,6 +282,11 @@ avl_node *avl_last(avl_node *root) {
     return root;
 }
 
-size_t avl_rotate_times() { return __rotates;}
-void avl_reset_rotate_times() { __rotates = 0;}
+size_t avl_rotate_times() {
+    tree_stats stats;
+    tree_stats_get(TREE_STATS_AVL, &stats);
+    return stats.rotations;
+}
+
+void avl_reset_rotate_times() { tree_stats_reset(TREE_STATS_AVL); }
 
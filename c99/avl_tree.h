@@ -41,6 +41,7 @@ avl_node *avl_prev(avl_node *node);
 avl_node *avl_first(avl_node *root);
 avl_node *avl_last(avl_node *root);
 
+/* 所有线程旋转次数之和，只在 -DTREE_STATS 时计数，详见 tree_stats.h */
 size_t avl_rotate_times();
 void avl_reset_rotate_times();
 
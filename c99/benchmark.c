@@ -1,12 +1,18 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "bst.h"
 #include "avl_tree.h"
 #include "rb_tree.h"
+#include "rb_latch.h"
+#include "tree_stats.h"
+#include "perf_counter.h"
+#include "workload.h"
 
 #include "helper.h"
 
@@ -14,6 +20,13 @@
 #define COUNTS 2000000ul
 
 
+/* 四个计时阶段，硬件计数按阶段分开累加 */
+#define PHASE_INSERT         0
+#define PHASE_SEARCH         1
+#define PHASE_DEL_ROOT       2
+#define PHASE_SEARCH_DEL     3
+#define PHASES               4
+
 /* 根据时间消耗排序用 */
 typedef struct _TIME_INFO_ {
     char name[16];
@@ -22,8 +35,11 @@ typedef struct _TIME_INFO_ {
     clock_t delet_root;
     clock_t search_delete;
     size_t  rotates;
+    double  perf[PHASES][PERF_EVENTS];  /* 各阶段的硬件计数之和 */
 } TIME_INFO;
 
+static perf_counters __perf;
+
 
 
 static TIME_INFO test_bst() {
@@ -36,45 +52,56 @@ static TIME_INFO test_bst() {
     size_t *nums = get_rand_array1(COUNTS);
     assert(nums && datas);
 
+    memset(&cpu_times, 0, sizeof(cpu_times));
     memcpy(cpu_times.name, "bst", 4);
 
     tic = clock();
+    perf_start(&__perf);
     for (i = 0; i < COUNTS; i++) {
         datas[i].key = nums[i];
         insert_bst(&root, &datas[i]);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_INSERT]);
     toc = clock();
     cpu_times.insert = toc - tic;
 
     tic = clock();
+    perf_start(&__perf);
     while (root)
         bst_erase(&root, root);
+    perf_stop(&__perf, cpu_times.perf[PHASE_DEL_ROOT]);
     toc = clock();
     cpu_times.delet_root = toc - tic;
 
     memset(datas, 0, COUNTS * sizeof(bst_t));
     tic = clock();
+    perf_start(&__perf);
     for (i = 0; i < COUNTS; i++) {
         datas[i].key = nums[i];
         insert_bst(&root, &datas[i]);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_INSERT]);
     toc = clock();
     cpu_times.insert += toc - tic;
 
     tic = clock();
+    perf_start(&__perf);
     while (cnt < 2 * COUNTS) {
         if (search_bst(&root, nums[rand() % COUNTS]))
             cnt++;
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_SEARCH]);
     toc = clock();
     cpu_times.search = toc - tic;
 
     tic = clock();
+    perf_start(&__perf);
     while (root) {
         data = search_bst(&root, nums[rand() % COUNTS]);
         if (data)
             bst_erase(&root, &data->node);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_SEARCH_DEL]);
     toc = clock();
     cpu_times.search_delete = toc - tic;
 
@@ -94,46 +121,57 @@ static TIME_INFO test_avl() {
     size_t *nums = get_rand_array1(COUNTS);
     assert(nums && datas);
 
+    memset(&cpu_times, 0, sizeof(cpu_times));
     memcpy(cpu_times.name, "avl", 4);
 
     tic = clock();
+    perf_start(&__perf);
     for (i = 0; i < COUNTS; i++) {
         datas[i].key = nums[i];
         insert_avl(&root, &datas[i]);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_INSERT]);
     toc = clock();
     cpu_times.insert = toc - tic;
 
     tic = clock();
+    perf_start(&__perf);
     while (root)
         avl_erase(&root, root);
+    perf_stop(&__perf, cpu_times.perf[PHASE_DEL_ROOT]);
     toc = clock();
     cpu_times.delet_root = toc - tic;
 
     memset(datas, 0, COUNTS * sizeof(avl_t));
     tic = clock();
+    perf_start(&__perf);
     for (i = 0; i < COUNTS; i++) {
         datas[i].key = nums[i];
         insert_avl(&root, &datas[i]);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_INSERT]);
     toc = clock();
     cpu_times.insert += toc - tic;
 
 
     tic = clock();
+    perf_start(&__perf);
     while (cnt < 2 * COUNTS) {
         if (search_avl(&root, nums[rand() % COUNTS]))
             cnt++;
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_SEARCH]);
     toc = clock();
     cpu_times.search = toc - tic;
 
     tic = clock();
+    perf_start(&__perf);
     while (root) {
         data = search_avl(&root, nums[rand() % COUNTS]);
         if (data)
             avl_erase(&root, &data->node);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_SEARCH_DEL]);
     toc = clock();
     cpu_times.search_delete = toc - tic;
 
@@ -155,46 +193,57 @@ static TIME_INFO test_rbt() {
     size_t *nums = get_rand_array2(COUNTS);
     assert(nums);
 
+    memset(&cpu_times, 0, sizeof(cpu_times));
     memcpy(cpu_times.name, "rbt", 4);
 
     tic = clock();
+    perf_start(&__perf);
     for (i = 0; i < COUNTS; i++) {
         datas[i].key = nums[i];
         insert_rbt(&root, &datas[i]);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_INSERT]);
     toc = clock();
     cpu_times.insert = toc - tic;
 
     tic = clock();
+    perf_start(&__perf);
     while (root)
         rbt_erase(&root, root);
+    perf_stop(&__perf, cpu_times.perf[PHASE_DEL_ROOT]);
     toc = clock();
     cpu_times.delet_root = toc - tic;
 
     memset(datas, 0, COUNTS * sizeof(rbt_t));
     tic = clock();
+    perf_start(&__perf);
     for (i = 0; i < COUNTS; i++) {
         datas[i].key = nums[i];
         insert_rbt(&root, &datas[i]);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_INSERT]);
     toc = clock();
     cpu_times.insert += toc - tic;
 
     tic = clock();
+    perf_start(&__perf);
     while (cnt < 2 * COUNTS) {
         if (search_rbt(&root, nums[rand() % COUNTS]))
             cnt++;
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_SEARCH]);
     toc = clock();
     cpu_times.search = toc - tic;
 
 
     tic = clock();
+    perf_start(&__perf);
     while (root) {
         data = search_rbt(&root, nums[rand() % COUNTS]);
         if (data)
             rbt_erase(&root, &data->node);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_SEARCH_DEL]);
     toc = clock();
     cpu_times.search_delete = toc - tic;
 
@@ -214,46 +263,57 @@ static TIME_INFO test_llrb() {
     size_t *nums = get_rand_array2(COUNTS);
     assert(nums);
 
+    memset(&cpu_times, 0, sizeof(cpu_times));
     memcpy(cpu_times.name, "llrb", 5);
 
     tic = clock();
+    perf_start(&__perf);
     for (i = 0; i < COUNTS; i++) {
         datas[i].key = nums[i];
         insert_llrb(&root, &datas[i]);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_INSERT]);
     toc = clock();
     cpu_times.insert = toc - tic;
 
     tic = clock();
+    perf_start(&__perf);
     while (root)
         llrb_erase(&root, root);
+    perf_stop(&__perf, cpu_times.perf[PHASE_DEL_ROOT]);
     toc = clock();
     cpu_times.delet_root = toc - tic;
 
     memset(datas, 0, COUNTS * sizeof(rbt_t));
     tic = clock();
+    perf_start(&__perf);
     for (i = 0; i < COUNTS; i++) {
         datas[i].key = nums[i];
         insert_llrb(&root, &datas[i]);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_INSERT]);
     toc = clock();
     cpu_times.insert += toc - tic;
 
     tic = clock();
+    perf_start(&__perf);
     while (cnt < 2 * COUNTS) {
         if (search_llrb(&root, nums[rand() % COUNTS]))
             cnt++;
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_SEARCH]);
     toc = clock();
     cpu_times.search = toc - tic;
 
 
     tic = clock();
+    perf_start(&__perf);
     while (root) {
         data = search_llrb(&root, nums[rand() % COUNTS]);
         if (data)
             llrb_erase(&root, &data->node);
     }
+    perf_stop(&__perf, cpu_times.perf[PHASE_SEARCH_DEL]);
     toc = clock();
     cpu_times.search_delete = toc - tic;
 
@@ -273,21 +333,399 @@ static void benchmark() {
     printf("#\tinsert\tsearch\tdel_root\tsearch_del\trotates\n");
 
     for (i = 0; i < 4; i++) {
-        printf("%s\t%ld\t%ld\t%ld\t\t%ld\t\t%ld\n", 
+        printf("%s\t%ld\t%ld\t%ld\t\t%ld\t\t", 
         cpu_times[i].name, 
         cpu_times[i].insert,
         cpu_times[i].search, 
         cpu_times[i].delet_root, 
-        cpu_times[i].search_delete,
-        cpu_times[i].rotates);
+        cpu_times[i].search_delete);
+#ifdef TREE_STATS
+        printf("%zu\n", cpu_times[i].rotates);
+#else
+        printf("-\n");          /* 没有计数，*_rotate_times() 恒为 0 */
+#endif
+    }
+
+#ifdef TREE_STATS
+    printf("\n#\trecolors\tinsert_depth\terase_depth\n");
+    for (i = 1; i < 4; i++) {
+        tree_stats stats;
+        tree_stats_get(TREE_STATS_AVL + i - 1, &stats);
+        printf("%s\t%zu\t%.2f\t\t%.2f\n", cpu_times[i].name, stats.recolors,
+               stats.inserts ? (double)stats.insert_depth / stats.inserts : 0.0,
+               stats.erases ? (double)stats.erase_depth / stats.erases : 0.0);
     }
+#else
+    printf("(rotates are counted only in benchmark_stats)\n");
+#endif
+
+    /* 每个阶段按成功的操作数平均：插入两轮、查找命中 2 * COUNTS 次、删除 COUNTS 次 */
+    if (__perf.opened) {
+        static const char *phases[PHASES] = {"insert", "search", "del_root", "search_del"};
+        static const size_t ops[PHASES] = {2 * COUNTS, 2 * COUNTS, COUNTS, COUNTS};
+        int p;
+        printf("\n#\tphase");
+        perf_print_header(&__perf, stdout);
+        printf("\n");
+        for (i = 0; i < 4; i++)
+            for (p = 0; p < PHASES; p++) {
+                printf("%s\t%s", cpu_times[i].name, phases[p]);
+                perf_print(&__perf, stdout, cpu_times[i].perf[p], ops[p]);
+                printf("\n");
+            }
+    } else
+        printf("\nperf counters unavailable (%s), clock() only\n", __perf.error);
+}
+
+
 
+/**
+ * 一个写者不停地删除、再插回随机元素，READERS 个读者随机查找，统计读者的吞吐：
+ *   latch   读者走 rbt_latch_find，不加锁
+ *   rwlock  同一棵 rb_tree 外面套 pthread_rwlock
+ */
+#define LATCH_COUNTS  1000000ul
+#define LATCH_SECONDS 0.5
+#define MAX_READERS   8
+
+typedef struct latch_t latch_t;
+struct latch_t {
+    size_t key;
+    rb_latch_node node;
+};
+
+typedef struct {
+    int use_latch;
+    volatile int stop;
+    size_t *nums;
+    latch_t *latchs;
+    rbt_t *rbts;
+    rb_latch_tree latch;
+    rb_node *root;
+    pthread_rwlock_t lock;
+} LATCH_BENCH;
+
+typedef struct {
+    LATCH_BENCH *bench;
+    size_t seed;
+    size_t lookups;
+} READER_ARG;
+
+static int latch_less(const rb_latch_node *a, const rb_latch_node *b) {
+    return RB_TREE_ENTRY(a, latch_t, node)->key < RB_TREE_ENTRY(b, latch_t, node)->key;
 }
 
+static int latch_comp(const void *key, const rb_latch_node *node) {
+    size_t k = *(const size_t *)key, x = RB_TREE_ENTRY(node, latch_t, node)->key;
+    return k < x ? -1 : k > x;
+}
+
+static void *latch_writer(void *arg) {
+    LATCH_BENCH *b = (LATCH_BENCH *)arg;
+    size_t i, seed = 1;
+    while (!__atomic_load_n(&b->stop, __ATOMIC_RELAXED)) {
+        seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+        i = (seed >> 33) % LATCH_COUNTS;
+        if (b->use_latch) {
+            rbt_latch_erase(&b->latch, &b->latchs[i].node);
+            rbt_latch_insert(&b->latch, &b->latchs[i].node, latch_less);
+        } else {
+            pthread_rwlock_wrlock(&b->lock);
+            rbt_erase(&b->root, &b->rbts[i].node);
+            insert_rbt(&b->root, &b->rbts[i]);
+            pthread_rwlock_unlock(&b->lock);
+        }
+    }
+    return NULL;
+}
+
+static void *latch_reader(void *arg) {
+    READER_ARG *r = (READER_ARG *)arg;
+    LATCH_BENCH *b = r->bench;
+    size_t key, found = 0;
+    while (!__atomic_load_n(&b->stop, __ATOMIC_RELAXED)) {
+        r->seed = r->seed * 6364136223846793005ul + 1442695040888963407ul;
+        key = b->nums[(r->seed >> 33) % LATCH_COUNTS];
+        if (b->use_latch) {
+            found += NULL != rbt_latch_find(&b->latch, &key, latch_comp);
+        } else {
+            pthread_rwlock_rdlock(&b->lock);
+            found += NULL != search_rbt(&b->root, key);
+            pthread_rwlock_unlock(&b->lock);
+        }
+        r->lookups++;
+    }
+    assert(found);
+    return NULL;
+}
 
+/* 返回读者每秒的总查找次数 */
+static double latch_run(LATCH_BENCH *b, int readers) {
+    int i;
+    size_t lookups = 0;
+    pthread_t writer, tids[MAX_READERS];
+    READER_ARG args[MAX_READERS];
+    struct timespec tic, toc, nap = {0, (long)(LATCH_SECONDS * 1e9)};
+
+    b->stop = 0;
+    clock_gettime(CLOCK_MONOTONIC, &tic);
+    pthread_create(&writer, NULL, latch_writer, b);
+    for (i = 0; i < readers; i++) {
+        args[i].bench = b;
+        args[i].seed = i + 1;
+        args[i].lookups = 0;
+        pthread_create(&tids[i], NULL, latch_reader, &args[i]);
+    }
+    nanosleep(&nap, NULL);
+    __atomic_store_n(&b->stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < readers; i++) {
+        pthread_join(tids[i], NULL);
+        lookups += args[i].lookups;
+    }
+    pthread_join(writer, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &toc);
+    return lookups / ((toc.tv_sec - tic.tv_sec) + (toc.tv_nsec - tic.tv_nsec) * 1e-9);
+}
+
+static void latch_benchmark() {
+    size_t i;
+    int readers;
+    LATCH_BENCH b;
+    rb_latch_tree empty = RB_LATCH_TREE_INIT;
+
+    memset(&b, 0, sizeof(b));
+    b.latch = empty;
+    b.nums = get_rand_array1(LATCH_COUNTS);
+    b.latchs = (latch_t *)calloc(LATCH_COUNTS, sizeof(latch_t));
+    b.rbts = (rbt_t *)calloc(LATCH_COUNTS, sizeof(rbt_t));
+    assert(b.nums && b.latchs && b.rbts);
+    pthread_rwlock_init(&b.lock, NULL);
+
+    for (i = 0; i < LATCH_COUNTS; i++) {
+        b.latchs[i].key = b.rbts[i].key = b.nums[i];
+        rbt_latch_insert(&b.latch, &b.latchs[i].node, latch_less);
+        insert_rbt(&b.root, &b.rbts[i]);
+    }
+
+    printf("\n#readers\tlatch(M/s)\trwlock(M/s)\tretries\n");
+    for (readers = 1; readers <= MAX_READERS; readers *= 2) {
+        double latch, rwlock;
+        rbt_latch_reset_retries();
+        b.use_latch = 1;
+        latch = latch_run(&b, readers);
+        b.use_latch = 0;
+        rwlock = latch_run(&b, readers);
+        printf("%d\t\t%.2f\t\t%.2f\t\t%zu\n", readers, latch / 1e6, rwlock / 1e6,
+               rbt_latch_retries());
+    }
+
+    pthread_rwlock_destroy(&b.lock);
+    drop_random_array(b.nums);
+    free(b.latchs);
+    free(b.rbts);
+}
+
+
+/**
+ * 用 workload.h 生成的键和操作序列驱动四种树：
+ *   key_dist_benchmark  每种键分布插入 DIST_COUNTS 个键（重复的跳过），再按同样的顺序查找一遍，
+ *                       另外输出树高和成功查找的平均路径长度（shape_*()），把查找耗时与形状对应起来
+ *   ycsb_benchmark      装载 YCSB_RECORDS 条记录后执行 YCSB_OPS 次 A ~ F 的操作
+ * 四种树的插入、查找和有序扫描经 engine 的函数指针统一调用，节点由 malloc 分配。
+ */
+#define DIST_COUNTS   1000000ul
+#define YCSB_RECORDS  1000000ul
+#define YCSB_OPS      2000000ul
+#define WORKLOAD_SEED 20211019ull
+
+typedef struct engine engine;
+struct engine {
+    const char *name;
+    int     (*insert)(void **root, size_t key);     /* 键已存在时返回 -1 */
+    int     (*find)(void **root, size_t key);
+    size_t  (*scan)(void **root, size_t key, size_t len);   /* 从 key 起按序访问 len 个，返回访问的个数 */
+    void    (*clear)(void **root);
+    void    (*shape)(void **root, tree_shape *shape);
+};
+
+#define ENGINE_INSERT(type, tree)                                           \
+    static int engine_insert_##tree(void **root, size_t key) {              \
+        type *data = (type *)calloc(1, sizeof(type));                       \
+        assert(data);                                                       \
+        data->key = key;                                                    \
+        if (0 == insert_##tree((void *)root, data)) return 0;               \
+        free(data);                                                         \
+        return -1;                                                          \
+    }                                                                       \
+    static int engine_find_##tree(void **root, size_t key) {                \
+        return NULL != search_##tree((void *)root, key);                    \
+    }                                                                       \
+    static void engine_shape_##tree(void **root, tree_shape *shape) {       \
+        shape_##tree(*root, shape);                                         \
+    }
+
+ENGINE_INSERT(bst_t, bst)
+ENGINE_INSERT(avl_t, avl)
+ENGINE_INSERT(rbt_t, rbt)
+ENGINE_INSERT(llrb_t, llrb)
+
+static size_t engine_scan_bst(void **root, size_t key, size_t len) {
+    bst_t *data = search_bst((bst_node **)root, key);
+    bst_node *node = data ? &data->node : NULL;
+    size_t n = 0;
+    for (; node && n < len; node = bst_next(node)) n++;
+    return n;
+}
+
+static size_t engine_scan_avl(void **root, size_t key, size_t len) {
+    avl_t *data = search_avl((avl_node **)root, key);
+    avl_node *node = data ? &data->node : NULL;
+    size_t n = 0;
+    for (; node && n < len; node = avl_next(node)) n++;
+    return n;
+}
+
+static size_t engine_scan_rbt(void **root, size_t key, size_t len) {
+    rbt_t *data = search_rbt((rb_node **)root, key);
+    rb_node *node = data ? &data->node : NULL;
+    size_t n = 0;
+    for (; node && n < len; node = rbt_next(node)) n++;
+    return n;
+}
+
+static size_t engine_scan_llrb(void **root, size_t key, size_t len) {
+    llrb_t *data = search_llrb((llrb_node **)root, key);
+    llrb_node *node = data ? &data->node : NULL;
+    size_t n = 0;
+    for (; node && n < len; node = llrb_next(node)) n++;
+    return n;
+}
+
+static void engine_clear_bst(void **root) {
+    while (*root) {
+        bst_node *node = (bst_node *)*root;
+        bst_erase((bst_node **)root, node);
+        free(BST_ENTRY(node, bst_t, node));
+    }
+}
+
+static void engine_clear_avl(void **root) {
+    while (*root) {
+        avl_node *node = (avl_node *)*root;
+        avl_erase((avl_node **)root, node);
+        free(AVL_ENTRY(node, avl_t, node));
+    }
+}
+
+static void engine_clear_rbt(void **root) {
+    while (*root) {
+        rb_node *node = (rb_node *)*root;
+        rbt_erase((rb_node **)root, node);
+        free(RB_TREE_ENTRY(node, rbt_t, node));
+    }
+}
+
+static void engine_clear_llrb(void **root) {
+    while (*root) {
+        llrb_node *node = (llrb_node *)*root;
+        llrb_erase((llrb_node **)root, node);
+        free(LLRB_TREE_ENTRY(node, llrb_t, node));
+    }
+}
+
+static const engine engines[4] = {
+    {"bst",  engine_insert_bst,  engine_find_bst,  engine_scan_bst,  engine_clear_bst,  engine_shape_bst},
+    {"avl",  engine_insert_avl,  engine_find_avl,  engine_scan_avl,  engine_clear_avl,  engine_shape_avl},
+    {"rbt",  engine_insert_rbt,  engine_find_rbt,  engine_scan_rbt,  engine_clear_rbt,  engine_shape_rbt},
+    {"llrb", engine_insert_llrb, engine_find_llrb, engine_scan_llrb, engine_clear_llrb, engine_shape_llrb},
+};
+
+/* 有序的键会让不平衡的 bst 退化成链表，bst 只跑无序的分布 */
+static void key_dist_benchmark() {
+    int dist, e;
+    size_t i;
+    printf("\n#dist\t\ttree\tinsert\tfind\tdistinct\theight\tavg_path\n");
+    for (dist = 0; dist < KEY_DISTS; dist++) {
+        uint64_t *keys = make_keys(dist, DIST_COUNTS, WORKLOAD_SEED);
+        assert(keys);
+        for (e = 0; e < 4; e++) {
+            void *root = NULL;
+            size_t distinct = 0, hits = 0;
+            tree_shape shape;
+            clock_t tic, toc, insert;
+            if (0 == e && KEY_UNIFORM != dist && KEY_ZIPF != dist && KEY_CLUSTERED != dist)
+                continue;
+            tic = clock();
+            for (i = 0; i < DIST_COUNTS; i++)
+                distinct += 0 == engines[e].insert(&root, keys[i]);
+            toc = clock();
+            insert = toc - tic;
+            tic = clock();
+            for (i = 0; i < DIST_COUNTS; i++)
+                hits += engines[e].find(&root, keys[i]);
+            toc = clock();
+            assert(DIST_COUNTS == hits);
+            engines[e].shape(&root, &shape);
+            printf("%-10s\t%s\t%ld\t%ld\t%zu\t%zu\t%.2f\n", KEY_DIST_NAMES[dist], engines[e].name,
+                   (long)insert, (long)(toc - tic), distinct, shape.height, (double)shape.path / shape.nodes);
+            shape_drop(&shape);
+            engines[e].clear(&root);
+        }
+        free(keys);
+    }
+}
+
+static void ycsb_benchmark() {
+    char workload;
+    int e;
+    size_t i;
+    printf("\n#ycsb\ttree\tclock\tops/s(M)\n");
+    for (workload = 'A'; workload <= 'F'; workload++) {
+        for (e = 0; e < 4; e++) {
+            void *root = NULL;
+            size_t hits = 0;
+            ycsb_gen gen;
+            ycsb_op op;
+            clock_t tic, toc;
+            int res = ycsb_init(&gen, workload, YCSB_RECORDS, WORKLOAD_SEED);
+            assert(0 == res);
+            (void)res;
+            for (i = 0; i < YCSB_RECORDS; i++)
+                engines[e].insert(&root, ycsb_key(i));
+
+            tic = clock();
+            for (i = 0; i < YCSB_OPS; i++) {
+                ycsb_next(&gen, &op);
+                switch (op.type) {
+                case YCSB_READ:
+                case YCSB_UPDATE:       /* 值就在节点里，原地更新与查找的代价相同 */
+                case YCSB_RMW:
+                    hits += engines[e].find(&root, op.key);
+                    break;
+                case YCSB_INSERT:
+                    engines[e].insert(&root, op.key);
+                    break;
+                case YCSB_SCAN:
+                    hits += engines[e].scan(&root, op.key, op.scan);
+                    break;
+                }
+            }
+            toc = clock();
+            assert(hits > 0);
+            printf("%c\t%s\t%ld\t%.2f\n", workload, engines[e].name, (long)(toc - tic),
+                   YCSB_OPS / ((double)(toc - tic) / CLOCKS_PER_SEC) / 1e6);
+            engines[e].clear(&root);
+        }
+    }
+}
 
 
 int main() {
+    perf_open(&__perf);
     benchmark();
+    perf_close(&__perf);
+    latch_benchmark();
+    key_dist_benchmark();
+    ycsb_benchmark();
     return 0;
 }
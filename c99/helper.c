@@ -399,6 +399,98 @@ void print_llrb(llrb_node *root) {
 
 
 
+/**
+ * 树的形状
+*/
+/* 第一次到达深度为 d 的节点 */
+static void shape_visit(tree_shape *shape, size_t d) {
+    if (d == shape->height) {
+        if (d == shape->capacity) {
+            shape->capacity = shape->capacity ? 2 * shape->capacity : 64;
+            shape->depth = (size_t *)realloc(shape->depth, shape->capacity * sizeof(size_t));
+            assert(shape->depth);
+        }
+        shape->depth[shape->height++] = 0;
+    }
+    shape->depth[d]++;
+    shape->nodes++;
+    shape->path += d + 1;
+}
+
+/* 有空孩子的节点，blacks 为根到它（含两端）的黑节点数 */
+static void shape_leaf(tree_shape *shape, long blacks, int *seen) {
+    if (!*seen)
+        shape->black_height = blacks;
+    else if (shape->black_height != blacks)
+        shape->black_height = -1;
+    *seen = 1;
+}
+
+/* 中序遍历：从父亲下来时先访问再进左子树，从左孩子回来时进右子树，从右孩子回来时继续回溯 */
+#define DEFINE_SHAPE(name, type, colored, is_red)                               \
+void name(type *root, tree_shape *shape) {                                      \
+    type *node = root, *prev = NULL;                                            \
+    size_t d = 0;                                                               \
+    long blacks = 0;                                                            \
+    int seen = 0;                                                               \
+    memset(shape, 0, sizeof(*shape));                                           \
+    while (node) {                                                              \
+        if (NULL == prev ? node == root : prev == node->parent) {               \
+            shape_visit(shape, d);                                              \
+            if (colored) {                                                      \
+                if (is_red(node)) shape->red++;                                 \
+                else blacks++;                                                  \
+                if (NULL == node->left || NULL == node->right)                  \
+                    shape_leaf(shape, blacks, &seen);                           \
+            }                                                                   \
+            if (node->left) {                                                   \
+                prev = node;                                                    \
+                node = node->left;                                              \
+                d++;                                                            \
+                continue;                                                       \
+            }                                                                   \
+        }                                                                       \
+        if (prev != node->right && node->right) {                               \
+            prev = node;                                                        \
+            node = node->right;                                                 \
+            d++;                                                                \
+            continue;                                                           \
+        }                                                                       \
+        if (colored && !is_red(node)) blacks--;                                 \
+        if (node == root) break;            /* root 可以是一棵子树 */           \
+        prev = node;                                                            \
+        node = node->parent;                                                    \
+        d--;                                                                    \
+    }                                                                           \
+}
+
+#define shape_no_color(node)    0
+#define shape_rb_red(node)      (RB_RED == (node)->color)
+#define shape_llrb_red(node)    (LLRB_RED == (node)->color)
+
+DEFINE_SHAPE(shape_bst, bst_node, 0, shape_no_color)
+DEFINE_SHAPE(shape_avl, avl_node, 0, shape_no_color)
+DEFINE_SHAPE(shape_rbt, rb_node, 1, shape_rb_red)
+DEFINE_SHAPE(shape_llrb, llrb_node, 1, shape_llrb_red)
+
+/* name  nodes  height  avg_path  red%  black_height，下一行是各层的节点数 */
+void shape_print(const char *name, const tree_shape *shape) {
+    size_t d;
+    printf("%s\t%zu\t%zu\t%.2f\t%.1f%%\t%ld\n", name, shape->nodes, shape->height,
+           shape->nodes ? (double)shape->path / shape->nodes : 0.0,
+           shape->nodes ? 100.0 * shape->red / shape->nodes : 0.0, shape->black_height);
+    printf("\tdepth");
+    for (d = 0; d < shape->height; d++)
+        printf(" %zu", shape->depth[d]);
+    printf("\n");
+}
+
+void shape_drop(tree_shape *shape) {
+    free(shape->depth);
+    memset(shape, 0, sizeof(*shape));
+}
+
+
 /* 通过随机交换获取随机值，能保证没有重复值 */
 size_t *get_rand_array1(size_t size) {
     size_t i, x, y, tmp, *nums;
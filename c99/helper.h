@@ -34,6 +34,18 @@ struct llrb_t {
     llrb_node node;
 };
 
+/* 树的形状，由 shape_*() 填写，用完调用 shape_drop() */
+typedef struct tree_shape tree_shape;
+struct tree_shape {
+    size_t  nodes;
+    size_t  height;         /* 层数，空树为 0 */
+    size_t  path;           /* 各节点深度加一之和，除以 nodes 是成功查找平均访问的节点数 */
+    size_t  red;            /* 红节点数，bst 和 avl 为 0 */
+    long    black_height;   /* 根到每个空链接经过的黑节点数（含根），不一致时为 -1；bst 和 avl 为 0 */
+    size_t *depth;          /* depth[d] 为第 d 层的节点数，根在第 0 层，共 height 项 */
+    size_t  capacity;       /* depth 数组的容量 */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -45,6 +57,17 @@ void print_avl(avl_node *root);
 void print_rbt(rb_node *root);
 void print_llrb(llrb_node *root);
 
+/**
+ * 一次迭代遍历统计树的形状：沿 parent 指针回溯，不递归也不用栈，没有层数上限，
+ * 2000 万个节点的树也能用，而上面的 print_*() 只适合几十个节点。
+ */
+void shape_bst(bst_node *root, tree_shape *shape);
+void shape_avl(avl_node *root, tree_shape *shape);
+void shape_rbt(rb_node *root, tree_shape *shape);
+void shape_llrb(llrb_node *root, tree_shape *shape);
+void shape_print(const char *name, const tree_shape *shape);
+void shape_drop(tree_shape *shape);
+
 size_t *get_rand_array1(size_t size);
 size_t *get_rand_array2(size_t size);
 void drop_random_array(size_t *nums);
@@ -3,6 +3,7 @@
 #include <stdio.h>
 
 #include "llrb_tree.h"
+#include "tree_stats.h"
 
 
 static inline _Bool llrb_is_red(llrb_node *node) {
@@ -14,8 +15,6 @@ static inline void llrb_set_red(llrb_node *node) {
 }
 
 
-static size_t __rotates = 0;
-
 /**
  *       parent                       parent
  *        |                            |
@@ -49,7 +48,7 @@ static llrb_node *llrbtree_right_rotate(llrb_node **root, llrb_node *y) {
     x->color = y->color;
     llrb_set_red(x->right);
 
-    __rotates++;
+    TREE_STAT(TREE_STATS_LLRB, rotations, 1);
     // printf("%s\n", __func__);
 
     return x;
@@ -79,7 +78,7 @@ static llrb_node *llrbtree_left_rotate(llrb_node **root, llrb_node *x) {
     y->color = x->color;
     llrb_set_red(y->left);
 
-    __rotates++;
+    TREE_STAT(TREE_STATS_LLRB, rotations, 1);
     // printf("%s\n", __func__);
     return y;
 }
@@ -89,12 +88,18 @@ static void color_flip(llrb_node *node) {
         node->color = !(node->color);
         if (node->left)  node->left->color = !(node->left->color);
         if (node->right) node->right->color = !(node->right->color);
+        TREE_STAT(TREE_STATS_LLRB, recolors, 3);
         // printf("%s\n", __func__);
     }
 }
 
-void llrb_fix_up(llrb_node **root, llrb_node *node) {
+/* erase 非 0 时向上的层数记在删除名下 */
+static void __llrb_fix_up(llrb_node **root, llrb_node *node, int erase) {
     if (NULL == node) return;
+    if (erase)
+        TREE_STAT(TREE_STATS_LLRB, erase_depth, 1);
+    else
+        TREE_STAT(TREE_STATS_LLRB, insert_depth, 1);
     if (llrb_is_red(node->right))
         node = llrbtree_left_rotate(root, node);
     if (node->left && llrb_is_red(node->left) && llrb_is_red(node->left->left))
@@ -104,7 +109,12 @@ void llrb_fix_up(llrb_node **root, llrb_node *node) {
         color_flip(node);
 
     // bottom-up
-    llrb_fix_up(root, node->parent);
+    __llrb_fix_up(root, node->parent, erase);
+}
+
+void llrb_fix_up(llrb_node **root, llrb_node *node) {
+    TREE_STAT(TREE_STATS_LLRB, inserts, 1);
+    __llrb_fix_up(root, node, 0);
 }
 
 void llrb_erase(llrb_node **root, llrb_node *node) {
@@ -166,12 +176,40 @@ void llrb_erase(llrb_node **root, llrb_node *node) {
             *root = child;
     }
 
-    llrb_fix_up(root, parent);
+    TREE_STAT(TREE_STATS_LLRB, erases, 1);
+    __llrb_fix_up(root, parent, 1);
 }
 
 
+llrb_node *llrb_next(llrb_node *node) {
+    llrb_node *parent;
+    if (node == NULL) return NULL;
+
+    if (node->right) {
+        node = node->right; 
+        while (node->left)
+            node=node->left;
+        return node;
+    }
+    while ((parent = node->parent) && node == parent->right)
+        node = parent;
 
+    return parent;
+}
+
+llrb_node *llrb_first(llrb_node *root) {
+    if (NULL == root) return NULL;
+    while (root->left)
+        root = root->left;
+    return root;
+}
+
+
+size_t llrb_rotate_times() {
+    tree_stats stats;
+    tree_stats_get(TREE_STATS_LLRB, &stats);
+    return stats.rotations;
+}
 
-size_t llrb_rotate_times() { return __rotates; }
-void llrb_reset_rotate_times() { __rotates = 0; }
+void llrb_reset_rotate_times() { tree_stats_reset(TREE_STATS_LLRB); }
 
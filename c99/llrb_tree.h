@@ -26,6 +26,10 @@ extern "C" {
 void llrb_fix_up(llrb_node **root, llrb_node *node);
 void llrb_erase(llrb_node **root, llrb_node *node);
 
+llrb_node *llrb_next(llrb_node *node);
+llrb_node *llrb_first(llrb_node *root);
+
+/* 所有线程旋转次数之和，只在 -DTREE_STATS 时计数，详见 tree_stats.h */
 size_t llrb_rotate_times();
 void llrb_reset_rotate_times();
 
@@ -0,0 +1,123 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdint.h>
+
+#include "perf_counter.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PERF_CACHE_MISS(id)  \
+        ((id) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const uint32_t __types[PERF_EVENTS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+    PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+};
+
+static const uint64_t __configs[PERF_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D),
+    PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_LL),
+    PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB),
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+#endif
+
+const char *const PERF_NAMES[PERF_EVENTS] = {
+    "cycles", "instr", "L1D-miss", "LLC-miss", "dTLB-miss", "br-miss"
+};
+
+void perf_open(perf_counters *pc) {
+    int i;
+    memset(pc, 0, sizeof(perf_counters));
+    for (i = 0; i < PERF_EVENTS; i++)
+        pc->fds[i] = -1;
+#ifdef __linux__
+    for (i = 0; i < PERF_EVENTS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = __types[i];
+        attr.config = __configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        pc->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (pc->fds[i] >= 0)
+            pc->opened++;
+        else if (NULL == pc->error)
+            pc->error = strerror(errno);
+    }
+#else
+    pc->error = "perf_event_open is Linux only";
+#endif
+}
+
+void perf_close(perf_counters *pc) {
+    int i;
+    for (i = 0; i < PERF_EVENTS; i++) {
+#ifdef __linux__
+        if (pc->fds[i] >= 0) close(pc->fds[i]);
+#endif
+        pc->fds[i] = -1;
+    }
+    pc->opened = 0;
+}
+
+void perf_start(perf_counters *pc) {
+#ifdef __linux__
+    int i;
+    for (i = 0; i < PERF_EVENTS; i++) {
+        if (pc->fds[i] < 0) continue;
+        ioctl(pc->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(pc->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)pc;
+#endif
+}
+
+void perf_stop(perf_counters *pc, double *sum) {
+    int i;
+#ifdef __linux__
+    for (i = 0; i < PERF_EVENTS; i++)
+        if (pc->fds[i] >= 0) ioctl(pc->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+    for (i = 0; i < PERF_EVENTS; i++) {
+        pc->values[i] = 0;
+#ifdef __linux__
+        {
+            uint64_t data[3] = {0, 0, 0};  /* value, time_enabled, time_running */
+            if (pc->fds[i] >= 0 && read(pc->fds[i], data, sizeof(data)) == (ssize_t)sizeof(data)
+                && data[2])
+                pc->values[i] = (double)data[0] * data[1] / data[2];
+        }
+#endif
+        if (sum) sum[i] += pc->values[i];
+    }
+}
+
+void perf_print_header(const perf_counters *pc, FILE *out) {
+    int i;
+    if (0 == pc->opened) return;
+    for (i = 0; i < PERF_EVENTS; i++)
+        fprintf(out, "\t%s/op", PERF_NAMES[i]);
+}
+
+void perf_print(const perf_counters *pc, FILE *out, const double *sum, size_t ops) {
+    int i;
+    if (0 == pc->opened) return;
+    for (i = 0; i < PERF_EVENTS; i++) {
+        if (pc->fds[i] >= 0 && ops)
+            fprintf(out, "\t%.2f", sum[i] / ops);
+        else
+            fprintf(out, "\t-");
+    }
+}
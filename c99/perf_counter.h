@@ -0,0 +1,55 @@
+/**
+ * @file perf_counter.h
+ * @author luyiran @ 872289455@qq.com
+ * @brief hardware performance counters (perf_event_open) for the benchmark
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#ifndef __PERF_COUNTER_H__
+#define __PERF_COUNTER_H__
+#include <stdio.h>
+
+#define PERF_EVENTS 6
+
+typedef struct perf_counters perf_counters;
+
+/**
+ * 本线程（不含内核态）的 cycles、instructions、L1D/LLC/dTLB 读缺失和分支预测失败。
+ * 每个事件单独打开，打不开的事件记为缺失（fd 为 -1），一个都打不开时 opened 为 0，
+ * perf_print() 不输出任何内容，调用者退回只用 clock() 计时。
+ * 内核分时复用计数器时，读数按 time_enabled / time_running 放大。
+ */
+struct perf_counters {
+    int         fds[PERF_EVENTS];
+    int         opened;
+    const char *error;              /* 第一个打不开的事件的原因 */
+    double      values[PERF_EVENTS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const char *const PERF_NAMES[PERF_EVENTS];
+
+void perf_open(perf_counters *pc);
+void perf_close(perf_counters *pc);
+
+/* 清零并开始计数 */
+void perf_start(perf_counters *pc);
+/* 停止计数，把这一段的值累加到 sum[]（sum 可以为 NULL），values[] 保存这一段的值 */
+void perf_stop(perf_counters *pc, double *sum);
+
+/* "\tcycles/op\tinstr/op..." */
+void perf_print_header(const perf_counters *pc, FILE *out);
+/* sum[] 除以 ops 后输出，缺失的事件输出 "-" */
+void perf_print(const perf_counters *pc, FILE *out, const double *sum, size_t ops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !__PERF_COUNTER_H__ */
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rb_latch.h"
+
+
+static size_t __retries = 0;
+
+/* 第 idx 棵树上的节点所属的元素 */
+#define rb_latch_entry(ptr, idx)    RB_TREE_ENTRY(((ptr) - (idx)), rb_latch_node, node)
+
+/* 写者：seq 加一，前后的 release fence 保证“改 seq”与“改树”之间不会被重排 */
+static inline void rb_latch_raise(rb_latch_tree *tree) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&tree->seq, tree->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void __latch_insert(rb_latch_tree *tree, rb_latch_node *node, int idx,
+                           rb_latch_less less) {
+    rb_node **pos = &tree->tree[idx];
+    rb_node *parent = NULL;
+    while (*pos) {
+        parent = *pos;
+        if (less(node, rb_latch_entry(parent, idx)))
+            pos = &parent->left;
+        else
+            pos = &parent->right;
+    }
+    rb_link_node(parent, &node->node[idx], pos);
+    rbt_insert(&tree->tree[idx], &node->node[idx]);
+}
+
+void rbt_latch_insert(rb_latch_tree *tree, rb_latch_node *node, rb_latch_less less) {
+    rb_latch_raise(tree);
+    __latch_insert(tree, node, 0, less);
+    rb_latch_raise(tree);
+    __latch_insert(tree, node, 1, less);
+}
+
+void rbt_latch_erase(rb_latch_tree *tree, rb_latch_node *node) {
+    rb_latch_raise(tree);
+    rbt_erase(&tree->tree[0], &node->node[0]);
+    rb_latch_raise(tree);
+    rbt_erase(&tree->tree[1], &node->node[1]);
+}
+
+/* 在第 idx 棵树上查找；形状不对（步数超限）时置 *torn */
+static rb_latch_node *__latch_find(rb_node *pos, int idx, const void *key,
+                                   rb_latch_comp comp, int *torn) {
+    unsigned hops = 0;
+    while (pos) {
+        rb_latch_node *this = rb_latch_entry(pos, idx);
+        int c = comp(key, this);
+        if (0 == c)
+            return this;
+        if (++hops > RB_LATCH_MAX_HOPS) {
+            *torn = 1;
+            return NULL;
+        }
+        pos = c < 0 ? __atomic_load_n(&pos->left, __ATOMIC_RELAXED)
+                    : __atomic_load_n(&pos->right, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+rb_latch_node *rbt_latch_find(rb_latch_tree *tree, const void *key, rb_latch_comp comp) {
+    rb_latch_node *node;
+    unsigned seq;
+    int torn;
+
+    for (;;) {
+        seq = __atomic_load_n(&tree->seq, __ATOMIC_ACQUIRE);
+        torn = 0;
+        node = __latch_find(__atomic_load_n(&tree->tree[seq & 1], __ATOMIC_RELAXED),
+                            seq & 1, key, comp, &torn);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!torn && seq == __atomic_load_n(&tree->seq, __ATOMIC_RELAXED))
+            return node;
+        __atomic_fetch_add(&__retries, 1, __ATOMIC_RELAXED);
+    }
+}
+
+size_t rbt_latch_retries() { return __atomic_load_n(&__retries, __ATOMIC_RELAXED); }
+void rbt_latch_reset_retries() { __atomic_store_n(&__retries, 0, __ATOMIC_RELAXED); }
@@ -0,0 +1,71 @@
+/**
+ * @file rb_latch.h
+ * @author luyiran @ 872289455@qq.com
+ * @brief latched red-black tree: lock-free lookups over two tree copies
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef __RB_LATCH_TREE_H__
+#define __RB_LATCH_TREE_H__
+#include "rb_tree.h"
+
+/**
+ * 仿照 Linux 的 rbtree_latch：每个元素嵌入两个 rb_node，分别挂在两棵树上。
+ * 写者先把 seq 加一（变成奇数）再改 tree[0]，再加一（变成偶数）再改 tree[1]，
+ * 读者在 tree[seq & 1] 上查找，这棵树此刻没有写者在改；
+ * 查找结束后 seq 变了就重试，因此读者从不加锁，也从不阻塞写者。
+ *
+ * 读者可能与下一轮修改重叠，看到旋转中途的形状（例如右旋时 x->right = y 而 y->left 仍是 x，
+ * 形成暂时的环），所以一次查找最多走 RB_LATCH_MAX_HOPS 步，超过就当作失败重试。
+ *
+ * 使用约束：
+ *   - 写者之间需要调用者自己互斥；
+ *   - 元素的键在挂在树上期间不能修改；
+ *   - 删除后的元素可能仍被读者访问，只能原样再插回去，
+ *     或者等所有在删除之前开始的查找都结束后再释放（库本身不提供宽限期）。
+ */
+#define RB_LATCH_MAX_HOPS   (128u)
+
+typedef struct rb_latch_node rb_latch_node;
+typedef struct rb_latch_tree rb_latch_tree;
+
+struct rb_latch_node {
+    rb_node node[2];
+};
+
+struct rb_latch_tree {
+    unsigned seq;
+    rb_node *tree[2];
+};
+
+/* a 的键小于 b 的键时返回非 0 */
+typedef int (*rb_latch_less)(const rb_latch_node *a, const rb_latch_node *b);
+/* key 小于、等于、大于 node 的键时分别返回负数、0、正数 */
+typedef int (*rb_latch_comp)(const void *key, const rb_latch_node *node);
+
+#define RB_LATCH_TREE_INIT  { 0, { NULL, NULL } }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 两个写入接口都要求调用者保证同一时刻只有一个写者，键重复时插入在右边 */
+void rbt_latch_insert(rb_latch_tree *tree, rb_latch_node *node, rb_latch_less less);
+void rbt_latch_erase(rb_latch_tree *tree, rb_latch_node *node);
+
+/* 可与写者并发调用，不加锁；没有找到返回 NULL */
+rb_latch_node *rbt_latch_find(rb_latch_tree *tree, const void *key, rb_latch_comp comp);
+
+/* 查找因 seq 变化或步数超限而重试的总次数 */
+size_t rbt_latch_retries();
+void rbt_latch_reset_retries();
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* !__RB_LATCH_TREE_H__ */
@@ -4,16 +4,15 @@
 #include <time.h>
 
 #include "rb_tree.h"
+#include "tree_stats.h"
 
 
 #define rbt_is_red(node)     (RB_RED == (node)->color)
 #define rbt_is_black(node)   (RB_BLACK == (node)->color)
-#define rbt_set_red(node)    ((node)->color = RB_RED)
-#define rbt_set_black(node)  ((node)->color = RB_BLACK)
+#define rbt_set_red(node)    (TREE_STAT(TREE_STATS_RBT, recolors, 1), (node)->color = RB_RED)
+#define rbt_set_black(node)  (TREE_STAT(TREE_STATS_RBT, recolors, 1), (node)->color = RB_BLACK)
 
 
-static size_t __rotates = 0;
-
 /**
  *       parent                       parent
  *        |                            |
@@ -28,22 +27,22 @@ static void rbtree_right_rotate(rb_node **root, rb_node *y) {
     rb_node *T2= x->right;
     rb_node *parent = y->parent;
 
-    x->right = y;
+    RB_WRITE_ONCE(x->right, y);
     y->parent = x;
 
-    y->left = T2;
+    RB_WRITE_ONCE(y->left, T2);
     if (T2) T2->parent = y;
 
     x->parent = parent;
     if (parent) {
         if (y == parent->right)
-            parent->right = x;
+            RB_WRITE_ONCE(parent->right, x);
         else
-            parent->left = x;
+            RB_WRITE_ONCE(parent->left, x);
     } else
-        *root = x;
+        RB_WRITE_ONCE(*root, x);
     
-    __rotates++;
+    TREE_STAT(TREE_STATS_RBT, rotations, 1);
     // printf("%s\n", __func__);
 }
 
@@ -52,30 +51,32 @@ static void rbtree_left_rotate(rb_node **root, rb_node *x) {
     rb_node *T2= y->left;
     rb_node *parent = x->parent;
 
-    y->left = x;
+    RB_WRITE_ONCE(y->left, x);
     x->parent = y;
 
-    x->right = T2;
+    RB_WRITE_ONCE(x->right, T2);
     if (T2) T2->parent = x;
 
     y->parent = parent;
     if (parent) {
         if (x == parent->left) 
-            parent->left = y;
+            RB_WRITE_ONCE(parent->left, y);
         else 
-            parent->right = y;
+            RB_WRITE_ONCE(parent->right, y);
     } else
-        *root = y;
+        RB_WRITE_ONCE(*root, y);
     
-    __rotates++;
+    TREE_STAT(TREE_STATS_RBT, rotations, 1);
     // printf("%s\n", __func__);
 }
 
 void rbt_insert(rb_node **root, rb_node *node) {
     rb_node *parent, *gparent;
     // node->color = RB_RED;
+    TREE_STAT(TREE_STATS_RBT, inserts, 1);
     while ((parent = node->parent) && rbt_is_red(parent)) {
         gparent = parent->parent;
+        TREE_STAT(TREE_STATS_RBT, insert_depth, 1);
 
         if (parent == gparent->left) {
             rb_node *uncle = gparent->right;
@@ -128,7 +129,9 @@ void rbt_insert(rb_node **root, rb_node *node) {
 
 static void rbt_erase_fixup(rb_node **root, rb_node *node, rb_node *parent) {
     rb_node *other;
+    TREE_STAT(TREE_STATS_RBT, erases, 1);
     while ((!node || rbt_is_black(node)) && node != *root) {
+        TREE_STAT(TREE_STATS_RBT, erase_depth, 1);
         if (parent->left == node) {
             other = parent->right;
             if (rbt_is_red(other)) {
@@ -152,6 +155,7 @@ static void rbt_erase_fixup(rb_node **root, rb_node *node, rb_node *parent) {
                     other = parent->right;
                 }
                 other->color = parent->color;
+                TREE_STAT(TREE_STATS_RBT, recolors, 1);
                 rbt_set_black(parent);
                 if (other->right)
                     rbt_set_black(other->right);
@@ -182,6 +186,7 @@ static void rbt_erase_fixup(rb_node **root, rb_node *node, rb_node *parent) {
                     other = parent->left;
                 }
                 other->color = parent->color;
+                TREE_STAT(TREE_STATS_RBT, recolors, 1);
                 rbt_set_black(parent);
                 if (other->left)
                     rbt_set_black(other->left);
@@ -217,25 +222,25 @@ void rbt_erase(rb_node **root, rb_node *node) {
 
         if (parent) {
             if (parent == old) {
-                parent->right = child;
+                RB_WRITE_ONCE(parent->right, child);
                 parent = node;
             } else
-                parent->left = child;
+                RB_WRITE_ONCE(parent->left, child);
         } else 
-            *root = child;
+            RB_WRITE_ONCE(*root, child);
 
         node->parent = old->parent;
         node->color = old->color;
-        node->right = old->right;
-        node->left = old->left;
+        RB_WRITE_ONCE(node->right, old->right);
+        RB_WRITE_ONCE(node->left, old->left);
 
         if (old->parent) {
             if (old->parent->left == old)
-                old->parent->left = node;
+                RB_WRITE_ONCE(old->parent->left, node);
             else
-                old->parent->right = node;
+                RB_WRITE_ONCE(old->parent->right, node);
         } else
-            *root = node;
+            RB_WRITE_ONCE(*root, node);
 
         old->left->parent = node;
         if (old->right)
@@ -250,12 +255,12 @@ void rbt_erase(rb_node **root, rb_node *node) {
         child->parent = parent;
     if (parent) {
         if (parent->left == node)
-            parent->left = child;
+            RB_WRITE_ONCE(parent->left, child);
         else
-            parent->right = child;
+            RB_WRITE_ONCE(parent->right, child);
     }
     else
-        *root = child;
+        RB_WRITE_ONCE(*root, child);
 
 FIXUP:
     if (color == RB_BLACK) 
@@ -309,5 +314,10 @@ rb_node *rbt_last(rb_node *root) {
     return root;
 }
 
-size_t rbt_rotate_times() { return __rotates; }
-void rbt_reset_rotate_times() { __rotates = 0; }
+size_t rbt_rotate_times() {
+    tree_stats stats;
+    tree_stats_get(TREE_STATS_RBT, &stats);
+    return stats.rotations;
+}
+
+void rbt_reset_rotate_times() { tree_stats_reset(TREE_STATS_RBT); }
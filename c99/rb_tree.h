@@ -14,6 +14,12 @@ struct rb_node {
 };
 
 
+/**
+ * 子指针和根指针的写入。rb_latch.c 的读者不加锁地沿 left/right 下降，写者这一侧也必须是原子操作，
+ * 否则按 C11 是数据竞争；relaxed 即可，顺序由 rb_latch 的 seq 保证（相当于内核 rbtree 的 WRITE_ONCE）。
+ */
+#define RB_WRITE_ONCE(p, v)     __atomic_store_n(&(p), (v), __ATOMIC_RELAXED)
+
 /* 获取自定义结构的地址 */
 #define RB_TREE_ENTRY(ptr, type, member)                           \
         ((type *)((char *)ptr - (size_t)&((type *)0)->member))
@@ -30,15 +36,17 @@ rb_node *rbt_prev(rb_node *node);
 rb_node *rbt_first(rb_node *root);
 rb_node *rbt_last(rb_node *root);
 
+/* 所有线程旋转次数之和，只在 -DTREE_STATS 时计数，详见 tree_stats.h */
 size_t rbt_rotate_times();
 void rbt_reset_rotate_times();
 
 /* 把 node 放在 parent 之后，放置位置在 pos */
 static inline void rb_link_node(rb_node *parent, rb_node *node, rb_node **pos) {
     node->parent = parent;
-    node->left = node->right = NULL;
+    RB_WRITE_ONCE(node->left, NULL);
+    RB_WRITE_ONCE(node->right, NULL);
     node->color = RB_RED;
-    *pos = node;
+    RB_WRITE_ONCE(*pos, node);
 }
 
 
@@ -11,11 +11,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "bst.h"
 #include "avl_tree.h"
 #include "rb_tree.h"
 #include "llrb_tree.h"
+#include "rb_latch.h"
+#include "tree_stats.h"
 
 #include "helper.h"
 
@@ -219,11 +222,226 @@ static inline void test_llrb() {
 }
 
 
+typedef struct latch_t latch_t;
+struct latch_t {
+    size_t key;
+    rb_latch_node node;
+};
+
+static int latch_less(const rb_latch_node *a, const rb_latch_node *b) {
+    return RB_TREE_ENTRY(a, latch_t, node)->key < RB_TREE_ENTRY(b, latch_t, node)->key;
+}
+
+static int latch_comp(const void *key, const rb_latch_node *node) {
+    size_t k = *(const size_t *)key, x = RB_TREE_ENTRY(node, latch_t, node)->key;
+    return k < x ? -1 : k > x;
+}
+
+/* 两棵树的中序应当完全相同 */
+static inline void check_latch(rb_latch_tree *tree, size_t n) {
+    size_t cnt = 0;
+    rb_node *a = rbt_first(tree->tree[0]), *b = rbt_first(tree->tree[1]);
+    while (a) {
+        assert(b && RB_TREE_ENTRY(a, latch_t, node.node[0]) == RB_TREE_ENTRY(b, latch_t, node.node[1]));
+        a = rbt_next(a);
+        b = rbt_next(b);
+        cnt++;
+    }
+    assert(NULL == b && cnt == n);
+}
+
+#define LATCH_READERS  3
+#define LATCH_ROUNDS   20
+
+typedef struct {
+    rb_latch_tree  *tree;
+    latch_t        *datas;
+    size_t          counts;
+    int             stop;
+} latch_shared;
+
+/* 奇数下标的元素一直在树中，必须找到；偶数下标的正被写者反复删除、插入，找到时必须是它本身 */
+static void *latch_reader(void *arg) {
+    latch_shared *s = (latch_shared *)arg;
+    size_t i = 1, lookups = 0;
+    while (!__atomic_load_n(&s->stop, __ATOMIC_RELAXED)) {
+        rb_latch_node *node = rbt_latch_find(s->tree, &s->datas[i].key, latch_comp);
+        assert(i % 2 ? &s->datas[i].node == node : NULL == node || &s->datas[i].node == node);
+        (void)node;
+        i = (i + 7919) % s->counts;
+        lookups++;
+    }
+    assert(lookups);
+    return NULL;
+}
+
+/* 一个写者（当前线程）与 LATCH_READERS 个读者同时运行，读者要经过重试路径 */
+static void test_latch_concurrent(rb_latch_tree *tree, latch_t *datas, size_t counts) {
+    size_t i, r;
+    pthread_t tids[LATCH_READERS];
+    latch_shared shared = {tree, datas, counts, 0};
+
+    rbt_latch_reset_retries();
+    for (i = 0; i < LATCH_READERS; i++)
+        pthread_create(&tids[i], NULL, latch_reader, &shared);
+    for (r = 0; r < LATCH_ROUNDS; r++) {
+        for (i = 0; i < counts; i += 2)
+            rbt_latch_insert(tree, &datas[i].node, latch_less);
+        for (i = 0; i < counts; i += 2)
+            rbt_latch_erase(tree, &datas[i].node);
+    }
+    __atomic_store_n(&shared.stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < LATCH_READERS; i++)
+        pthread_join(tids[i], NULL);
+    check_latch(tree, counts / 2);
+    printf("latch readers retried %zu times\n", rbt_latch_retries());
+}
+
+static inline void test_latch() {
+    size_t i, counts = 10000;
+    rb_latch_tree tree = RB_LATCH_TREE_INIT;
+    latch_t *datas = (latch_t *)calloc(counts, sizeof(latch_t));
+    size_t *nums = get_rand_array1(counts);
+    assert(nums && datas);
+
+    for (i = 0; i < counts; i++) {
+        datas[i].key = nums[i];
+        rbt_latch_insert(&tree, &datas[i].node, latch_less);
+    }
+    check_latch(&tree, counts);
+    assert(2 * counts == tree.seq);
+
+    for (i = 0; i < counts; i += 2)
+        rbt_latch_erase(&tree, &datas[i].node);
+    check_latch(&tree, counts / 2);
+
+    for (i = 0; i < counts; i++) {
+        rb_latch_node *node = rbt_latch_find(&tree, &nums[i], latch_comp);
+        assert(i % 2 ? &datas[i].node == node : NULL == node);
+    }
+    test_latch_concurrent(&tree, datas, counts);
+
+    drop_random_array(nums);
+    free(datas);
+    printf("========= latch trees test OK ========\n");
+}
+
+/* 递归求黑高和各节点深度加一之和，与 shape_rbt() 的迭代结果对照 */
+static long rbt_black_height(rb_node *node, size_t d, size_t *path) {
+    long l, r;
+    if (NULL == node) return 0;
+    *path += d + 1;
+    l = rbt_black_height(node->left, d + 1, path);
+    r = rbt_black_height(node->right, d + 1, path);
+    return l == r && l >= 0 ? l + (RB_BLACK == node->color) : -1;
+}
+
+static inline void test_shape() {
+    size_t i, path = 0, sum = 0, counts = 100000, chain = 20000;
+    rb_node *root = NULL;
+    bst_node *list = NULL;
+    tree_shape shape, left;
+    rbt_t *datas = (rbt_t *)calloc(counts, sizeof(rbt_t));
+    bst_t *items = (bst_t *)calloc(chain, sizeof(bst_t));
+    size_t *nums = get_rand_array1(counts);
+    assert(nums && datas && items);
+
+    for (i = 0; i < counts; i++) {
+        datas[i].key = nums[i];
+        insert_rbt(&root, &datas[i]);
+    }
+    shape_rbt(root, &shape);
+    assert(shape.nodes == counts && shape.red > 0);
+    assert(shape.black_height == rbt_black_height(root, 0, &path) && shape.path == path);
+    for (i = 0; i < shape.height; i++)
+        sum += shape.depth[i];
+    assert(sum == counts && shape.depth[0] == 1);
+    shape_rbt(root->left, &left);      /* 子树 */
+    assert(left.height < shape.height && left.black_height == shape.black_height - 1);
+    shape_print("rbt", &shape);
+    shape_drop(&left);
+    shape_drop(&shape);
+
+    /* 顺序插入让 bst 退化成链表，迭代遍历不受深度限制 */
+    for (i = 0; i < chain; i++) {
+        items[i].key = i;
+        insert_bst(&list, &items[i]);
+    }
+    shape_bst(list, &shape);
+    assert(shape.height == chain && shape.path == chain * (chain + 1) / 2 && 0 == shape.black_height);
+    shape_drop(&shape);
+
+    drop_random_array(nums);
+    free(datas);
+    free(items);
+    printf("========= tree shape test OK ========\n");
+}
+
+#ifdef TREE_STATS
+#define STATS_COUNTS   10000ul
+#define STATS_THREADS  4
+
+/* 固定的乱序插入，再按插入顺序全部删除，每次执行的修复过程完全相同 */
+static void *stats_worker(void *arg) {
+    size_t i;
+    rb_node *root = NULL;
+    rbt_t *datas = (rbt_t *)calloc(STATS_COUNTS, sizeof(rbt_t));
+    assert(datas);
+    (void)arg;
+    for (i = 0; i < STATS_COUNTS; i++) {
+        datas[i].key = i * 7919 % STATS_COUNTS;
+        insert_rbt(&root, &datas[i]);
+    }
+    for (i = 0; i < STATS_COUNTS; i++)
+        rbt_erase(&root, &datas[i].node);
+    assert(NULL == root);
+    free(datas);
+    return NULL;
+}
+
+/* 多个线程各自的计数汇总后应当正好是单线程的 STATS_THREADS 倍 */
+static inline void test_stats() {
+    int i;
+    tree_stats one, all;
+    pthread_t tids[STATS_THREADS];
+
+    tree_stats_reset(TREE_STATS_RBT);
+    stats_worker(NULL);
+    tree_stats_get(TREE_STATS_RBT, &one);
+    assert(one.inserts == STATS_COUNTS && one.erases <= STATS_COUNTS);
+    assert(one.rotations == rbt_rotate_times() && one.rotations > 0);
+    assert(one.recolors > 0 && one.insert_depth > 0 && one.erase_depth > 0);
+
+    tree_stats_reset(TREE_STATS_RBT);
+    for (i = 0; i < STATS_THREADS; i++)
+        pthread_create(&tids[i], NULL, stats_worker, NULL);
+    for (i = 0; i < STATS_THREADS; i++)
+        pthread_join(tids[i], NULL);
+    tree_stats_get(TREE_STATS_RBT, &all);
+    assert(all.rotations == STATS_THREADS * one.rotations);
+    assert(all.recolors == STATS_THREADS * one.recolors);
+    assert(all.inserts == STATS_THREADS * one.inserts);
+    assert(all.insert_depth == STATS_THREADS * one.insert_depth);
+    assert(all.erases == STATS_THREADS * one.erases);
+    assert(all.erase_depth == STATS_THREADS * one.erase_depth);
+
+    printf("rotations %zu, recolors %zu, insert depth %.2f, erase depth %.2f\n",
+           one.rotations, one.recolors, (double)one.insert_depth / one.inserts,
+           (double)one.erase_depth / one.erases);
+    printf("========= tree stats test OK ========\n");
+}
+#endif
+
 int main() {
     // test_bst();
     // test_avl();
     // test_rbt();
     test_llrb();
+    test_latch();
+    test_shape();
+#ifdef TREE_STATS
+    test_stats();
+#endif
     return 0;
 
 }
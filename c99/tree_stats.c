@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree_stats.h"
+
+#define CACHE_LINE  64
+
+/* 前后各留一个 cache line，相邻两个线程的计数不会落在同一行 */
+typedef struct stats_block stats_block;
+struct stats_block {
+    stats_block *next;
+    char         head[CACHE_LINE];
+    tree_stats   stats[TREE_STATS_KINDS];
+    char         tail[CACHE_LINE];
+};
+
+static stats_block *__blocks = NULL;
+
+#ifdef TREE_STATS
+static __thread stats_block *__local = NULL;
+
+tree_stats *__tree_stats_local(int kind) {
+    stats_block *block = __local;
+    if (NULL == block) {
+        block = (stats_block *)calloc(1, sizeof(stats_block));
+        if (NULL == block) abort();
+        block->next = __atomic_load_n(&__blocks, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&__blocks, &block->next, block, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+        __local = block;
+    }
+    return &block->stats[kind];
+}
+#endif
+
+void tree_stats_get(int kind, tree_stats *stats) {
+    stats_block *block;
+    memset(stats, 0, sizeof(tree_stats));
+    for (block = __atomic_load_n(&__blocks, __ATOMIC_ACQUIRE); block; block = block->next) {
+        tree_stats *s = &block->stats[kind];
+        stats->rotations    += __atomic_load_n(&s->rotations, __ATOMIC_RELAXED);
+        stats->recolors     += __atomic_load_n(&s->recolors, __ATOMIC_RELAXED);
+        stats->inserts      += __atomic_load_n(&s->inserts, __ATOMIC_RELAXED);
+        stats->insert_depth += __atomic_load_n(&s->insert_depth, __ATOMIC_RELAXED);
+        stats->erases       += __atomic_load_n(&s->erases, __ATOMIC_RELAXED);
+        stats->erase_depth  += __atomic_load_n(&s->erase_depth, __ATOMIC_RELAXED);
+    }
+}
+
+void tree_stats_reset(int kind) {
+    stats_block *block;
+    for (block = __atomic_load_n(&__blocks, __ATOMIC_ACQUIRE); block; block = block->next) {
+        tree_stats *s = &block->stats[kind];
+        __atomic_store_n(&s->rotations, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&s->recolors, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&s->inserts, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&s->insert_depth, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&s->erases, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&s->erase_depth, 0, __ATOMIC_RELAXED);
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file tree_stats.h
+ * @author luyiran @ 872289455@qq.com
+ * @brief optional per-thread operation counters of the balanced trees
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#ifndef __TREE_STATS_H__
+#define __TREE_STATS_H__
+#include <stddef.h>
+
+/* 计数按树的种类分开 */
+#define TREE_STATS_AVL      0
+#define TREE_STATS_RBT      1
+#define TREE_STATS_LLRB     2
+#define TREE_STATS_KINDS    3
+
+typedef struct tree_stats tree_stats;
+
+struct tree_stats {
+    size_t rotations;
+    size_t recolors;        /* 修复过程中写颜色的次数 */
+    size_t inserts;         /* 插入修复的次数 */
+    size_t insert_depth;    /* 插入修复向上走过的总层数，除以 inserts 得平均深度 */
+    size_t erases;
+    size_t erase_depth;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 每个线程第一次计数时分配自己的计数块，挂到全局链表上，线程退出后也不释放，
+ * 计数只写本线程的块，没有竞争，也不会与别的线程伪共享；
+ * tree_stats_get() 遍历链表把所有线程的计数加起来。
+ * 不定义 TREE_STATS 时树的代码里没有任何计数，这两个函数得到的都是 0。
+ */
+void tree_stats_get(int kind, tree_stats *stats);
+/* 与计数并发调用时，正在进行的那几次计数可能丢失 */
+void tree_stats_reset(int kind);
+
+#ifdef TREE_STATS
+tree_stats *__tree_stats_local(int kind);
+
+static inline void __tree_stats_add(size_t *counter, size_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+#define TREE_STAT(kind, field, n)   __tree_stats_add(&__tree_stats_local(kind)->field, (n))
+#else
+#define TREE_STAT(kind, field, n)   ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !__TREE_STATS_H__ */
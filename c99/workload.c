@@ -0,0 +1,186 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "workload.h"
+
+const char *const KEY_DIST_NAMES[KEY_DISTS] = {
+    "uniform", "zipf", "ascending", "descending", "nearly", "clustered"
+};
+
+uint64_t splitmix64(uint64_t *state) {
+    return mix64(*state += 0x9e3779b97f4a7c15ull);
+}
+
+uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+void rng_seed(rng_t *rng, uint64_t seed) {
+    int i;
+    for (i = 0; i < 4; i++)
+        rng->s[i] = splitmix64(&seed);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+uint64_t rng_next(rng_t *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+uint64_t rng_below(rng_t *rng, uint64_t n) {
+    return (uint64_t)(((uint128_t)rng_next(rng) * n) >> 64);
+}
+
+double rng_uniform(rng_t *rng) {
+    return (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+void zipf_init(zipf_gen *z, size_t n, double theta) {
+    size_t i;
+    z->n = n;
+    z->theta = theta;
+    z->zetan = 0;
+    for (i = 1; i <= n; i++)
+        z->zetan += 1 / pow((double)i, theta);
+    z->half = 1 + pow(0.5, theta);
+    z->alpha = 1 / (1 - theta);
+    z->eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - z->half / z->zetan);
+}
+
+size_t zipf_next(const zipf_gen *z, rng_t *rng) {
+    double u = rng_uniform(rng), uz = u * z->zetan;
+    size_t r;
+    if (uz < 1) return 0;
+    if (uz < z->half) return 1;
+    r = (size_t)(z->n * pow(z->eta * u - z->eta + 1, z->alpha));
+    return r < z->n ? r : z->n - 1;
+}
+
+uint64_t *make_keys(int dist, size_t n, uint64_t seed) {
+    size_t i;
+    rng_t rng;
+    zipf_gen z;
+    uint64_t base = 0, tmp, *keys = (uint64_t *)malloc(n * sizeof(uint64_t) + 1);
+    assert(keys);
+    rng_seed(&rng, seed);
+
+    switch (dist) {
+    case KEY_UNIFORM:
+        for (i = 0; i < n; i++) keys[i] = rng_next(&rng);
+        break;
+    case KEY_ZIPF:
+        zipf_init(&z, n, ZIPF_THETA);
+        for (i = 0; i < n; i++) keys[i] = mix64(zipf_next(&z, &rng));
+        break;
+    case KEY_ASCENDING:
+        for (i = 0; i < n; i++) keys[i] = i;
+        break;
+    case KEY_DESCENDING:
+        for (i = 0; i < n; i++) keys[i] = n - 1 - i;
+        break;
+    case KEY_NEARLY_SORTED:
+        for (i = 0; i < n; i++) keys[i] = i;
+        for (i = 0; n > 1 && i < n / 100; i++) {
+            size_t x = rng_below(&rng, n), y = x + 1 + rng_below(&rng, 8);
+            if (y >= n) y = n - 1;
+            tmp = keys[x];
+            keys[x] = keys[y];
+            keys[y] = tmp;
+        }
+        break;
+    case KEY_CLUSTERED:
+        for (i = 0; i < n; i++) {
+            if (0 == i % CLUSTER_SIZE) base = rng_next(&rng) & ~(uint64_t)(CLUSTER_SIZE - 1);
+            keys[i] = base + i % CLUSTER_SIZE;
+        }
+        break;
+    default:
+        free(keys);
+        return NULL;
+    }
+    return keys;
+}
+
+char **make_string_keys(size_t n, uint64_t seed) {
+    size_t i;
+    rng_t rng;
+    char **keys = (char **)malloc(n * sizeof(char *) + 1);
+    assert(keys);
+    rng_seed(&rng, seed);
+    for (i = 0; i < n; i++) {
+        keys[i] = (char *)malloc(21);
+        assert(keys[i]);
+        snprintf(keys[i], 21, "user%016llx", (unsigned long long)rng_next(&rng));
+    }
+    return keys;
+}
+
+void drop_string_keys(char **keys, size_t n) {
+    size_t i;
+    if (NULL == keys) return;
+    for (i = 0; i < n; i++) free(keys[i]);
+    free(keys);
+}
+
+int ycsb_init(ycsb_gen *g, char workload, size_t records, uint64_t seed) {
+    static const int mixes[6][5] = {
+        /* read update insert scan rmw */
+        {50, 50, 0, 0, 0},
+        {95, 5, 0, 0, 0},
+        {100, 0, 0, 0, 0},
+        {95, 0, 5, 0, 0},
+        {0, 0, 5, 95, 0},
+        {50, 0, 0, 0, 50},
+    };
+    if (workload < 'A' || workload > 'F' || 0 == records) return -1;
+    memset(g, 0, sizeof(ycsb_gen));
+    g->workload = workload;
+    memcpy(g->percent, mixes[workload - 'A'], sizeof(g->percent));
+    g->latest = 'D' == workload;
+    g->count = records;
+    zipf_init(&g->zipf, records, ZIPF_THETA);
+    rng_seed(&g->rng, seed);
+    return 0;
+}
+
+uint64_t ycsb_key(size_t i) {
+    return mix64(i);
+}
+
+void ycsb_next(ycsb_gen *g, ycsb_op *op) {
+    int type = 0, dice = (int)rng_below(&g->rng, 100);
+    size_t rank;
+    while (dice >= g->percent[type]) dice -= g->percent[type++];
+
+    op->type = type;
+    op->scan = 0;
+    if (YCSB_INSERT == type) {
+        op->key = ycsb_key(g->count++);
+        return;
+    }
+    /* latest：名次 0 是最新插入的记录 */
+    rank = zipf_next(&g->zipf, &g->rng);
+    if (g->latest)
+        op->key = ycsb_key(g->count - 1 - (rank < g->count ? rank : g->count - 1));
+    else
+        op->key = ycsb_key(rank);
+    if (YCSB_SCAN == type)
+        op->scan = 1 + rng_below(&g->rng, YCSB_MAX_SCAN);
+}
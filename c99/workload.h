@@ -0,0 +1,113 @@
+/**
+ * @file workload.h
+ * @author luyiran @ 872289455@qq.com
+ * @brief seeded key distributions and YCSB-style operation mixes for the benchmark
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#ifndef __WORKLOAD_H__
+#define __WORKLOAD_H__
+#include <stdint.h>
+#include <stddef.h>
+
+/* 键的分布 */
+#define KEY_UNIFORM         0       /* 64 位均匀随机 */
+#define KEY_ZIPF            1       /* Zipfian 名次经 mix64() 打散，热点散落在键空间里，有重复 */
+#define KEY_ASCENDING       2
+#define KEY_DESCENDING      3
+#define KEY_NEARLY_SORTED   4       /* 递增序列中 1% 的位置与 8 步以内的邻居交换 */
+#define KEY_CLUSTERED       5       /* 每 64 个连续的键一簇，簇的起点随机 */
+#define KEY_DISTS           6
+
+#define ZIPF_THETA          0.99
+#define CLUSTER_SIZE        64
+#define YCSB_MAX_SCAN       100
+
+/* YCSB 的操作 */
+#define YCSB_READ           0
+#define YCSB_UPDATE         1
+#define YCSB_INSERT         2
+#define YCSB_SCAN           3
+#define YCSB_RMW            4       /* read-modify-write */
+
+typedef struct rng_t rng_t;
+typedef struct zipf_gen zipf_gen;
+typedef struct ycsb_gen ycsb_gen;
+typedef struct ycsb_op ycsb_op;
+
+/* xoshiro256**，状态由 splitmix64 从一个 64 位种子展开 */
+struct rng_t {
+    uint64_t s[4];
+};
+
+/* YCSB 的 Zipfian 分布（Gray et al., SIGMOD 1994），名次 [0, n)，0 最热 */
+struct zipf_gen {
+    size_t n;
+    double theta, zetan, alpha, eta, half;
+};
+
+struct ycsb_op {
+    int      type;
+    uint64_t key;
+    size_t   scan;      /* YCSB_SCAN 的长度 */
+};
+
+/**
+ * workload 'A' ~ 'F'（Cooper et al., SoCC 2010）：
+ *   A 50% read  50% update        zipfian
+ *   B 95% read   5% update        zipfian
+ *   C 100% read                   zipfian
+ *   D 95% read   5% insert        latest，越新插入的越热
+ *   E 95% scan   5% insert        zipfian，长度在 [1, YCSB_MAX_SCAN] 上均匀
+ *   F 50% read  50% rmw           zipfian
+ * 预先装载的第 i 条记录的键是 ycsb_key(i)，insert 依次追加 ycsb_key(records), ycsb_key(records + 1) ...
+ */
+struct ycsb_gen {
+    char     workload;
+    int      percent[5];    /* 按 YCSB_READ ... YCSB_RMW 的比例 */
+    int      latest;
+    size_t   count;         /* 已有的记录数 */
+    zipf_gen zipf;
+    rng_t    rng;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const char *const KEY_DIST_NAMES[KEY_DISTS];
+
+uint64_t splitmix64(uint64_t *state);
+/* splitmix64 的末端混合，64 位整数上的双射，用来把名次或序号打散成键 */
+uint64_t mix64(uint64_t x);
+
+void     rng_seed(rng_t *rng, uint64_t seed);
+uint64_t rng_next(rng_t *rng);
+/* [0, n) 上均匀（Lemire 乘法取高位，偏差可忽略） */
+uint64_t rng_below(rng_t *rng, uint64_t n);
+/* [0, 1) 上均匀 */
+double   rng_uniform(rng_t *rng);
+
+/* O(n) 预计算 zeta(n) */
+void     zipf_init(zipf_gen *z, size_t n, double theta);
+size_t   zipf_next(const zipf_gen *z, rng_t *rng);
+
+/* n 个键，按分布 dist 生成，用 free() 释放 */
+uint64_t *make_keys(int dist, size_t n, uint64_t seed);
+/* n 个形如 "user" + 16 位十六进制的随机串，用 drop_string_keys() 释放 */
+char    **make_string_keys(size_t n, uint64_t seed);
+void      drop_string_keys(char **keys, size_t n);
+
+/* 未知的 workload 返回 -1 */
+int      ycsb_init(ycsb_gen *g, char workload, size_t records, uint64_t seed);
+uint64_t ycsb_key(size_t i);
+void     ycsb_next(ycsb_gen *g, ycsb_op *op);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !__WORKLOAD_H__ */
@@ -0,0 +1,624 @@
+/**
+ * @file concurrent_avl.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief concurrent relaxed-balance AVL map with optimistic hand-over-hand validation
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * N. G. Bronson, J. Casper, H. Chafi, K. Olukotun. A Practical Concurrent Binary Search Tree. PPoPP 2010.
+ */
+#ifndef __CONCURRENT_AVL_HPP__
+#define __CONCURRENT_AVL_HPP__
+#include "bst.hpp"
+#include "epoch.hpp"
+
+#include <thread>
+
+#ifndef MAX
+#define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
+#endif
+
+const char *CONCURRENT_AVL = "cavl";
+
+/**
+ * 读写都不加全局锁：
+ *   - 每个节点有一个 version：UNLINKED 位表示已摘下，SHRINKING 位表示正在被旋转到下面
+ *     （子树里的键可能正在移走），每次旋转结束计数加一；
+ *   - 下降时先读孩子再校验父节点的 version 没变（hand-over-hand），变了就回到上一层重试，
+ *     孩子正在 SHRINKING 时等它转完；查找全程不写共享内存；
+ *   - 插入只锁新节点的父节点，删除有两个孩子的节点时只把它标成路由节点（present = false），
+ *     不超过一个孩子时锁住父节点和它再摘下；
+ *   - 平衡是放宽的：修改之后沿 parent 向上，每一步只锁父节点、节点和要旋转的孩子，
+ *     修高度、旋转、顺便摘掉不再需要的路由节点，其它线程可能暂时看到不平衡的树，
+ *     修改全部结束后树又是严格的 AVL；
+ *   - 摘下的节点交给 epoch_domain，没有读者还停在上面时才释放。
+ * 值与 present 一起由节点上的 vseq 保护（seqlock），读者拿到的是拷贝，值必须是平凡可拷贝的。
+ * insert/remove/find 都是可线性化的。
+ */
+#define CAVL_UNLINKED   (1ull)
+#define CAVL_SHRINKING  (2ull)
+#define CAVL_SPINS      64
+
+template <typename keyType, typename valueType>
+struct __cnode {
+    typedef __cnode *link_type;
+
+    __cnode(const keyType &k, const valueType &v, link_type p, bool live)
+        : version(0), height(1), parent(p), left(nullptr), right(nullptr),
+          lck(false), vseq(0), present(live), key(k), value(v) {}
+
+    std::atomic<uint64_t>   version;
+    std::atomic<int>        height;
+    std::atomic<link_type>  parent;
+    std::atomic<link_type>  left;
+    std::atomic<link_type>  right;
+    std::atomic<bool>       lck;
+    std::atomic<unsigned>   vseq;
+    std::atomic<bool>       present;    /* false 表示路由节点 */
+    const keyType           key;
+    valueType               value;
+
+    std::atomic<link_type> &child(int dir) { return dir < 0 ? left : right; }
+
+    void lock() {
+        for (int i = 0; lck.exchange(true, std::memory_order_acquire); i++) {
+            while (lck.load(std::memory_order_relaxed))
+                if (++i > CAVL_SPINS) std::this_thread::yield();
+        }
+    }
+    void unlock() { lck.store(false, std::memory_order_release); }
+
+    /* 持有锁时修改值和 present */
+    void set(bool live, const valueType *v) {
+        vseq.store(vseq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        if (v) value = *v;
+        present.store(live, std::memory_order_relaxed);
+        vseq.store(vseq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /* 不加锁地读一致的 present 和值 */
+    bool get(valueType *v) {
+        for (;;) {
+            unsigned s = vseq.load(std::memory_order_acquire);
+            if (s & 1) continue;
+            bool live = present.load(std::memory_order_relaxed);
+            valueType tmp = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s == vseq.load(std::memory_order_relaxed)) {
+                if (live && v) *v = tmp;
+                return live;
+            }
+        }
+    }
+};
+
+template <typename keyType, typename valueType>
+class concurrent_avl_map {
+public:
+    typedef keyType                             key_type;
+    typedef valueType                           value_type;
+    typedef __cnode<keyType, valueType>         NODE;
+    typedef NODE                                *link_type;
+
+    static_assert(std::is_trivially_copyable<valueType>::value,
+                  "lock-free readers copy values");
+
+    concurrent_avl_map() : count(0), holder(keyType(), valueType(), nullptr, false),
+                           domain(reclaim, this) {}
+
+    ~concurrent_avl_map() {
+        destroy(holder.right.load());
+        domain.drain();
+    }
+
+    concurrent_avl_map(const concurrent_avl_map &) = delete;
+    concurrent_avl_map &operator=(const concurrent_avl_map &) = delete;
+
+    bool find(const keyType &key, valueType *value = nullptr) {
+        epoch_guard guard(domain);
+        for (;;) {
+            int r = attempt_get(key, &holder, 1, holder.version.load(), value);
+            if (RETRY != r) return r;
+        }
+    }
+
+    /* 新增返回 true，覆盖已有的值返回 false */
+    bool insert(const keyType &key, const valueType &value) {
+        epoch_guard guard(domain);
+        for (;;) {
+            int r = attempt_put(key, value, &holder, 1, holder.version.load());
+            if (RETRY != r) {
+                if (r) count.fetch_add(1, std::memory_order_relaxed);
+                return r;
+            }
+        }
+    }
+
+    /* 删除成功返回 true */
+    bool remove(const keyType &key) {
+        epoch_guard guard(domain);
+        for (;;) {
+            int r = attempt_remove(key, &holder, 1, holder.version.load());
+            if (RETRY != r) {
+                if (r) count.fetch_sub(1, std::memory_order_relaxed);
+                return r;
+            }
+        }
+    }
+
+    /* 并发修改时只是近似值 */
+    size_t size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        return 0 == size();
+    }
+
+    /* 没有并发修改时按中序访问，测试用 */
+    template <typename Fn>
+    void for_each(Fn fn) {
+        walk(holder.right.load(), fn);
+    }
+
+    /* 遍历整棵树，路由节点（present 为 false）和等待回收的节点是 slack；并发修改时是近似值 */
+    map_memory memory_usage() const {
+        epoch_guard guard(const_cast<epoch_domain &>(domain));
+        size_t live = 0, total = count_nodes(holder.right.load(), live);
+        total += const_cast<epoch_domain &>(domain).pending();
+        map_memory m;
+        m.nodes = live * sizeof(NODE);
+        m.slack = (total - live) * sizeof(NODE);
+        m.overhead = total * malloc_overhead(sizeof(NODE));
+        m.metadata = sizeof(*this);
+        return m;
+    }
+
+    const char *name() const {
+        return CONCURRENT_AVL;
+    }
+
+private:
+    enum { RETRY = -1 };
+    enum { NOTHING = -1, UNLINK = -2, REBALANCE = -3 };
+
+    std::atomic<size_t> count;
+    NODE                holder;     /* 哨兵，右孩子是真正的根，永远不会被旋转或摘下 */
+    epoch_domain        domain;
+
+    /* 锁住一个节点直到作用域结束 */
+    struct guard {
+        link_type node;
+        explicit guard(link_type n) : node(n) { node->lock(); }
+        ~guard() { node->unlock(); }
+    };
+
+    static void reclaim(void *, void *ptr) {
+        delete static_cast<link_type>(ptr);
+    }
+
+    static void destroy(link_type node) {
+        if (nullptr == node) return;
+        destroy(node->left.load());
+        destroy(node->right.load());
+        delete node;
+    }
+
+    /* 子树的节点数（含路由节点），其中 present 的个数累加到 live */
+    static size_t count_nodes(link_type node, size_t &live) {
+        if (nullptr == node) return 0;
+        live += node->present.load(std::memory_order_relaxed);
+        return 1 + count_nodes(node->left.load(), live) + count_nodes(node->right.load(), live);
+    }
+
+    template <typename Fn>
+    static void walk(link_type node, Fn &fn) {
+        if (nullptr == node) return;
+        walk(node->left.load(), fn);
+        valueType value;
+        if (node->get(&value)) fn(node->key, value);
+        walk(node->right.load(), fn);
+    }
+
+    static int compare(const keyType &a, const keyType &b) {
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+
+    static int height(link_type node) {
+        return node ? node->height.load() : 0;
+    }
+
+    static bool shrinking_or_unlinked(uint64_t v) {
+        return v & (CAVL_SHRINKING | CAVL_UNLINKED);
+    }
+
+    static bool can_unlink(link_type node) {
+        return nullptr == node->left.load() || nullptr == node->right.load();
+    }
+
+    /* 旋转开始和结束时改写 version，结束后计数加一、SHRINKING 位清零 */
+    static uint64_t begin_change(uint64_t v) { return v | CAVL_SHRINKING; }
+    static uint64_t end_change(uint64_t v) { return (v | CAVL_SHRINKING) + CAVL_SHRINKING; }
+
+    static void wait_until_shrink_completed(link_type node, uint64_t v) {
+        if (!(v & CAVL_SHRINKING)) return;
+        for (int i = 0; node->version.load() == v; i++)
+            if (i > CAVL_SPINS) std::this_thread::yield();
+    }
+
+    /* 返回 1 找到、0 没有、RETRY 需要从上一层重试 */
+    int attempt_get(const keyType &key, link_type node, int dir, uint64_t nodeV, valueType *value) {
+        for (;;) {
+            link_type child = node->child(dir).load();
+            if (nullptr == child)
+                return node->version.load() != nodeV ? RETRY : 0;
+
+            int c = compare(key, child->key);
+            if (0 == c) return child->get(value);
+
+            uint64_t childV = child->version.load();
+            if (shrinking_or_unlinked(childV)) {
+                wait_until_shrink_completed(child, childV);
+                if (node->version.load() != nodeV) return RETRY;
+            } else if (child != node->child(dir).load()) {
+                if (node->version.load() != nodeV) return RETRY;
+            } else {
+                if (node->version.load() != nodeV) return RETRY;
+                int r = attempt_get(key, child, c, childV, value);
+                if (RETRY != r) return r;
+                if (node->version.load() != nodeV) return RETRY;
+            }
+        }
+    }
+
+    int attempt_put(const keyType &key, const valueType &value, link_type node, int dir, uint64_t nodeV) {
+        for (;;) {
+            link_type child = node->child(dir).load();
+            if (node->version.load() != nodeV) return RETRY;
+
+            int r = RETRY;
+            if (nullptr == child) {
+                r = attempt_insert(key, value, node, dir, nodeV);
+            } else {
+                int c = compare(key, child->key);
+                if (0 == c) {
+                    r = attempt_update(child, value);
+                } else {
+                    uint64_t childV = child->version.load();
+                    if (shrinking_or_unlinked(childV)) {
+                        wait_until_shrink_completed(child, childV);
+                    } else if (child == node->child(dir).load()) {
+                        if (node->version.load() != nodeV) return RETRY;
+                        r = attempt_put(key, value, child, c, childV);
+                    }
+                }
+            }
+            if (RETRY != r) return r;
+        }
+    }
+
+    int attempt_insert(const keyType &key, const valueType &value, link_type node, int dir, uint64_t nodeV) {
+        {
+            guard g(node);
+            if (node->version.load() != nodeV || node->child(dir).load()) return RETRY;
+            node->child(dir).store(new NODE(key, value, node, true));
+        }
+        fix_height_and_rebalance(node);
+        return 1;
+    }
+
+    int attempt_update(link_type node, const valueType &value) {
+        guard g(node);
+        if (node->version.load() & CAVL_UNLINKED) return RETRY;
+        bool was = node->present.load();
+        node->set(true, &value);
+        return was ? 0 : 1;
+    }
+
+    int attempt_remove(const keyType &key, link_type node, int dir, uint64_t nodeV) {
+        for (;;) {
+            link_type child = node->child(dir).load();
+            if (node->version.load() != nodeV) return RETRY;
+            if (nullptr == child) return 0;
+
+            int r = RETRY;
+            int c = compare(key, child->key);
+            if (0 == c) {
+                r = attempt_remove_node(node, child);
+            } else {
+                uint64_t childV = child->version.load();
+                if (shrinking_or_unlinked(childV)) {
+                    wait_until_shrink_completed(child, childV);
+                } else if (child == node->child(dir).load()) {
+                    if (node->version.load() != nodeV) return RETRY;
+                    r = attempt_remove(key, child, c, childV);
+                }
+            }
+            if (RETRY != r) return r;
+        }
+    }
+
+    int attempt_remove_node(link_type parent, link_type node) {
+        if (!node->present.load()) return 0;
+        if (!can_unlink(node)) {
+            /* 两个孩子：只标成路由节点，留给以后的平衡去摘 */
+            guard g(node);
+            if ((node->version.load() & CAVL_UNLINKED) || can_unlink(node)) return RETRY;
+            bool was = node->present.load();
+            node->set(false, nullptr);
+            return was;
+        }
+        bool was;
+        {
+            guard gp(parent);
+            if ((parent->version.load() & CAVL_UNLINKED) || node->parent.load() != parent)
+                return RETRY;
+            guard gn(node);
+            if (node->version.load() & CAVL_UNLINKED) return RETRY;
+            was = node->present.load();
+            node->set(false, nullptr);
+            if (can_unlink(node)) attempt_unlink_nl(parent, node);
+        }
+        fix_height_and_rebalance(parent);
+        return was;
+    }
+
+    /* 持有 parent 和 node 的锁，node 至多一个孩子时把它摘下 */
+    bool attempt_unlink_nl(link_type parent, link_type node) {
+        link_type pl = parent->left.load(), pr = parent->right.load();
+        if (pl != node && pr != node) return false;
+        link_type l = node->left.load(), r = node->right.load();
+        if (l && r) return false;
+        link_type splice = l ? l : r;
+        (pl == node ? parent->left : parent->right).store(splice);
+        if (splice) splice->parent.store(parent);
+        node->version.store(CAVL_UNLINKED);
+        domain.retire(node);
+        return true;
+    }
+
+    /* 需要做什么：NOTHING、UNLINK、REBALANCE，或者返回应有的高度 */
+    static int node_condition(link_type node) {
+        link_type l = node->left.load(), r = node->right.load();
+        if ((nullptr == l || nullptr == r) && !node->present.load()) return UNLINK;
+        int h = node->height.load(), hl = height(l), hr = height(r);
+        int repl = 1 + MAX(hl, hr), bal = hl - hr;
+        if (bal < -1 || bal > 1) return REBALANCE;
+        return h != repl ? repl : NOTHING;
+    }
+
+    /**
+     * 自 node 向上修高度、旋转。旋转后如果还要先处理新子树里的节点，
+     * 新子树的高度可能已经变了，上面的 parent 记进 resume，下面处理完再回来。
+     */
+    void fix_height_and_rebalance(link_type node) {
+        std::vector<link_type> resume;
+        for (;;) {
+            while (node && node->parent.load()) {
+                int c = node_condition(node);
+                if (NOTHING == c || (node->version.load() & CAVL_UNLINKED)) break;
+                if (UNLINK != c && REBALANCE != c) {
+                    guard g(node);
+                    node = fix_height_nl(node);
+                } else {
+                    link_type parent = node->parent.load();
+                    guard gp(parent);
+                    if (!(parent->version.load() & CAVL_UNLINKED) && node->parent.load() == parent) {
+                        link_type up = parent->parent.load();
+                        guard gn(node);
+                        node = rebalance_nl(parent, node);
+                        if (node && node != parent && node != up &&
+                            (resume.empty() || resume.back() != parent))
+                            resume.push_back(parent);
+                    }
+                }
+            }
+            if (resume.empty()) return;
+            node = resume.back();
+            resume.pop_back();
+        }
+    }
+
+    /* 持有 node 的锁，修好高度后返回下一个要检查的节点 */
+    static link_type fix_height_nl(link_type node) {
+        int c = node_condition(node);
+        switch (c) {
+        case REBALANCE:
+        case UNLINK:
+            return node;
+        case NOTHING:
+            return nullptr;
+        default:
+            node->height.store(c);
+            return node->parent.load();
+        }
+    }
+
+    /* 持有 parent 和 node 的锁 */
+    link_type rebalance_nl(link_type parent, link_type node) {
+        link_type l = node->left.load(), r = node->right.load();
+        if ((nullptr == l || nullptr == r) && !node->present.load()) {
+            if (attempt_unlink_nl(parent, node)) return fix_height_nl(parent);
+            return node;
+        }
+        int h = node->height.load(), hl = height(l), hr = height(r);
+        int repl = 1 + MAX(hl, hr), bal = hl - hr;
+        if (bal > 1)
+            return rebalance_to_right_nl(parent, node, l, hr);
+        if (bal < -1)
+            return rebalance_to_left_nl(parent, node, r, hl);
+        if (repl != h) {
+            node->height.store(repl);
+            return fix_height_nl(parent);
+        }
+        return nullptr;
+    }
+
+    link_type rebalance_to_right_nl(link_type parent, link_type node, link_type l, int hr0) {
+        guard gl(l);
+        int hl = l->height.load();
+        if (hl - hr0 <= 1) return node;     /* 条件已变，重试 */
+
+        link_type lr = l->right.load();
+        int hll0 = height(l->left.load()), hlr0 = height(lr);
+        if (hll0 >= hlr0)
+            return rotate_right_nl(parent, node, l, hr0, hll0, lr, hlr0);
+        {
+            guard glr(lr);
+            int hlr = lr->height.load();
+            if (hll0 >= hlr)
+                return rotate_right_nl(parent, node, l, hr0, hll0, lr, hlr);
+            int hlrl = height(lr->left.load()), b = hll0 - hlrl;
+            if (b >= -1 && b <= 1)
+                return rotate_right_over_left_nl(parent, node, l, hr0, hll0, lr, hlrl);
+        }
+        return rebalance_to_left_nl(node, l, lr, hll0);
+    }
+
+    link_type rebalance_to_left_nl(link_type parent, link_type node, link_type r, int hl0) {
+        guard gr(r);
+        int hr = r->height.load();
+        if (hl0 - hr >= -1) return node;
+
+        link_type rl = r->left.load();
+        int hrl0 = height(rl), hrr0 = height(r->right.load());
+        if (hrr0 >= hrl0)
+            return rotate_left_nl(parent, node, hl0, r, rl, hrl0, hrr0);
+        {
+            guard grl(rl);
+            int hrl = rl->height.load();
+            if (hrr0 >= hrl)
+                return rotate_left_nl(parent, node, hl0, r, rl, hrl, hrr0);
+            int hrlr = height(rl->right.load()), b = hrr0 - hrlr;
+            if (b >= -1 && b <= 1)
+                return rotate_left_over_right_nl(parent, node, hl0, r, rl, hrr0, hrlr);
+        }
+        return rebalance_to_right_nl(node, r, rl, hrr0);
+    }
+
+    static void replace_child(link_type parent, link_type old, link_type x) {
+        (parent->left.load() == old ? parent->left : parent->right).store(x);
+        x->parent.store(parent);
+    }
+
+    link_type rotate_right_nl(link_type parent, link_type n, link_type l,
+                              int hr, int hll, link_type lr, int hlr) {
+        uint64_t v = n->version.load();
+        n->version.store(begin_change(v));
+        n->left.store(lr);
+        if (lr) lr->parent.store(n);
+        l->right.store(n);
+        n->parent.store(l);
+        replace_child(parent, n, l);
+
+        int hn = 1 + MAX(hlr, hr);
+        n->height.store(hn);
+        l->height.store(1 + MAX(hll, hn));
+        n->version.store(end_change(v));
+
+        int baln = hlr - hr;
+        if (baln < -1 || baln > 1) return n;
+        if ((nullptr == lr || 0 == hr) && !n->present.load()) return n;
+        int ball = hll - hn;
+        if (ball < -1 || ball > 1) return l;
+        if (0 == hll && !l->present.load()) return l;
+        return fix_height_nl(parent);
+    }
+
+    link_type rotate_left_nl(link_type parent, link_type n, int hl,
+                             link_type r, link_type rl, int hrl, int hrr) {
+        uint64_t v = n->version.load();
+        n->version.store(begin_change(v));
+        n->right.store(rl);
+        if (rl) rl->parent.store(n);
+        r->left.store(n);
+        n->parent.store(r);
+        replace_child(parent, n, r);
+
+        int hn = 1 + MAX(hl, hrl);
+        n->height.store(hn);
+        r->height.store(1 + MAX(hn, hrr));
+        n->version.store(end_change(v));
+
+        int baln = hrl - hl;
+        if (baln < -1 || baln > 1) return n;
+        if ((nullptr == rl || 0 == hl) && !n->present.load()) return n;
+        int balr = hrr - hn;
+        if (balr < -1 || balr > 1) return r;
+        if (0 == hrr && !r->present.load()) return r;
+        return fix_height_nl(parent);
+    }
+
+    link_type rotate_right_over_left_nl(link_type parent, link_type n, link_type l,
+                                        int hr, int hll, link_type lr, int hlrl) {
+        uint64_t nv = n->version.load(), lv = l->version.load();
+        link_type lrl = lr->left.load(), lrr = lr->right.load();
+        int hlrr = height(lrr);
+
+        n->version.store(begin_change(nv));
+        l->version.store(begin_change(lv));
+        n->left.store(lrr);
+        if (lrr) lrr->parent.store(n);
+        l->right.store(lrl);
+        if (lrl) lrl->parent.store(l);
+        lr->left.store(l);
+        l->parent.store(lr);
+        lr->right.store(n);
+        n->parent.store(lr);
+        replace_child(parent, n, lr);
+
+        int hn = 1 + MAX(hlrr, hr);
+        n->height.store(hn);
+        int hl = 1 + MAX(hll, hlrl);
+        l->height.store(hl);
+        lr->height.store(1 + MAX(hl, hn));
+        n->version.store(end_change(nv));
+        l->version.store(end_change(lv));
+
+        int baln = hlrr - hr;
+        if (baln < -1 || baln > 1) return n;
+        if ((nullptr == lrr || 0 == hr) && !n->present.load()) return n;
+        if ((nullptr == lrl || 0 == hll) && !l->present.load()) return l;   /* 路由节点少了孩子，交给上层摘下 */
+        int ballr = hl - hn;
+        if (ballr < -1 || ballr > 1) return lr;
+        return fix_height_nl(parent);
+    }
+
+    link_type rotate_left_over_right_nl(link_type parent, link_type n, int hl,
+                                        link_type r, link_type rl, int hrr, int hrlr) {
+        uint64_t nv = n->version.load(), rv = r->version.load();
+        link_type rll = rl->left.load(), rlr = rl->right.load();
+        int hrll = height(rll);
+
+        n->version.store(begin_change(nv));
+        r->version.store(begin_change(rv));
+        n->right.store(rll);
+        if (rll) rll->parent.store(n);
+        r->left.store(rlr);
+        if (rlr) rlr->parent.store(r);
+        rl->right.store(r);
+        r->parent.store(rl);
+        rl->left.store(n);
+        n->parent.store(rl);
+        replace_child(parent, n, rl);
+
+        int hn = 1 + MAX(hl, hrll);
+        n->height.store(hn);
+        int hr = 1 + MAX(hrlr, hrr);
+        r->height.store(hr);
+        rl->height.store(1 + MAX(hn, hr));
+        n->version.store(end_change(nv));
+        r->version.store(end_change(rv));
+
+        int baln = hrll - hl;
+        if (baln < -1 || baln > 1) return n;
+        if ((nullptr == rll || 0 == hl) && !n->present.load()) return n;
+        if ((nullptr == rlr || 0 == hrr) && !r->present.load()) return r;
+        int balrl = hr - hn;
+        if (balrl < -1 || balrl > 1) return rl;
+        return fix_height_nl(parent);
+    }
+};
+
+#endif
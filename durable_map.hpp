@@ -0,0 +1,314 @@
+/**
+ * @file durable_map.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief write-ahead logged map with group commit, checkpoints and bulk recovery
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __DURABLE_MAP_HPP__
+#define __DURABLE_MAP_HPP__
+#include "rb_tree.hpp"
+#include "serialize.hpp"
+
+#include <algorithm>
+#include <errno.h>
+
+/**
+ * 磁盘上两个文件：
+ *   path.snap  stream_save() 写出的快照
+ *   path.log   快照之后的操作日志，每条定长 __wal_record，带校验和
+ * insert/remove 先修改内存中的树，再把日志追加到缓冲区，攒够 group 条后
+ * 一次 write + fdatasync（group commit）。日志超过 checkpoint_every 条时写新快照并清空日志。
+ *
+ * 恢复时日志按键稳定排序，同一个键只保留最后一次操作，再与快照做归并，
+ * 归并结果交给 assign_sorted() 线性时间建树。快照要读两遍：第一遍只数出最终的个数。
+ * 日志末尾不完整或校验失败的记录视为崩溃时没写完，截掉。
+ * 日志操作都是“置为某值/删除”，重复回放结果不变，所以写完快照、清空日志之间崩溃也没关系。
+ */
+#define WAL_INSERT  (1u)
+#define WAL_REMOVE  (2u)
+
+template <typename keyType, typename valueType>
+struct __wal_record {
+    uint32_t  sum;
+    uint32_t  op;
+    keyType   key;
+    valueType value;
+};
+
+template <typename keyType, typename valueType,
+          typename Engine = rbt_map<keyType, valueType> >
+class durable_map {
+public:
+    typedef __wal_record<keyType, valueType>    record;
+    typedef bst_map<keyType, valueType>         tree_type;
+    typedef typename tree_type::link_type       link_type;
+
+    static_assert(std::is_trivially_copyable<keyType>::value &&
+                  std::is_trivially_copyable<valueType>::value,
+                  "durable_map needs trivially copyable keys and values");
+
+    Engine tree;
+
+    durable_map() : fd(-1), group(1), checkpoint_every(0), logged(0) {}
+    ~durable_map() { (void)close(); }
+
+    durable_map(const durable_map &) = delete;
+    durable_map &operator=(const durable_map &) = delete;
+
+    /**
+     * 打开或创建 path 对应的快照和日志，并恢复内存中的树。
+     * group 为一次 fdatasync 覆盖的操作数，checkpoint_every 为 0 时不自动写快照。
+     * 自动快照在触发它的那次 insert/remove 里同步完成，要把整棵树写一遍，
+     * 这一次调用会停顿 O(n)；不能接受时传 0，由调用方在空闲时自己调用 checkpoint()。
+     * 成功返回 0，失败返回 -1。
+     */
+    int open(const char *path, size_t group_size = 64, size_t checkpoint = 1u << 20,
+             stream_stats *stats = nullptr) {
+        auto tic = std::chrono::steady_clock::now();
+        if (close()) return -1;             /* 先前打开的日志没能落盘 */
+        snap_path = std::string(path) + ".snap";
+        log_path = std::string(path) + ".log";
+        group = group_size ? group_size : 1;
+        checkpoint_every = checkpoint;
+
+        fd = ::open(log_path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return -1;
+        if (recover()) {
+            close();
+            return -1;
+        }
+        if (stats) {
+            stats->records = tree.size;
+            stats->bytes = recovered_bytes;
+            stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tic).count();
+        }
+        return 0;
+    }
+
+    /* 刷出缓冲的日志并关闭，不写快照；日志没能全部落盘时返回 -1，但文件照样关闭 */
+    int close() {
+        if (fd < 0) return 0;
+        int ret = sync();
+        if (::close(fd)) ret = -1;
+        fd = -1;
+        tree.clear();
+        return ret;
+    }
+
+    int insert(const keyType &key, const valueType &value) {
+        tree.insert(key, value);
+        return append(WAL_INSERT, key, value);
+    }
+
+    int remove(const keyType &key) {
+        if (nullptr == tree.find(key)) return 0;
+        tree.remove(key);
+        return append(WAL_REMOVE, key, valueType());
+    }
+
+    link_type find(const keyType &key) const {
+        return tree.find(key);
+    }
+
+    /**
+     * 把缓冲区中的日志写入并 fdatasync，返回 0 表示之前的操作都已落盘。
+     * 已写出的部分立即从 pending 中去掉，write() 中途失败后再次 sync() 只写剩下的，
+     * 日志中不会出现重复的前缀，后面的记录也不会错位。
+     */
+    int sync() {
+        size_t done = 0;
+        while (done < pending.size()) {
+            ssize_t n = ::write(fd, pending.data() + done, pending.size() - done);
+            if (n < 0 && EINTR == errno) continue;
+            if (n < 0) break;
+            done += n;
+        }
+        pending.erase(pending.begin(), pending.begin() + done);
+        if (!pending.empty()) return -1;
+        return done ? fdatasync(fd) : 0;
+    }
+
+    /**
+     * 写新快照：先写临时文件并 fsync，rename 之后 fsync 所在目录，
+     * 确认新快照的目录项落盘后才清空日志，否则断电后可能旧快照配空日志。
+     */
+    int checkpoint() {
+        std::string tmp = snap_path + ".tmp";
+        if (sync() || stream_save(tree, tmp.c_str()) || fsync_path(tmp.c_str()))
+            return -1;
+        if (rename(tmp.c_str(), snap_path.c_str())) return -1;
+        if (fsync_path(parent_dir(snap_path).c_str())) return -1;
+        if (ftruncate(fd, 0) || lseek(fd, 0, SEEK_SET) || fdatasync(fd)) return -1;
+        logged = 0;
+        return 0;
+    }
+
+    /* 树之外，未写出的日志缓冲和路径字符串是 metadata */
+    map_memory memory_usage() const {
+        map_memory m = tree.memory_usage();
+        m.metadata += sizeof(*this) - sizeof(Engine) + pending.capacity() +
+                      snap_path.capacity() + log_path.capacity();
+        m.overhead += malloc_overhead(pending.capacity());
+        return m;
+    }
+
+private:
+    int                 fd;
+    size_t              group;
+    size_t              checkpoint_every;
+    size_t              logged;         /* 当前日志中的记录数 */
+    size_t              recovered_bytes;
+    std::string         snap_path;
+    std::string         log_path;
+    std::vector<char>   pending;        /* 尚未写入的日志 */
+
+    static uint32_t checksum(const record &r) {
+        const unsigned char *p = (const unsigned char *)&r + sizeof(r.sum);
+        uint32_t h = 2166136261u;       /* FNV-1a */
+        for (size_t i = sizeof(r.sum); i < sizeof(r); i++) {
+            h ^= *p++;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    static int fsync_path(const char *path) {
+        int f = ::open(path, O_RDONLY);
+        if (f < 0) return -1;
+        int ret = fsync(f);
+        ::close(f);
+        return ret;
+    }
+
+    static std::string parent_dir(const std::string &path) {
+        size_t slash = path.rfind('/');
+        if (std::string::npos == slash) return ".";
+        if (0 == slash) return "/";
+        return path.substr(0, slash);
+    }
+
+    int append(uint32_t op, const keyType &key, const valueType &value) {
+        record r;
+        memset(&r, 0, sizeof(r));     /* 填充字节也参与校验 */
+        r.op = op;
+        r.key = key;
+        r.value = value;
+        r.sum = checksum(r);
+        pending.insert(pending.end(), (const char *)&r, (const char *)&r + sizeof(r));
+        logged++;
+
+        if (pending.size() >= group * sizeof(record) && sync()) return -1;
+        if (checkpoint_every && logged >= checkpoint_every) return checkpoint();
+        return 0;
+    }
+
+    /* 读出整个日志，遇到第一条不完整或校验失败的记录就截断 */
+    int read_log(std::vector<record> &log) {
+        record r;
+        off_t good = 0;
+        if (lseek(fd, 0, SEEK_SET)) return -1;
+        for (;;) {
+            ssize_t n = ::read(fd, &r, sizeof(r));
+            if (n != (ssize_t)sizeof(r) || r.sum != checksum(r) ||
+                (WAL_INSERT != r.op && WAL_REMOVE != r.op))
+                break;
+            log.push_back(r);
+            good += sizeof(r);
+        }
+        recovered_bytes += good;
+        if (ftruncate(fd, good) || lseek(fd, good, SEEK_SET) != good) return -1;
+        logged = log.size();
+        return 0;
+    }
+
+    /* 快照与日志的归并游标；日志已按键排序且去重 */
+    struct merger {
+        stream_reader<keyType, valueType>   snap;
+        const std::vector<record>          &log;
+        size_t      i;
+        bool        has_snap;       /* snap_key/snap_value 有效 */
+        keyType     snap_key;
+        valueType   snap_value;
+        size_t      snap_left;
+
+        explicit merger(const std::vector<record> &l) : log(l), i(0), has_snap(false),
+                                                        snap_key(), snap_value(), snap_left(0) {}
+
+        int open(const char *path) {
+            if (access(path, F_OK)) return 0;      /* 还没有快照 */
+            if (snap.open(path)) return -1;
+            snap_left = snap.count;
+            return advance_snap();
+        }
+
+        int advance_snap() {
+            has_snap = false;
+            if (0 == snap_left) return 0;
+            snap_left--;
+            if (!snap.next(snap_key, snap_value)) return -1;
+            has_snap = true;
+            return 0;
+        }
+
+        /* 取下一条最终存在的记录，没有时返回 0，出错返回 -1 */
+        int next(keyType &key, valueType &value) {
+            for (;;) {
+                bool take_log = i < log.size() &&
+                                (!has_snap || !(snap_key < log[i].key));
+                if (take_log) {
+                    const record &r = log[i++];
+                    if (has_snap && !(r.key < snap_key) && advance_snap()) return -1;
+                    if (WAL_REMOVE == r.op) continue;
+                    key = r.key;
+                    value = r.value;
+                    return 1;
+                }
+                if (!has_snap) return 0;
+                key = snap_key;
+                value = snap_value;
+                return advance_snap() ? -1 : 1;
+            }
+        }
+    };
+
+    int recover() {
+        std::vector<record> log;
+        recovered_bytes = 0;
+        if (read_log(log)) return -1;
+
+        std::stable_sort(log.begin(), log.end(), [](const record &a, const record &b) {
+            return a.key < b.key;
+        });
+        size_t n = 0;
+        for (size_t i = 0; i < log.size(); i++) {
+            if (n && !(log[n - 1].key < log[i].key))
+                log[n - 1] = log[i];        /* 同一个键，后写的覆盖先写的 */
+            else
+                log[n++] = log[i];
+        }
+        log.resize(n);
+
+        /* 第一遍只计数 */
+        keyType key;
+        valueType value;
+        size_t count = 0;
+        int ret;
+        {
+            merger m(log);
+            if (m.open(snap_path.c_str())) return -1;
+            while ((ret = m.next(key, value)) > 0) count++;
+            if (ret < 0) return -1;
+            recovered_bytes += m.snap.bytes;
+        }
+
+        merger m(log);
+        if (m.open(snap_path.c_str())) return -1;
+        return tree.assign_sorted(count, [&m](keyType &k, valueType &v) {
+            return m.next(k, v) > 0;
+        }) ? 0 : -1;
+    }
+};
+
+#endif
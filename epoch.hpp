@@ -0,0 +1,167 @@
+/**
+ * @file epoch.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief epoch-based reclamation for nodes unlinked while lock-free readers run
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __EPOCH_HPP__
+#define __EPOCH_HPP__
+#include <stdint.h>
+#include <assert.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/**
+ * 读者进入临界区时把当前的全局 epoch 记在自己的槽位上，离开时清零。
+ * 写者摘下节点后 retire()，记下当时的全局 epoch r；
+ * 全局 epoch 只有在所有在场读者都已看到它时才能加一，
+ * 因此升到 r + 2 时，摘下之前进来的读者一定都已离开，节点可以释放。
+ *
+ * 每个线程第一次进入时占用一个槽位编号，线程退出时归还，同一编号在所有 domain 中通用，
+ * 最多 EPOCH_MAX_THREADS 个线程同时存在。读者临界区不可嵌套。
+ */
+#define EPOCH_MAX_THREADS 128
+#define EPOCH_BATCH       64      /* 每 retire 这么多次尝试推进并回收一次 */
+
+struct __epoch_registry {
+    std::atomic<bool> used[EPOCH_MAX_THREADS];
+
+    static __epoch_registry &instance() {
+        static __epoch_registry r;
+        return r;
+    }
+
+    int claim() {
+        for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+            bool expect = false;
+            if (!used[i].load(std::memory_order_relaxed) &&
+                used[i].compare_exchange_strong(expect, true))
+                return i;
+        }
+        assert(0 && "too many threads");
+        return -1;
+    }
+
+    void release(int i) { used[i].store(false, std::memory_order_release); }
+};
+
+/* 线程退出时自动归还槽位 */
+struct __epoch_thread {
+    int index;
+    __epoch_thread() : index(__epoch_registry::instance().claim()) {}
+    ~__epoch_thread() { __epoch_registry::instance().release(index); }
+
+    static int self() {
+        static thread_local __epoch_thread t;
+        return t.index;
+    }
+};
+
+class epoch_domain {
+public:
+    typedef void (*reclaim_fn)(void *ctx, void *ptr);
+
+    epoch_domain(reclaim_fn fn, void *ctx) : global(1), reclaim(fn), context(ctx), retires(0) {
+        for (auto &s : slots) s.active.store(0, std::memory_order_relaxed);
+    }
+    ~epoch_domain() { drain(); }
+
+    epoch_domain(const epoch_domain &) = delete;
+    epoch_domain &operator=(const epoch_domain &) = delete;
+
+    void enter() {
+        slot &s = slots[__epoch_thread::self()];
+        s.active.store(global.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        /* 槽位的写入必须先于之后对树的读取被写者看到 */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void exit() {
+        slots[__epoch_thread::self()].active.store(0, std::memory_order_release);
+    }
+
+    /* ptr 已从结构中摘下，等读者离开后交给 reclaim 释放 */
+    void retire(void *ptr) {
+        std::lock_guard<std::mutex> guard(lock);
+        limbo.push_back(retired{ptr, global.load(std::memory_order_relaxed)});
+        if (++retires % EPOCH_BATCH == 0) {
+            advance();
+            collect();
+        }
+    }
+
+    /* 等待全部已 retire 的对象释放，调用者自己不能处在读者临界区中 */
+    void drain() {
+        std::lock_guard<std::mutex> guard(lock);
+        while (!limbo.empty()) {
+            advance();
+            collect();
+        }
+    }
+
+    /* 尚未释放的对象个数 */
+    size_t pending() {
+        std::lock_guard<std::mutex> guard(lock);
+        return limbo.size();
+    }
+
+private:
+    struct alignas(64) slot {
+        std::atomic<uint64_t> active;   /* 0 表示不在临界区 */
+    };
+
+    struct retired {
+        void     *ptr;
+        uint64_t  epoch;
+    };
+
+    slot                    slots[EPOCH_MAX_THREADS];
+    std::atomic<uint64_t>   global;
+    reclaim_fn              reclaim;
+    void                   *context;
+    std::mutex              lock;       /* 保护 limbo，允许多个写者 */
+    std::vector<retired>    limbo;
+    size_t                  retires;
+
+    /* 所有在场读者都已看到当前 epoch 时把它加一 */
+    void advance() {
+        uint64_t e = global.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (auto &s : slots) {
+            uint64_t a = s.active.load(std::memory_order_acquire);
+            if (a && a != e) return;
+        }
+        global.store(e + 1, std::memory_order_release);
+    }
+
+    void collect() {
+        uint64_t e = global.load(std::memory_order_relaxed);
+        size_t n = 0;
+        for (size_t i = 0; i < limbo.size(); i++) {
+            if (limbo[i].epoch + 2 <= e)
+                reclaim(context, limbo[i].ptr);
+            else
+                limbo[n++] = limbo[i];
+        }
+        limbo.resize(n);
+    }
+};
+
+/* 读者临界区 */
+class epoch_guard {
+public:
+    explicit epoch_guard(epoch_domain &d) : domain(d) { domain.enter(); }
+    ~epoch_guard() { domain.exit(); }
+
+    epoch_guard(const epoch_guard &) = delete;
+    epoch_guard &operator=(const epoch_guard &) = delete;
+
+private:
+    epoch_domain &domain;
+};
+
+#endif
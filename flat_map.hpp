@@ -0,0 +1,243 @@
+/**
+ * @file flat_map.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief sorted vector map with a buffered insert path and tombstones
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __FLAT_MAP_HPP__
+#define __FLAT_MAP_HPP__
+#include "bst.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+const char *FLAT_MAP = "flat";
+
+/**
+ * 主体是按键有序的 vector，新键先进入一个小的侧缓冲区：
+ *   - 缓冲区由有序前缀和无序尾巴组成，尾巴超过 FLAT_TAIL 个时排序并归并进前缀，
+ *     这样查找缓冲区是一次二分加最多 FLAT_TAIL 次比较；
+ *   - 缓冲区达到约 sqrt(n) 个时整体归并进主体，摊还到每次插入是 O(sqrt(n))；
+ *   - 删除主体中的元素只打墓碑，墓碑超过 1/4 或遇到归并时顺便清理。
+ * 迭代前会先把缓冲区归并掉，因此迭代只是顺序扫描主体并跳过墓碑。
+ * 与 bst_map 不同，insert/find 返回的指针在下一次插入或删除后就可能失效。
+ */
+#define FLAT_TAIL    32
+#define FLAT_MIN_BUF 64
+
+template <typename keyType, typename valueType>
+class flat_map {
+public:
+    typedef keyType                         key_type;
+    typedef valueType                       value_type;
+    typedef valueType&                      reference;
+
+    struct entry {
+        key_type   key;
+        value_type value;
+        bool       dead;        /* 墓碑 */
+    };
+
+    struct iterator {
+        entry *pos;
+        entry *last;
+
+        iterator(entry *p, entry *l) : pos(p), last(l) { skip(); }
+
+        const keyType &key() const { return pos->key; }
+        reference operator*() const { return pos->value; }
+        valueType *operator->() const { return &pos->value; }
+
+        iterator& operator++() {
+            ++pos;
+            skip();
+            return *this;
+        }
+
+        bool operator==(const iterator &x) const { return pos == x.pos; }
+        bool operator!=(const iterator &x) const { return pos != x.pos; }
+
+    private:
+        void skip() { while (pos != last && pos->dead) ++pos; }
+    };
+
+    size_t  size;
+
+    flat_map() : size(0), dead(0), sorted_buf(0) {}
+
+    reference operator[](const keyType &key) {
+        entry *pos = find(key);
+        if (pos) return pos->value;
+        return insert(key, valueType())->value;
+    }
+
+    entry *insert(const keyType &key, const valueType &value) {
+        entry *pos = lookup_main(key);
+        if (pos) {
+            if (pos->dead) {
+                pos->dead = false;
+                dead--;
+                size++;
+            }
+            pos->value = value;
+            return pos;
+        }
+        if ((pos = lookup_buffer(key))) {
+            pos->value = value;
+            return pos;
+        }
+
+        buffer.push_back(entry{key, value, false});
+        size++;
+        if (buffer.size() >= buffer_limit()) {
+            merge();
+            return lookup_main(key);
+        }
+        if (buffer.size() - sorted_buf > FLAT_TAIL) {
+            sort_buffer();
+            return lookup_buffer(key);
+        }
+        return &buffer.back();
+    }
+
+    void remove(const keyType &key) {
+        entry *pos = lookup_main(key);
+        if (pos) {
+            if (pos->dead) return;
+            pos->dead = true;
+            dead++;
+            size--;
+            if (dead > items.size() / 4) merge();
+            return;
+        }
+        if ((pos = lookup_buffer(key))) {
+            size_t i = pos - buffer.data();
+            if (i < sorted_buf) sorted_buf--;
+            buffer.erase(buffer.begin() + i);
+            size--;
+        }
+    }
+
+    entry *find(const keyType &key) {
+        entry *pos = lookup_main(key);
+        if (pos) return pos->dead ? nullptr : pos;
+        return lookup_buffer(key);
+    }
+
+    void clear() {
+        items.clear();
+        buffer.clear();
+        size = dead = sorted_buf = 0;
+    }
+
+    bool empty() const {
+        return 0 == size;
+    }
+
+    iterator begin() {
+        merge();
+        return iterator(items.data(), items.data() + items.size());
+    }
+
+    iterator end() {
+        entry *last = items.data() + items.size();
+        return iterator(last, last);
+    }
+
+    /* 先把缓冲区合并进主体，再按下标均分，跳过墓碑 */
+    template <typename Fn>
+    void parallel_for_each(Fn fn, thread_pool &pool = thread_pool::instance()) {
+        merge();
+        __array_for_each(pool, items.data(), items.size(), fn, [](const entry &e) { return !e.dead; });
+    }
+
+    template <typename T, typename Map, typename Reduce>
+    T parallel_reduce(T init, Map map_fn, Reduce reduce_fn, thread_pool &pool = thread_pool::instance()) {
+        merge();
+        return __array_reduce(pool, items.data(), items.size(), init, map_fn, reduce_fn,
+                              [](const entry &e) { return !e.dead; });
+    }
+
+    /* 墓碑和两个 vector 的多余容量都是 slack */
+    map_memory memory_usage() const {
+        map_memory m;
+        m.nodes = size * sizeof(entry);
+        m.slack = (items.capacity() + buffer.capacity()) * sizeof(entry) - m.nodes;
+        m.overhead = malloc_overhead(items.capacity() * sizeof(entry)) +
+                     malloc_overhead(buffer.capacity() * sizeof(entry));
+        m.metadata = sizeof(*this);
+        return m;
+    }
+
+    const char *name() const {
+        return FLAT_MAP;
+    }
+
+private:
+    std::vector<entry> items;       /* 主体，有序 */
+    std::vector<entry> buffer;      /* [0, sorted_buf) 有序，其后无序 */
+    size_t dead;
+    size_t sorted_buf;
+
+    static bool key_less(const entry &a, const entry &b) {
+        return a.key < b.key;
+    }
+
+    static entry *search(entry *first, entry *last, const keyType &key) {
+        entry probe;
+        probe.key = key;
+        entry *pos = std::lower_bound(first, last, probe, key_less);
+        if (pos != last && !(key < pos->key)) return pos;
+        return nullptr;
+    }
+
+    size_t buffer_limit() const {
+        size_t limit = (size_t)sqrt((double)items.size());
+        return limit < FLAT_MIN_BUF ? FLAT_MIN_BUF : limit;
+    }
+
+    entry *lookup_main(const keyType &key) {
+        return search(items.data(), items.data() + items.size(), key);
+    }
+
+    entry *lookup_buffer(const keyType &key) {
+        entry *pos = search(buffer.data(), buffer.data() + sorted_buf, key);
+        if (pos) return pos;
+        for (size_t i = sorted_buf; i < buffer.size(); i++)
+            if (!(buffer[i].key < key) && !(key < buffer[i].key))
+                return &buffer[i];
+        return nullptr;
+    }
+
+    void sort_buffer() {
+        std::sort(buffer.begin() + sorted_buf, buffer.end(), key_less);
+        std::inplace_merge(buffer.begin(), buffer.begin() + sorted_buf,
+                           buffer.end(), key_less);
+        sorted_buf = buffer.size();
+    }
+
+    /* 缓冲区归并进主体，同时丢掉墓碑 */
+    void merge() {
+        if (buffer.empty() && 0 == dead) return;
+        sort_buffer();
+
+        std::vector<entry> out;
+        out.reserve(size);
+        size_t i = 0, j = 0;
+        while (i < items.size() || j < buffer.size()) {
+            if (j == buffer.size() ||
+                (i < items.size() && items[i].key < buffer[j].key)) {
+                if (!items[i].dead) out.push_back(items[i]);
+                i++;
+            } else
+                out.push_back(buffer[j++]);
+        }
+        items.swap(out);
+        buffer.clear();
+        dead = sorted_buf = 0;
+    }
+};
+
+#endif
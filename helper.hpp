@@ -8,6 +8,8 @@
 #include <assert.h>
 
 #include <sstream>
+#include <vector>
+#include <type_traits>
 
 /**
  * printing tree in ascii
@@ -274,6 +276,101 @@ void print(T &mmap) {
     print(mmap.root);
 }
 
+/**
+ * 树的形状：高度、各层节点数、成功查找的平均路径长度（访问的节点数）、黑高和红节点比例。
+ * 沿 parent 指针迭代遍历一次，不递归、不用栈，也没有层数上限，2000 万个节点的树也能用，
+ * 而上面的 print() 只适合几十个节点。颜色由调用方传入的 is_red(node) 判断，各树的红色取值不必相同
+ * （rb_tree.hpp 的 rbt_red、llrb_tree.hpp 的 llrb_red）；不传时（bst、avl，color 与 height 共用）
+ * 不统计颜色，red 与 black_height 为 0。
+ */
+struct tree_shape {
+    size_t              nodes;
+    size_t              height;         /* 层数，空树为 0 */
+    size_t              path;           /* 各节点深度加一之和 */
+    size_t              red;
+    long                black_height;   /* 根到每个空链接经过的黑节点数（含根），不一致时为 -1 */
+    std::vector<size_t> depth;          /* depth[d] 为第 d 层的节点数，根在第 0 层 */
+
+    tree_shape() : nodes(0), height(0), path(0), red(0), black_height(0) {}
+
+    /* 成功查找平均访问的节点数 */
+    double avg_path() const { return nodes ? (double)path / nodes : 0; }
+    double red_ratio() const { return nodes ? (double)red / nodes : 0; }
+
+    /* name  nodes  height  avg_path  red%  black_height，下一行是各层的节点数 */
+    void print(FILE *out, const char *name) const {
+        fprintf(out, "%s\t%zu\t%zu\t%.2f\t%.1f%%\t%ld\n", name, nodes, height,
+                avg_path(), 100 * red_ratio(), black_height);
+        fprintf(out, "\tdepth");
+        for (size_t d = 0; d < depth.size(); d++)
+            fprintf(out, " %zu", depth[d]);
+        fprintf(out, "\n");
+    }
+
+    static void print_header(FILE *out) {
+        fprintf(out, "#\tnodes\theight\tavg_path\tred\tblack_height\n");
+    }
+};
+
+/* shape() 的默认判断：不统计颜色 */
+struct shape_no_color {
+    template <typename Node>
+    bool operator()(const Node *) const { return false; }
+};
+
+template <typename keyType, typename valueType, typename IsRed = shape_no_color>
+tree_shape shape(__node_base<keyType, valueType> *root, IsRed is_red = IsRed()) {
+    typedef __node_base<keyType, valueType> *link_type;
+    const bool colored = !std::is_same<IsRed, shape_no_color>::value;
+    tree_shape s;
+    link_type node = root, prev = nullptr;
+    size_t d = 0;
+    long blacks = 0;
+    bool leaf_seen = false;
+
+    while (node) {
+        if (nullptr == prev ? node == root : prev == node->parent) {    /* 第一次到达 node */
+            if (d == s.depth.size()) s.depth.push_back(0);
+            s.depth[d]++;
+            s.nodes++;
+            s.path += d + 1;
+            if (colored) {
+                if (is_red(node)) s.red++;
+                else blacks++;
+                if (nullptr == node->left || nullptr == node->right) {
+                    if (!leaf_seen) s.black_height = blacks;
+                    else if (s.black_height != blacks) s.black_height = -1;
+                    leaf_seen = true;
+                }
+            }
+            if (node->left) {
+                prev = node;
+                node = node->left;
+                d++;
+                continue;
+            }
+        }
+        if (prev != node->right && node->right) {     /* 左子树（或空的左子树）已经走完 */
+            prev = node;
+            node = node->right;
+            d++;
+            continue;
+        }
+        if (colored && !is_red(node)) blacks--;
+        if (node == root) break;            /* root 可以是一棵子树 */
+        prev = node;
+        node = node->parent;
+        d--;
+    }
+    s.height = s.depth.size();
+    return s;
+}
+
+template <typename T, typename IsRed = shape_no_color>
+tree_shape shape(T &map, IsRed is_red = IsRed()) {
+    return shape(map.root, is_red);
+}
+
 /************************** end of printing tree in ascii *********************************/
 
 
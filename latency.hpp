@@ -0,0 +1,120 @@
+/**
+ * @file latency.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief HDR-style latency histogram for per-operation tail percentiles
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * G. Tene. HdrHistogram: A High Dynamic Range Histogram.
+ */
+#ifndef __LATENCY_HPP__
+#define __LATENCY_HPP__
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <chrono>
+
+#define LATENCY_SUB_BITS    8                                   /* 每个 2 的幂区间分 128 格，相对误差 < 1% */
+#define LATENCY_HALF        (1u << (LATENCY_SUB_BITS - 1))
+#define LATENCY_BUCKETS     ((64 - LATENCY_SUB_BITS + 2) * LATENCY_HALF)
+
+/* 单调时钟，纳秒 */
+inline uint64_t latency_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * 对数-线性分桶：小于 2^LATENCY_SUB_BITS 的值每个值一格，更大的值按最高位所在的
+ * 2 的幂区间分段，每段再均分成 LATENCY_HALF 格。格数固定（约 7.4K 个计数，58KB），
+ * 记录一次只是一次 clz 加一次自增，不分配内存，可以放在每次操作的路径上。
+ * 分位数返回所在格的上界，与精确值的相对误差不超过 1 / LATENCY_HALF。
+ */
+class latency_histogram {
+public:
+    latency_histogram() { reset(); }
+
+    void reset() {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        sum = 0;
+        high = 0;
+        low = UINT64_MAX;
+    }
+
+    void record(uint64_t value) {
+        counts[index(value)]++;
+        total++;
+        sum += value;
+        if (value > high) high = value;
+        if (value < low) low = value;
+    }
+
+    /* 合并另一个直方图，各线程分别记录、最后汇总时用 */
+    void merge(const latency_histogram &x) {
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+            counts[i] += x.counts[i];
+        total += x.total;
+        sum += x.sum;
+        if (x.high > high) high = x.high;
+        if (x.low < low) low = x.low;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return high; }
+    uint64_t min() const { return total ? low : 0; }
+    double mean() const { return total ? (double)sum / total : 0; }
+
+    /* 第 p 百分位（0 < p <= 100）的值，超过 max() 时取 max() */
+    uint64_t percentile(double p) const {
+        if (0 == total) return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5), seen = 0;
+        if (rank < 1) rank = 1;
+        if (rank > total) rank = total;
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint64_t v = highest(i);
+                return v < high ? v : high;
+            }
+        }
+        return high;
+    }
+
+    /* name  count  mean  p50  p90  p99  p99.9  max，单位与记录的值相同 */
+    void print(FILE *out, const char *name) const {
+        fprintf(out, "%s\t%lu\t%.1f\t%lu\t%lu\t%lu\t%lu\t%lu\n", name,
+                (unsigned long)total, mean(),
+                (unsigned long)percentile(50), (unsigned long)percentile(90),
+                (unsigned long)percentile(99), (unsigned long)percentile(99.9),
+                (unsigned long)high);
+    }
+
+    static void print_header(FILE *out) {
+        fprintf(out, "#\tcount\tmean\tp50\tp90\tp99\tp99.9\tmax\n");
+    }
+
+private:
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t high;
+    uint64_t low;
+
+    static size_t index(uint64_t value) {
+        if (value < (1u << LATENCY_SUB_BITS)) return (size_t)value;
+        int shift = 64 - __builtin_clzll(value) - LATENCY_SUB_BITS;
+        return (size_t)shift * LATENCY_HALF + (size_t)(value >> shift);
+    }
+
+    /* 第 i 格能表示的最大值 */
+    static uint64_t highest(size_t i) {
+        if (i < (1u << LATENCY_SUB_BITS)) return i;
+        size_t shift = i / LATENCY_HALF - 1;
+        uint64_t m = i - shift * LATENCY_HALF;
+        return ((m + 1) << shift) - 1;
+    }
+};
+
+#endif
@@ -20,6 +20,12 @@
 #define llrb_set_red(node)  do {if (node) node->color = LLRB_RED;} while(0)
 #define llrb_set_black(node)  do {if (node) node->color = LLRB_BLACK;} while(0)
 
+/* 传给 shape() 的红节点判断 */
+struct llrb_red {
+    template <typename Node>
+    bool operator()(const Node *node) const { return llrb_is_red(node); }
+};
+
 
 template <typename keyType, typename valueType>
 class llrb_map : public bst_map<keyType, valueType> {
@@ -29,11 +35,17 @@ public:
     typedef typename base::link_type                link_type;
     typedef typename base::iterator                 iterator;
 
+    // 只重写了其中一个重载，其余重载要显式引入，否则会被隐藏
+    using base::insert;
+    using base::remove;
+
 
     virtual iterator insert(const keyType &key, const valueType &value) {
-        link_type n = new NODE(key, value);
+        link_type n = base::create_node(key, value);
         assert(n);
-        base::insert(n);
+        MAP_STAT(this, allocations, 1);
+        iterator itor = base::insert(n);
+        if (itor != n) return itor;     // 键已存在，n 已被释放
         llrb_fix_up_to_root(n);
         return iterator(n);
     }
@@ -49,6 +61,19 @@ public:
         return LLRB_TREE;
     }
 
+protected:
+    /* 红节点只能是左孩子，按 2-3 树建立；黑高取 floor(log2(n + 1)) */
+    virtual link_type link_sorted(link_type nodes, size_t n) {
+        size_t bh = 0;
+        for (size_t i = n + 1; i > 1; i >>= 1) bh++;
+        return __link_23(nodes, 0, n, bh);
+    }
+
+    /* 2-3 树的形状不是中点二分，不能分段并行连接 */
+    virtual bool halving_colors(size_t, size_t *) const {
+        return false;
+    }
+
 
 ///////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////
@@ -64,6 +89,7 @@ private:
      */
     link_type llrbtree_right_rotate(link_type y) {
         if (!y) return nullptr;
+        MAP_STAT(this, rotations, 1);
         link_type x = y->left;
         link_type T2 = x->right;
         link_type parent = y->parent;
@@ -91,6 +117,7 @@ private:
 
     link_type llrbtree_left_rotate(link_type x) {
         if (!x) return nullptr;
+        MAP_STAT(this, rotations, 1);
         link_type y = x->right;
         link_type T2 = y->left;
         link_type parent = x->parent;
@@ -119,6 +146,7 @@ private:
     // 相当于拆分父节点或合并兄弟节点，调整黑高
     void color_flip(link_type node) {
         if (node) {
+            MAP_STAT(this, recolors, 1 + (node->left != nullptr) + (node->right != nullptr));
             node->color = !(node->color);
             if (node->left) node->left->color = !(node->left->color);
             if (node->right) node->right->color = !(node->right->color);
@@ -135,6 +163,7 @@ private:
 
     link_type llrb_fix_up(link_type node) {
         if (nullptr == node) return nullptr;
+        MAP_STAT(this, fixups, 1);
         if (llrb_is_red(node->right)) 
             node = llrbtree_left_rotate(node);
         if (node->left && llrb_is_red(node->left) &&
@@ -177,7 +206,7 @@ private:
         
         // 已到达最右
         if (node->right == nullptr) {
-            delete node;
+            this->destroy_node(node);
             base::dec();
             return nullptr;
         }
@@ -220,7 +249,7 @@ private:
     link_type delete_min(link_type node) {
         // 已到达最左
         if (node->left == nullptr) {
-            delete node;
+            this->destroy_node(node);
             base::dec();
             return nullptr;
         }
@@ -236,7 +265,7 @@ private:
     }
 
     link_type delete_recursive(link_type node, const keyType &key) {
-        if (key < node->key) {
+        if (MAP_LESS(this, key, node->key)) {
             if (!llrb_is_red(node->left) && !llrb_is_red(node->left->left))
                 node = move_red_left(node);
             node->left = delete_recursive(node->left, key);
@@ -245,8 +274,8 @@ private:
         } else {
             if (llrb_is_red(node->left))
                 node = llrbtree_right_rotate(node);
-            if (key == node->key && node->right == nullptr) {
-                delete node;
+            if (MAP_EQUAL(this, key, node->key) && node->right == nullptr) {
+                this->destroy_node(node);
                 base::dec();
                 return nullptr;
             }
@@ -254,7 +283,7 @@ private:
                 node = move_red_right(node);
 
             
-            if (key == node->key) {
+            if (MAP_EQUAL(this, key, node->key)) {
                 link_type right_min = __node_base_first(node->right);
                 node->key = right_min->key;             // 替换后继的键值
                 node->value = right_min->value;
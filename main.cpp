@@ -11,6 +11,23 @@
 #include "avl_tree.hpp"
 #include "rb_tree.hpp"
 #include "llrb_tree.hpp"
+#include "veb_tree.hpp"
+#include "small_map.hpp"
+#include "flat_map.hpp"
+#include "mmap_tree.hpp"
+#include "serialize.hpp"
+#include "durable_map.hpp"
+#include "sharded_map.hpp"
+#include "rcu_map.hpp"
+#include "persistent_map.hpp"
+#include "concurrent_avl.hpp"
+#include "skiplist.hpp"
+#include "perf_counter.hpp"
+#include "latency.hpp"
+#include "workload.hpp"
+#include "memory_usage.hpp"
+
+#include <thread>
 
 #define COUNTS 20
 
@@ -95,9 +112,688 @@ static void test1() {
     delete x;
 }
 
+// compact 之后内容不变，且中序相邻的节点在内存中相邻
+template <typename Tree>
+static void test_compact(Tree) {
+    const size_t counts = 100000;
+    base_type *tree = new Tree();
+    size_t *nums = get_rand_array1(counts);
+
+    for (size_t i = 0; i < counts; i++)
+        tree->insert(nums[i], i);
+    for (size_t i = 0; i < counts; i += 2)
+        tree->remove(nums[i]);
+
+    // 增量进行，中途插入不会让本轮作废，插在游标之前的节点留到下一轮
+    for (size_t i = 0; i < 10; i++) {
+        tree->compact_step(1000);
+        tree->insert(nums[i * 2], i);
+    }
+    while (!tree->compact_step(1000)) {}
+    tree->compact();
+
+    size_t n = 0;
+    base_type::link_type prev = nullptr;
+    for (auto i = tree->begin(); i != tree->end(); ++i, ++n) {
+        if (prev) {
+            assert(prev->key < i.node->key);
+            assert(prev + 1 == i.node);
+        }
+        prev = i.node;
+    }
+    assert(n == tree->size);
+    for (size_t i = 1; i < counts; i += 2)
+        assert(tree->find(nums[i]) && tree->find(nums[i])->value == i);
+
+    tree->compact();
+    for (size_t i = 0; i < counts; i++)
+        if (tree->find(nums[i])) tree->remove(nums[i]);
+    assert(tree->empty());
+
+    // 写入不断时，每一步之间都有插入和删除，这一轮也能走完，arena 的块数有界
+    for (size_t i = 0; i < counts; i++)
+        tree->insert(nums[i], i);
+    size_t step = 0;
+    do {
+        size_t k = (step * 7 + 3) % counts;         /* 删掉再插回来，节点换成新分配的 */
+        tree->remove(nums[k]);
+        tree->insert(nums[k], step);
+        assert(tree->arena_count() <= 3);
+        step++;
+    } while (!tree->compact_step(100));
+    assert(tree->arena_count() <= 2);
+    for (size_t i = 0; i < counts; i++)
+        if (tree->find(nums[i])) tree->remove(nums[i]);
+    assert(tree->empty() && 0 == tree->arena_count());
+
+    printf("compact\t%s\tOK\n", tree->name());
+    drop_random_array(nums);
+    delete tree;
+}
+
+// save 之后 mmap 打开，查找和迭代结果与原树一致
+template <typename Tree>
+static void test_mmap(Tree) {
+    const size_t counts = 100000;
+    const char *path = "/tmp/bst_map_test.bin";
+    base_type *tree = new Tree();
+    mmap_map<size_t, size_t> file;
+    size_t *nums = get_rand_array1(counts);
+
+    for (size_t i = 0; i < counts; i += 2)
+        tree->insert(nums[i] * 2, i);
+    int rc = tree->save(path);
+    assert(0 == rc);
+    rc = file.open_mmap(path);
+    assert(0 == rc);
+    assert(file.size == tree->size);
+
+    auto r = file.begin();
+    for (auto i = tree->begin(); i != tree->end(); ++i, ++r)
+        assert(r->key == i.node->key && r->value == *i);
+    assert(r == file.end());
+
+    for (size_t i = 0; i < counts; i++) {
+        base_type::link_type node = tree->find(nums[i] * 2);
+        auto pos = file.find(nums[i] * 2);
+        assert((nullptr == node) == (nullptr == pos));
+        if (pos) assert(pos->value == node->value);
+
+        auto lb = file.lower_bound(nums[i] * 2 + 1);
+        if (lb != file.end()) assert(lb->key > nums[i] * 2);
+        if (lb != file.begin()) assert((lb - 1)->key <= nums[i] * 2);
+    }
+
+    // 改坏 count 时 open_mmap() 拒绝这个文件
+    typedef mmap_map<size_t, size_t>::record record;
+    record rec;
+    __tree_file_header hdr;
+    int fd = open(path, O_RDWR);
+    assert(fd >= 0);
+    ssize_t n = pread(fd, &hdr, sizeof(hdr), 0);
+    assert(sizeof(hdr) == n);
+    uint64_t count = hdr.count;
+    hdr.count = UINT64_MAX / sizeof(rec) + 2;
+    n = pwrite(fd, &hdr, sizeof(hdr), 0);
+    assert(sizeof(hdr) == n);
+    rc = file.open_mmap(path);
+    assert(-1 == rc);
+
+    // 孩子下标越界或连成环（根的左孩子指回根，右孩子的左孩子也指回根）时，
+    // 文件照常打开，查找只会提前结束：找不到，或者找到的仍是正确的值
+    hdr.count = count;
+    n = pwrite(fd, &hdr, sizeof(hdr), 0);
+    assert(sizeof(hdr) == n);
+    off_t at = sizeof(hdr) + (off_t)hdr.root * sizeof(rec);
+    n = pread(fd, &rec, sizeof(rec), at);
+    assert(sizeof(rec) == n);
+    uint32_t right = rec.right;
+    rec.left = hdr.root;
+    n = pwrite(fd, &rec, sizeof(rec), at);
+    assert(sizeof(rec) == n);
+    at = sizeof(hdr) + (off_t)right * sizeof(rec);
+    n = pread(fd, &rec, sizeof(rec), at);
+    assert(sizeof(rec) == n);
+    rec.left = hdr.root;
+    rec.right = (uint32_t)count;
+    n = pwrite(fd, &rec, sizeof(rec), at);
+    assert(sizeof(rec) == n);
+    close(fd);
+    rc = file.open_mmap(path);
+    assert(0 == rc);
+    for (size_t i = 0; i < counts; i++) {
+        const record *pos = file.find(nums[i] * 2);
+        assert(nullptr == pos || (pos->key == nums[i] * 2 && tree->find(pos->key)->value == pos->value));
+        auto lb = file.lower_bound(nums[i] * 2);
+        assert(lb == file.end() || lb->key >= nums[i] * 2);
+        (void)pos;
+        (void)lb;
+    }
+    (void)n;
+    (void)rc;
+
+    printf("mmap\t%s\tOK\n", tree->name());
+    unlink(path);
+    drop_random_array(nums);
+    delete tree;
+}
+
+// 流式保存后批量加载，加载出的树可以继续增删
+template <typename Tree>
+static void test_stream(Tree) {
+    const size_t counts = 100000;
+    const char *path = "/tmp/bst_map_stream.bin";
+    base_type *tree = new Tree();
+    base_type *load = new Tree();
+    size_t *nums = get_rand_array1(counts);
+    stream_stats stats;
+
+    for (size_t i = 0; i < counts; i++)
+        tree->insert(nums[i], i);
+    int rc = stream_save(*tree, path, STREAM_VARINT, &stats);
+    assert(0 == rc);
+    rc = stream_load(*load, path, &stats);
+    assert(0 == rc);
+    assert(load->size == counts);
+
+    auto j = load->begin();
+    for (auto i = tree->begin(); i != tree->end(); ++i, ++j)
+        assert(i.node->key == j.node->key && *i == *j);
+
+    for (size_t i = 0; i < counts; i += 2)
+        load->remove(nums[i]);
+    for (size_t i = 0; i < counts; i += 2)
+        load->insert(nums[i] + counts, i);
+    for (size_t i = 0; i < counts; i++)
+        assert(load->find(nums[i] + (i % 2 ? 0 : counts))->value == i);
+
+    // 头部的 count 是伪造的：远超文件大小时在分配之前拒绝，只多一条时读到末尾出错，两种都留下空树
+    __stream_header hdr;
+    int fd = open(path, O_RDWR);
+    assert(fd >= 0);
+    ssize_t n = pread(fd, &hdr, sizeof(hdr), 0);
+    assert(sizeof(hdr) == n);
+    for (uint64_t count : {(uint64_t)1 << 60, (uint64_t)counts + 1}) {
+        hdr.count = count;
+        n = pwrite(fd, &hdr, sizeof(hdr), 0);
+        assert(sizeof(hdr) == n);
+        rc = stream_load(*load, path);
+        assert(-1 == rc && load->empty());
+    }
+    close(fd);
+    (void)n;
+    (void)rc;
+
+    printf("stream\t%s\t%.1f MB/s\n", tree->name(), stats.mb_per_second());
+    unlink(path);
+    drop_random_array(nums);
+    delete tree;
+    delete load;
+}
+
+template <typename Node>
+static bool same_shape(const Node *a, const Node *b) {
+    if (!a || !b) return a == b;
+    return a->key == b->key && a->value == b->value && a->color == b->color &&
+           same_shape(a->left, b->left) && same_shape(a->right, b->right);
+}
+
+// 带重复键的乱序输入并行建树，与逐个插入的内容一致，与 assign_sorted() 的形状、颜色/高度一致
+template <typename Tree>
+static void test_parallel_build(Tree) {
+    const size_t counts = 100000;
+    size_t *nums = get_rand_array1(counts);
+    size_t *keys = new size_t[counts];
+    for (size_t i = 0; i < counts; i++)
+        keys[i] = nums[i] % (counts / 3);
+
+    Tree ref, seq;
+    for (size_t i = 0; i < counts; i++)
+        ref.insert(keys[i], nums[i]);
+    auto it = ref.begin();
+    seq.assign_sorted(ref.size, [&it](size_t &key, size_t &value) {
+        key = it.node->key;
+        value = *it;
+        ++it;
+        return true;
+    });
+
+    for (size_t threads : {1, 3, 8}) {
+        Tree tree;
+        bool built = tree.assign_parallel(keys, nums, counts, threads);
+        assert(built);
+        (void)built;
+        assert(tree.size == ref.size && same_shape(tree.root, seq.root));
+        for (size_t i = 0; i < counts; i += 2)
+            if (tree.find(keys[i])) tree.remove(keys[i]);   /* 重复的键只删一次 */
+        for (size_t i = 0; i < counts; i += 2)
+            assert(nullptr == tree.find(keys[i]));
+    }
+
+    printf("parallel build\t%s\t%zu unique of %zu\n", ref.name(), ref.size, counts);
+    delete[] keys;
+    drop_random_array(nums);
+}
+
+// 写日志、中途写快照，再模拟日志尾部写坏，重新打开后内容不变
+static void test_durable() {
+    const size_t counts = 100000;
+    const char *path = "/tmp/bst_map_durable";
+    std::string snap = std::string(path) + ".snap", log = std::string(path) + ".log";
+    size_t *nums = get_rand_array1(counts);
+    unlink(snap.c_str());
+    unlink(log.c_str());
+
+    {
+        durable_map<size_t, size_t> db;
+        int rc = db.open(path, 1024, counts / 3);
+        assert(0 == rc);
+        for (size_t i = 0; i < counts; i++) {
+            rc = db.insert(nums[i], i);
+            assert(0 == rc);
+        }
+        for (size_t i = 0; i < counts; i += 2) {
+            rc = db.remove(nums[i]);
+            assert(0 == rc);
+        }
+        for (size_t i = 0; i < counts; i += 4) {
+            rc = db.insert(nums[i], i + counts);
+            assert(0 == rc);
+        }
+        (void)rc;
+    }
+
+    int fd = open(log.c_str(), O_WRONLY | O_APPEND);
+    assert(fd >= 0);
+    ssize_t n = write(fd, "torn!", 5);
+    assert(5 == n);
+    (void)n;
+    close(fd);
+
+    durable_map<size_t, size_t> db;
+    stream_stats stats;
+    int rc = db.open(path, 1024, 0, &stats);
+    assert(0 == rc);
+    (void)rc;
+    assert(db.tree.size == counts / 2 + counts / 4);
+    for (size_t i = 0; i < counts; i++) {
+        auto pos = db.find(nums[i]);
+        if (i % 4 == 0)
+            assert(pos && pos->value == i + counts);
+        else if (i % 2 == 0)
+            assert(nullptr == pos);
+        else
+            assert(pos && pos->value == i);
+    }
+
+    printf("durable\t%s\t%zu records in %.3f s\n", db.tree.name(), stats.records, stats.seconds);
+    rc = db.close();
+    assert(0 == rc);
+    unlink(snap.c_str());
+    unlink(log.c_str());
+    drop_random_array(nums);
+}
+
+// 多个线程并发增删查，结束后有序视图应当与单线程结果一致
+template <typename Map>
+static void test_sharded(Map &map) {
+    const size_t counts = 100000, threads = 4;
+    size_t *nums = get_rand_array1(counts);
+    std::vector<std::thread> pool;
+
+    for (size_t t = 0; t < threads; t++)
+        pool.emplace_back([&map, nums, t]() {
+            size_t value;
+            for (size_t i = t; i < counts; i += threads)
+                map.insert(nums[i], i);
+            for (size_t i = t; i < counts; i += threads) {
+                bool found = map.find(nums[i], &value);
+                assert(found && value == i);
+                if (i % 3 == 0) {
+                    bool removed = map.remove(nums[i]);
+                    assert(removed);
+                    (void)removed;
+                }
+                (void)found;
+            }
+        });
+    for (auto &t : pool) t.join();
+
+    assert(map.size() == counts - (counts + 2) / 3);
+    size_t n = 0, prev = 0;
+    auto view = map.ordered();
+    for (auto i = view.begin(); i != view.end(); ++i, ++n) {
+        assert(0 == n || prev < i.key());
+        assert(*i % 3 != 0 && nums[*i] == i.key());
+        prev = i.key();
+    }
+    assert(n == map.size());
+
+    printf("sharded\t%s\t%zu shards OK\n", map.name(), map.shard_count());
+    drop_random_array(nums);
+}
+
+// 写者反复增删奇数键，读者同时查偶数键（始终存在）并做有序扫描
+static void test_rcu() {
+    const size_t counts = 20000, readers = 3, rounds = 20;
+    rcu_rbt_map<size_t, size_t> map;
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> pool;
+
+    for (size_t i = 0; i < counts; i += 2)
+        map.insert(i, 2 * i);
+
+    for (size_t t = 0; t < readers; t++)
+        pool.emplace_back([&map, &stop, t]() {
+            size_t seed = t + 1, value = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+                size_t key = (seed >> 33) % counts & ~(size_t)1;
+                bool found = map.lookup(key, &value);
+                assert(found && value == 2 * key);
+                (void)found;
+
+                size_t prev = 0, evens = 0;
+                bool first = true;
+                map.scan([&](size_t k, size_t v) {
+                    assert((first || prev < k) && v == 2 * k);
+                    evens += k % 2 == 0;
+                    prev = k;
+                    first = false;
+                });
+                assert(evens == counts / 2);
+            }
+        });
+
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 1; i < counts; i += 2)
+            map.insert(i, 2 * i);
+        for (size_t i = 1; i < counts; i += 2)
+            map.remove(i);
+    }
+    stop = true;
+    for (auto &t : pool) t.join();
+
+    assert(map.size == counts / 2);
+    printf("rcu\t%s\t%zu nodes waiting for reclaim\n", map.name(), map.retired());
+}
+
+// 快照之后继续增删，快照里看到的仍是拍下时的内容
+static void test_persistent() {
+    const size_t counts = 100000;
+    persistent_map<size_t, size_t> map;
+    size_t *nums = get_rand_array1(counts);
+
+    for (size_t i = 0; i < counts; i++)
+        map.insert(nums[i], i);
+    assert(0 == map.copies);
+
+    auto snap = map.snap();
+    bool removed;
+    for (size_t i = 0; i < counts; i += 2) {
+        removed = map.remove(nums[i]);
+        assert(removed);
+    }
+    for (size_t i = 1; i < counts; i += 2)
+        map.insert(nums[i], i + counts);
+    removed = map.remove(counts);
+    assert(!removed);
+    (void)removed;
+    assert(map.size == counts / 2 && snap.size() == counts);
+
+    size_t n = 0;
+    for (auto i = snap.begin(); i != snap.end(); ++i, ++n)
+        assert(i.key() == n && nums[*i] == n);
+    assert(n == counts);
+    for (size_t i = 0; i < counts; i++) {
+        assert(*snap.find(nums[i]) == i);
+        const size_t *value = map.find(nums[i]);
+        assert(i % 2 ? *value == i + counts : nullptr == value);
+    }
+
+    n = 0;
+    size_t prev = 0;
+    for (auto i = map.begin(); i != map.end(); ++i, ++n) {
+        assert(0 == n || prev < i.key());
+        prev = i.key();
+    }
+    assert(n == map.size);
+
+    printf("persistent\t%s\t%zu copies for %zu writes\n", map.name(), map.copies, counts);
+    drop_random_array(nums);
+}
+
+// 每个线程在自己的键段上反复插入删除，同时查找别人键段里不变的那一半
+template <typename Map>
+static void test_concurrent() {
+    const size_t threads = 4, span = 20000, rounds = 10;
+    Map map;
+    std::vector<std::thread> pool;
+
+    for (size_t i = 0; i < threads * span; i += 2)
+        map.insert(i, 2 * i);
+
+    for (size_t t = 0; t < threads; t++)
+        pool.emplace_back([&map, t, span, threads, rounds]() {
+            size_t seed = t + 1, value;
+            for (size_t r = 0; r < rounds; r++) {
+                bool ok;
+                for (size_t i = t * span + 1; i < (t + 1) * span; i += 2) {
+                    ok = map.insert(i, 2 * i);
+                    assert(ok);
+                    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+                    size_t key = (seed >> 33) % (threads * span) & ~(size_t)1;
+                    ok = map.find(key, &value);
+                    assert(ok && value == 2 * key);
+                }
+                for (size_t i = t * span + 1; i < (t + 1) * span; i += 2) {
+                    ok = map.insert(i, 3 * i);
+                    assert(!ok);
+                    ok = map.find(i, &value);
+                    assert(ok && value == 3 * i);
+                    ok = map.remove(i);
+                    assert(ok);
+                    ok = map.remove(i);
+                    assert(!ok);
+                }
+                (void)ok;
+            }
+        });
+    for (auto &t : pool) t.join();
+
+    size_t n = 0;
+    map.for_each([&](size_t k, size_t v) {
+        assert(k == 2 * n && v == 2 * k);
+        n++;
+    });
+    assert(n == threads * span / 2 && map.size() == n);
+    printf("concurrent\t%s\t%zu threads ok\n", map.name(), threads);
+}
+
+// 与 rbt_map 逐个比较有序遍历的结果
+static void test_skiplist() {
+    const size_t counts = 100000;
+    skiplist_map<size_t, size_t> list;
+    rbt_type tree;
+    size_t *nums = get_rand_array1(counts);
+
+    bool ok;
+    for (size_t i = 0; i < counts; i++) {
+        ok = list.insert(nums[i], i);
+        assert(ok);
+        tree.insert(nums[i], i);
+    }
+    for (size_t i = 0; i < counts; i += 3) {
+        ok = list.remove(nums[i]);
+        assert(ok);
+        ok = list.remove(nums[i]);
+        assert(!ok);
+        tree.remove(nums[i]);
+    }
+    ok = list.insert(nums[1], 0);
+    assert(!ok && list.size() == tree.size);
+    (void)ok;
+    tree.insert(nums[1], 0);
+
+    auto j = tree.begin();
+    for (auto i = list.begin(); i != list.end(); ++i, ++j)
+        assert(i.key() == j.node->key && *i == *j);
+    assert(j == tree.end());
+
+    printf("skiplist\t%s\t%.1f bytes/entry\n", list.name(), (double)list.memory() / list.size());
+    drop_random_array(nums);
+}
+
+// 检查 parent 指针与平衡条件，返回 avl 的高度或红黑树的黑高，不满足时返回 -1
+static long check_balance(base_type::link_type node, bool rb) {
+    if (nullptr == node) return 0;
+    if ((node->left && node->left->parent != node) || (node->right && node->right->parent != node))
+        return -1;
+    long l = check_balance(node->left, rb), r = check_balance(node->right, rb);
+    if (l < 0 || r < 0) return -1;
+    if (rb) {
+        if (l != r) return -1;
+        if (node->color == 1 && ((node->left && node->left->color == 1) ||
+                                 (node->right && node->right->color == 1)))
+            return -1;
+        return l + (node->color == 0);
+    }
+    if (l - r > 1 || r - l > 1 || (long)node->height != 1 + MAX(l, r)) return -1;
+    return node->height;
+}
+
+static long check_avl(base_type::link_type root) { return check_balance(root, false); }
+static long check_rbt(base_type::link_type root) { return check_balance(root, true); }
+
+// 乱序、带重复键和删除的批次与逐条修改的结果相同，并且仍然平衡；llrb 走逐条修改，不检查形状
+template <typename Tree>
+static void test_apply_batch(Tree, long (*balanced)(base_type::link_type)) {
+    const size_t counts = 100000;
+    size_t *nums = get_rand_array1(counts);
+
+    for (size_t threads : {1, 4}) {
+        Tree tree;
+        rbt_type ref;
+        for (size_t i = 0; i < counts; i += 2) {
+            tree.insert(nums[i], i);
+            ref.insert(nums[i], i);
+        }
+
+        for (size_t batch : {(size_t)10, counts / 10, counts, counts}) {
+            std::vector<typename Tree::update_type> updates;
+            for (size_t i = 0; i < batch; i++) {
+                size_t key = nums[rand() % counts];
+                updates.push_back({key, i, 0 == rand() % 3});
+            }
+            tree.apply_batch(updates, threads);
+            for (auto &u : updates) {
+                if (!u.erase)
+                    ref.insert(u.key, u.value);
+                else if (ref.find(u.key))
+                    ref.remove(u.key);
+            }
+
+            assert(tree.size == ref.size && (!balanced || balanced(tree.root) >= 0));
+            assert(!tree.root || nullptr == tree.root->parent);
+            auto j = ref.begin();
+            for (auto i = tree.begin(); i != tree.end(); ++i, ++j)
+                assert(i.node->key == j.node->key && *i == *j);
+        }
+
+        // 建在空树上，再全部删掉
+        std::vector<typename Tree::update_type> all;
+        for (auto i = ref.begin(); i != ref.end(); ++i)
+            all.push_back({i.node->key, 0, true});
+        tree.apply_batch(all, threads);
+        assert(tree.empty() && nullptr == tree.root);
+        for (auto &u : all) u.erase = false;
+        tree.apply_batch(all, threads);
+        assert(tree.size == ref.size && (!balanced || balanced(tree.root) >= 0));
+        for (size_t i = 0; i < counts; i++)
+            if (tree.find(nums[i])) tree.remove(nums[i]);
+        assert(tree.empty());
+    }
+
+    printf("apply batch\t%s\tok\n", Tree().name());
+    drop_random_array(nums);
+}
+
+// 每个 spawn 一个孩子、自己算另一个，n 小于 cutoff 时顺序计算
+static size_t task_fib(thread_pool &pool, size_t n, size_t cutoff) {
+    if (n < 2) return n;
+    if (n < cutoff) return task_fib(pool, n - 1, cutoff) + task_fib(pool, n - 2, cutoff);
+    size_t a, b;
+    task_group group(pool);
+    group.spawn([&]() { a = task_fib(pool, n - 1, cutoff); });
+    b = task_fib(pool, n - 2, cutoff);
+    group.sync();
+    return a + b;
+}
+
+// 所有者 push/take 与多个窃取者并发，每个元素恰好被取走一次；嵌套 fork/join 结果正确
+static void test_task_pool() {
+    const size_t counts = 200000, thieves = 3;
+    chase_lev_deque<size_t> deque;
+    std::vector<std::atomic<int> > seen(counts + 1);
+    std::atomic<bool> done(false);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thieves; t++)
+        threads.emplace_back([&]() {
+            size_t x;
+            while (!done.load() || !deque.empty())
+                if (deque.steal(x)) seen[x]++;
+        });
+    for (size_t i = 1; i <= counts; i++) {
+        deque.push(i);
+        size_t x;
+        if (i % 3 == 0 && deque.take(x)) seen[x]++;
+    }
+    size_t x;
+    while (deque.take(x)) seen[x]++;
+    done = true;
+    for (auto &t : threads) t.join();
+    for (size_t i = 1; i <= counts; i++)
+        assert(1 == seen[i]);
+
+    for (size_t workers : {1, 2, 4}) {
+        thread_pool pool(workers);
+        assert(6765 == task_fib(pool, 20, 0) && 832040 == task_fib(pool, 30, 12));
+        printf("task pool\t%zu workers\t%zu steals\n", workers, pool.steals());
+    }
+}
+
+// 多项式哈希的拼接满足结合律但不满足交换律，块的合并顺序错了结果就会不同
+struct hash_fold {
+    size_t h, p;
+};
+
+static hash_fold hash_concat(const hash_fold &a, const hash_fold &b) {
+    return hash_fold{a.h * b.p + b.h, a.p * b.p};
+}
+
+// 并行遍历与归约的结果与顺序 fold 一致，与线程数无关；sorted 时 bst 退化成链表
+template <typename Tree>
+static void test_parallel_reduce(Tree, bool sorted) {
+    const size_t counts = sorted ? 5000 : 100000;
+    size_t *nums = get_rand_array1(counts);
+    Tree tree;
+    for (size_t i = 0; i < counts; i++)
+        tree.insert(sorted ? i : nums[i], i);
+
+    auto map_fn = [](const size_t &key, size_t &value) { return hash_fold{key * 31 + value, 1000003}; };
+    hash_fold expect{0, 1};
+    size_t sum = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        expect = hash_concat(expect, map_fn(it.node->key, *it));
+        sum += *it;
+    }
+
+    for (size_t threads : {1, 3, 8}) {
+        thread_pool pool(threads);
+        hash_fold h = tree.parallel_reduce(hash_fold{0, 1}, map_fn, hash_concat, pool);
+        assert(h.h == expect.h && h.p == expect.p);
+
+        std::atomic<size_t> total(0), visits(0);
+        tree.parallel_for_each([&](const size_t &, size_t &value) {
+            total += value;
+            visits++;
+        }, pool);
+        assert(total == sum && visits == tree.size);
+    }
+    Tree empty;
+    assert(7 == empty.parallel_reduce(hash_fold{7, 1}, map_fn, hash_concat).h);
+
+    printf("parallel reduce\t%s\t%zu entries\n", tree.name(), tree.size);
+    drop_random_array(nums);
+}
+
 #define TEST_COUNTS  2000000ul  
 #define TYPE_COUNTS 4           
 
+/* 计时循环里 find() 的命中数写到这里，NDEBUG 下去掉 assert 后循环也不会被优化掉 */
+static volatile size_t find_sink;
+
 static void benchmark() {
     size_t i = 0;
     
@@ -110,33 +806,57 @@ static void benchmark() {
     size_t *nums = get_rand_array1(TEST_COUNTS);
     assert(nums);
 
+    /* 拿不到硬件计数器时只输出 clock() 的结果 */
+    perf_counters perf;
+    if (perf.available()) {
+        printf("#phase\tmap\tclock");
+        perf.print_header(stdout);
+        printf("\n");
+    } else
+        printf("# perf counters unavailable (%s), clock() only\n", perf.error());
+
     for (auto ptr : base) {
         clock_t tic, toc;
+        perf.start();
         tic = clock();
         for (i = 0; i < TEST_COUNTS; i++)
             ptr->insert(nums[i], nums[i]);
         toc = clock();
-        printf("insert\t%s\t%ld\n", ptr->name(), toc - tic);
+        perf.stop();
+        printf("insert\t%s\t%ld", ptr->name(), toc - tic);
+        perf.print(stdout, TEST_COUNTS);
+        printf("\n");
     }
 
     randomed(nums, TEST_COUNTS);
 
     for (auto ptr : base) {
         clock_t tic, toc;
+        size_t found = 0;
+        perf.start();
         tic = clock();
         for (i = 0; i < TEST_COUNTS; i++) 
-            ptr->find(nums[i]);
+            found += nullptr != ptr->find(nums[i]);
         toc = clock();
-        printf("find  \t%s\t%ld\n", ptr->name(), toc - tic);
+        perf.stop();
+        assert(TEST_COUNTS == found);
+        find_sink = found;
+        printf("find  \t%s\t%ld", ptr->name(), toc - tic);
+        perf.print(stdout, TEST_COUNTS);
+        printf("\n");
     }
 
     for (auto ptr : base) {
         clock_t tic, toc;
+        perf.start();
         tic = clock();
         for (i = 0; i < TEST_COUNTS; i++)
             ptr->remove(nums[i]);
         toc = clock();
-        printf("delete \t%s\t%ld\n", ptr->name(), toc - tic);
+        perf.stop();
+        printf("delete \t%s\t%ld", ptr->name(), toc - tic);
+        perf.print(stdout, TEST_COUNTS);
+        printf("\n");
     }
 
     for (auto ptr : base) assert(ptr->empty());
@@ -146,6 +866,297 @@ static void benchmark() {
 }
 
 
+// latency histogram
+/* 分位数与排序后的精确值相差不超过一格 */
+static void test_latency() {
+    const size_t n = 100000;
+    std::vector<uint64_t> values;
+    latency_histogram hist, half;
+    uint64_t seed = 88172645463325252ull;
+    for (size_t i = 0; i < n; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        uint64_t v = seed % 1000 + (i % 100 ? 0 : seed % 1000000);     /* 1% 的长尾 */
+        values.push_back(v);
+        hist.record(v);
+        if (i % 2) half.record(v);
+    }
+    std::sort(values.begin(), values.end());
+    assert(hist.count() == n && hist.max() == values.back() && hist.min() == values.front());
+    const double ps[] = {50, 90, 99, 99.9, 100};
+    for (double p : ps) {
+        uint64_t exact = values[(size_t)(p / 100.0 * n + 0.5) - 1], got = hist.percentile(p);
+        assert(got >= exact && got - exact <= exact / LATENCY_HALF + 1);
+    }
+
+    latency_histogram merged;
+    merged.merge(half);
+    merged.merge(half);
+    assert(merged.count() == half.count() * 2 && merged.percentile(99) == half.percentile(99));
+    printf("latency histogram test OK\n");
+}
+
+/**
+ * 逐次计时每个 insert/find/remove，输出各自的尾延迟（纳秒）。
+ * AVL 回溯到根、LLRB 整条路径的修复都会出现在 p99.9 和 max 里。
+ */
+static void latency_benchmark() {
+    base_type *base[TYPE_COUNTS] = {new base_type(), new avl_type(), new rbt_type(), new llrb_type()};
+    size_t *nums = get_rand_array1(TEST_COUNTS);
+    assert(nums);
+    char name[32];
+
+    latency_histogram::print_header(stdout);
+    for (auto ptr : base) {
+        latency_histogram hist;
+        for (size_t i = 0; i < TEST_COUNTS; i++) {
+            uint64_t tic = latency_now();
+            ptr->insert(nums[i], nums[i]);
+            hist.record(latency_now() - tic);
+        }
+        snprintf(name, sizeof(name), "insert %s", ptr->name());
+        hist.print(stdout, name);
+    }
+
+    randomed(nums, TEST_COUNTS);
+    for (auto ptr : base) {
+        latency_histogram hist;
+        size_t found = 0;
+        for (size_t i = 0; i < TEST_COUNTS; i++) {
+            uint64_t tic = latency_now();
+            found += nullptr != ptr->find(nums[i]);
+            hist.record(latency_now() - tic);
+        }
+        assert(TEST_COUNTS == found);
+        find_sink = found;
+        snprintf(name, sizeof(name), "find %s", ptr->name());
+        hist.print(stdout, name);
+    }
+
+    for (auto ptr : base) {
+        latency_histogram hist;
+        for (size_t i = 0; i < TEST_COUNTS; i++) {
+            uint64_t tic = latency_now();
+            ptr->remove(nums[i]);
+            hist.record(latency_now() - tic);
+        }
+        assert(ptr->empty());
+        snprintf(name, sizeof(name), "remove %s", ptr->name());
+        hist.print(stdout, name);
+    }
+
+    for (auto ptr : base) delete (ptr);
+    drop_random_array(nums);
+}
+
+
+// workload generator
+static void test_workload() {
+    const size_t n = 100000;
+    for (int d = 0; d < KEY_DISTS; d++) {
+        std::vector<uint64_t> a = make_keys((key_dist)d, n, 42), b = make_keys((key_dist)d, n, 42);
+        assert(a.size() == n && a == b);        /* 同一个种子得到同样的序列 */
+    }
+    std::vector<uint64_t> keys = make_keys(KEY_ASCENDING, n, 1);
+    assert(std::is_sorted(keys.begin(), keys.end()));
+    keys = make_keys(KEY_DESCENDING, n, 1);
+    assert(std::is_sorted(keys.rbegin(), keys.rend()));
+    keys = make_keys(KEY_NEARLY_SORTED, n, 1);
+    size_t moved = 0;
+    for (size_t i = 0; i < n; i++)
+        moved += keys[i] != i;
+    assert(moved > 0 && moved <= n / 50);       /* 每次交换最多挪动两个 */
+    std::sort(keys.begin(), keys.end());
+    assert(keys == make_keys(KEY_ASCENDING, n, 1));
+    keys = make_keys(KEY_CLUSTERED, n, 1);
+    for (size_t i = 1; i < n; i++)
+        assert(0 == i % CLUSTER_SIZE || keys[i] == keys[i - 1] + 1);
+    std::sort(keys.begin(), keys.end());
+    assert(std::unique(keys.begin(), keys.end()) == keys.end());
+
+    /* Zipfian：最热的名次占 1/zeta(n)，约 8% */
+    keys = make_keys(KEY_ZIPF, n, 1);
+    size_t top = std::count(keys.begin(), keys.end(), mix64(0));
+    assert(top > n / 20 && top < n / 8);
+    assert(make_string_keys(3, 1)[2].size() == 20);
+
+    const size_t records = 10000, ops = 100000;
+    for (char w = 'A'; w <= 'F'; w++) {
+        ycsb_workload gen(w, records, 7);
+        size_t counts[5] = {0};
+        for (size_t i = 0; i < ops; i++) {
+            ycsb_op op = gen.next();
+            counts[op.type]++;
+            if (YCSB_SCAN == op.type) assert(op.scan >= 1 && op.scan <= YCSB_MAX_SCAN);
+        }
+        assert(gen.records() == records + counts[YCSB_INSERT]);
+        size_t reads = counts[YCSB_READ], writes = counts[YCSB_UPDATE] + counts[YCSB_INSERT] + counts[YCSB_RMW];
+        if ('C' == w) assert(reads == ops);
+        if ('A' == w || 'F' == w) assert(writes > ops * 45 / 100 && writes < ops * 55 / 100);
+        if ('B' == w || 'D' == w) assert(writes > ops * 3 / 100 && writes < ops * 7 / 100);
+        if ('E' == w) assert(counts[YCSB_SCAN] > ops * 9 / 10);
+        printf("ycsb %c\tread %zu\tupdate %zu\tinsert %zu\tscan %zu\trmw %zu\n", w,
+               counts[YCSB_READ], counts[YCSB_UPDATE], counts[YCSB_INSERT], counts[YCSB_SCAN], counts[YCSB_RMW]);
+    }
+    printf("workload test OK\n");
+}
+
+// memory_usage()：分项的精确值，以及各引擎在同样的键上每个元素占多少字节
+static void test_memory() {
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+    for (size_t n = 1; n < 4096; n++) {
+        void *p = malloc(n);
+        assert(malloc_usable_size(p) + MALLOC_HEADER == malloc_chunk(n));
+        free(p);
+    }
+#endif
+    const size_t counts = 1000000, node = sizeof(rbt_type::NODE);
+    size_t *nums = get_rand_array1(counts);
+
+    rbt_type tree;
+    for (size_t i = 0; i < counts; i++)
+        tree.insert(nums[i], i);
+    map_memory m = tree.memory_usage();
+    assert(m.nodes == counts * node && 0 == m.slack);
+    assert(m.overhead == counts * malloc_overhead(node));
+    tree.compact();                         /* 整棵树搬进一块 arena，只剩一份块头 */
+    m = tree.memory_usage();
+    assert(m.nodes == counts * node && 0 == m.slack);
+    assert(m.overhead == malloc_overhead(counts * node));
+    for (size_t i = 0; i < counts; i += 2)
+        tree.remove(nums[i]);
+    m = tree.memory_usage();                /* 空出的槽位在 arena 整块释放之前都是 slack */
+    assert(m.nodes == counts / 2 * node && m.slack == counts / 2 * node);
+
+    flat_map<size_t, size_t> flat;
+    for (size_t i = 0; i < counts; i++)
+        flat.insert(nums[i], i);
+    m = flat.memory_usage();
+    assert(m.nodes == counts * sizeof(flat_map<size_t, size_t>::entry));
+
+    small_map<size_t, size_t> small;
+    small.insert(1, 1);
+    m = small.memory_usage();
+    assert(m.nodes == 2 * sizeof(size_t) && 0 == m.overhead && m.total() == sizeof(small));
+
+    base_type bst;
+    avl_type avl;
+    rbt_type rbt;
+    llrb_type llrb;
+    persistent_map<size_t, size_t> persistent;
+    concurrent_avl_map<size_t, size_t> cavl;
+    skiplist_map<size_t, size_t> list;
+    sharded_map<size_t, size_t> sharded;
+    for (size_t i = 0; i < counts; i++) {
+        bst.insert(nums[i], i);
+        avl.insert(nums[i], i);
+        rbt.insert(nums[i], i);
+        llrb.insert(nums[i], i);
+        persistent.insert(nums[i], i);
+        cavl.insert(nums[i], i);
+        list.insert(nums[i], i);
+        sharded.insert(nums[i], i);
+    }
+    veb_map<size_t, size_t> veb(avl);
+
+    map_memory::print_header(stdout);
+    bst.memory_usage().print(stdout, bst.name(), counts);
+    avl.memory_usage().print(stdout, avl.name(), counts);
+    rbt.memory_usage().print(stdout, rbt.name(), counts);
+    llrb.memory_usage().print(stdout, llrb.name(), counts);
+    rbt.compact();
+    rbt.memory_usage().print(stdout, "rbt+arena", counts);
+    veb.memory_usage().print(stdout, veb.name(), counts);
+    flat.memory_usage().print(stdout, flat.name(), counts);
+    persistent.memory_usage().print(stdout, persistent.name(), counts);
+    cavl.memory_usage().print(stdout, cavl.name(), counts);
+    list.memory_usage().print(stdout, list.name(), counts);
+    sharded.memory_usage().print(stdout, sharded.name(), counts);
+    drop_random_array(nums);
+    printf("memory test OK\n");
+}
+
+// 递归求各层节点数，与 shape() 的迭代结果对照
+static void depth_recursive(base_type::link_type node, size_t d, std::vector<size_t> &depth) {
+    if (nullptr == node) return;
+    if (d == depth.size()) depth.push_back(0);
+    depth[d]++;
+    depth_recursive(node->left, d + 1, depth);
+    depth_recursive(node->right, d + 1, depth);
+}
+
+template <typename Tree, typename IsRed>
+static void test_shape(Tree, IsRed is_red, long (*balanced)(base_type::link_type)) {
+    const bool colored = !std::is_same<IsRed, shape_no_color>::value;
+    const size_t counts = 100000;
+    Tree tree;
+    size_t *nums = get_rand_array1(counts);
+    for (size_t i = 0; i < counts; i++)
+        tree.insert(nums[i], i);
+    for (size_t i = 0; i < counts; i += 3)
+        tree.remove(nums[i]);
+
+    tree_shape s = shape(tree, is_red);
+    std::vector<size_t> depth;
+    depth_recursive(tree.root, 0, depth);
+    assert(s.depth == depth && s.height == depth.size() && s.nodes == tree.size);
+    size_t path = 0;
+    for (size_t d = 0; d < depth.size(); d++)
+        path += depth[d] * (d + 1);
+    assert(s.path == path);
+    if (colored) assert(s.black_height > 0 && s.red > 0);
+    if (check_rbt == balanced) assert(s.black_height == balanced(tree.root));
+    if (check_avl == balanced) assert((long)s.height == balanced(tree.root));
+
+    /* 子树：只统计 root 之下 */
+    tree_shape left = shape(tree.root->left, is_red);
+    assert(left.nodes + shape(tree.root->right, is_red).nodes + 1 == s.nodes);
+    assert(left.height < s.height);
+    s.print(stdout, tree.name());
+    drop_random_array(nums);
+}
+
+// 顺序插入让 bst 退化成链表，shape() 不递归，不受深度限制
+static void test_shape_chain() {
+    const size_t counts = 20000;
+    base_type tree;
+    for (size_t i = 0; i < counts; i++)
+        tree.insert(i, i);
+    tree_shape s = shape(tree);
+    assert(s.height == counts && s.path == counts * (counts + 1) / 2);
+    assert(0 == s.red && 0 == s.black_height);
+    printf("chain\t%zu\t%zu\t%.2f\n", s.nodes, s.height, s.avg_path());
+}
+
+// 各引擎在不同键分布下的形状与查找耗时
+static void shape_report() {
+    const size_t counts = 2000000;
+    const key_dist dists[] = {KEY_UNIFORM, KEY_ASCENDING, KEY_CLUSTERED};
+    base_type *trees[] = {new avl_type(), new rbt_type(), new llrb_type()};
+    char name[64];
+    tree_shape::print_header(stdout);
+    for (key_dist dist : dists) {
+        std::vector<uint64_t> keys = make_keys(dist, counts, 1);
+        for (int t = 0; t < 3; t++) {
+            base_type *tree = trees[t];
+            tree->clear();
+            for (auto k : keys) tree->insert(k, k);
+            uint64_t tic = latency_now();
+            size_t found = 0;
+            for (auto k : keys) found += nullptr != tree->find(k);
+            double ns = (double)(latency_now() - tic) / counts;
+            assert(found == counts);
+            find_sink = found;
+            snprintf(name, sizeof(name), "%s/%s %.0fns/find", tree->name(), KEY_DIST_NAMES[dist], ns);
+            tree_shape s = 0 == t ? shape(tree->root) :
+                           1 == t ? shape(tree->root, rbt_red()) : shape(tree->root, llrb_red());
+            s.print(stdout, name);
+        }
+    }
+    for (auto tree : trees) delete tree;
+}
+
 int main() {
 
     #define TEST_ALL        0
@@ -170,5 +1181,92 @@ int main() {
     if (TEST_ALL || 6 == TEST_ITERM)
         benchmark();
 
+    if (TEST_ALL || 7 == TEST_ITERM) {
+        test_compact(base_type());
+        test_compact(avl_type());
+        test_compact(rbt_type());
+        test_compact(llrb_type());
+    }
+
+    if (TEST_ALL || 8 == TEST_ITERM) {
+        test_mmap(base_type());
+        test_mmap(avl_type());
+        test_mmap(rbt_type());
+        test_mmap(llrb_type());
+    }
+
+    if (TEST_ALL || 9 == TEST_ITERM) {
+        test_stream(base_type());
+        test_stream(avl_type());
+        test_stream(rbt_type());
+        test_stream(llrb_type());
+    }
+
+    if (TEST_ALL || 10 == TEST_ITERM)
+        test_durable();
+
+    if (TEST_ALL || 11 == TEST_ITERM) {
+        sharded_map<size_t, size_t> hashed;
+        sharded_map<size_t, size_t, avl_type> ranged({25000, 50000, 75000});
+        test_sharded(hashed);
+        test_sharded(ranged);
+    }
+
+    if (TEST_ALL || 12 == TEST_ITERM)
+        test_rcu();
+
+    if (TEST_ALL || 13 == TEST_ITERM)
+        test_persistent();
+
+    if (TEST_ALL || 14 == TEST_ITERM)
+        test_concurrent<concurrent_avl_map<size_t, size_t>>();
+
+    if (TEST_ALL || 15 == TEST_ITERM) {
+        test_concurrent<skiplist_map<size_t, size_t>>();
+        test_skiplist();
+    }
+
+    if (TEST_ALL || 16 == TEST_ITERM) {
+        test_parallel_build(avl_type());
+        test_parallel_build(rbt_type());
+        test_parallel_build(llrb_type());
+    }
+
+    if (TEST_ALL || 17 == TEST_ITERM) {
+        test_parallel_reduce(base_type(), true);
+        test_parallel_reduce(avl_type(), false);
+        test_parallel_reduce(rbt_type(), false);
+        test_parallel_reduce(llrb_type(), false);
+    }
+
+    if (TEST_ALL || 18 == TEST_ITERM) {
+        test_apply_batch(avl_type(), check_avl);
+        test_apply_batch(rbt_type(), check_rbt);
+        test_apply_batch(llrb_type(), nullptr);
+    }
+
+    if (TEST_ALL || 19 == TEST_ITERM)
+        test_task_pool();
+
+    if (TEST_ALL || 20 == TEST_ITERM) {
+        test_latency();
+        latency_benchmark();
+    }
+
+    if (TEST_ALL || 21 == TEST_ITERM)
+        test_workload();
+
+    if (TEST_ALL || 22 == TEST_ITERM)
+        test_memory();
+
+    if (TEST_ALL || 23 == TEST_ITERM) {
+        test_shape(base_type(), shape_no_color(), nullptr);
+        test_shape(avl_type(), shape_no_color(), check_avl);
+        test_shape(rbt_type(), rbt_red(), check_rbt);
+        test_shape(llrb_type(), llrb_red(), nullptr);
+        test_shape_chain();
+        shape_report();
+    }
+
     return 0;
 }
\ No newline at end of file
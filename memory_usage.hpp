@@ -0,0 +1,111 @@
+/**
+ * @file memory_usage.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief memory footprint breakdown shared by every map, plus process-level RSS / heap probes
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __MEMORY_USAGE_HPP__
+#define __MEMORY_USAGE_HPP__
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <malloc.h>
+#endif
+
+/* glibc ptmalloc（64 位）的分配粒度，用来估计每次 new 的真实占用 */
+#define MALLOC_HEADER       sizeof(size_t)      /* 块头中的 size 字段 */
+#define MALLOC_ALIGN        16
+#define MALLOC_MIN_CHUNK    32
+#define MALLOC_MMAP_MIN     (128 * 1024)        /* M_MMAP_THRESHOLD 的初值，更大的块直接 mmap */
+#define MALLOC_PAGE         4096
+
+/* 申请 bytes 字节时分配器实际占用的字节数 */
+inline size_t malloc_chunk(size_t bytes) {
+    if (0 == bytes) return 0;
+    if (bytes + MALLOC_HEADER >= MALLOC_MMAP_MIN)
+        return (bytes + 2 * MALLOC_HEADER + MALLOC_PAGE - 1) & ~(size_t)(MALLOC_PAGE - 1);
+    size_t chunk = (bytes + MALLOC_HEADER + MALLOC_ALIGN - 1) & ~(size_t)(MALLOC_ALIGN - 1);
+    return chunk < MALLOC_MIN_CHUNK ? MALLOC_MIN_CHUNK : chunk;
+}
+
+inline size_t malloc_overhead(size_t bytes) {
+    return malloc_chunk(bytes) - bytes;
+}
+
+/**
+ * 一个 map 占用的内存，按来源分成四项：
+ *   nodes     元素本身：节点或数组元素的 sizeof 之和，只算仍在 map 中的元素；
+ *   overhead  分配器的块头和对齐填充（按 malloc_chunk() 估计）；
+ *   slack     已经分配但没有存放元素的部分：arena 的空槽、vector 的余量、墓碑、
+ *             路由节点、等待 epoch 回收的节点；
+ *   metadata  map 对象本身和索引、日志缓冲、分片表等辅助结构。
+ * 各个 map 的 memory_usage() 都只读，并发结构在有并发修改时给出的是近似值。
+ */
+struct map_memory {
+    size_t nodes;
+    size_t overhead;
+    size_t slack;
+    size_t metadata;
+
+    map_memory() : nodes(0), overhead(0), slack(0), metadata(0) {}
+
+    size_t total() const {
+        return nodes + overhead + slack + metadata;
+    }
+
+    map_memory &operator+=(const map_memory &x) {
+        nodes += x.nodes;
+        overhead += x.overhead;
+        slack += x.slack;
+        metadata += x.metadata;
+        return *this;
+    }
+
+    /* name  entries  nodes  overhead  slack  metadata  total  bytes/entry */
+    void print(FILE *out, const char *name, size_t entries) const {
+        fprintf(out, "%s\t%zu\t%zu\t%zu\t%zu\t%zu\t%zu\t%.1f\n", name, entries,
+                nodes, overhead, slack, metadata, total(),
+                entries ? (double)total() / entries : 0.0);
+    }
+
+    static void print_header(FILE *out) {
+        fprintf(out, "#\tentries\tnodes\toverhead\tslack\tmetadata\ttotal\tbytes/entry\n");
+    }
+};
+
+/* 进程的常驻内存（/proc/self/statm 的 resident），读不到时返回 0 */
+inline size_t resident_bytes() {
+    size_t pages = 0;
+#ifdef __linux__
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (nullptr == fp) return 0;
+    if (1 != fscanf(fp, "%*s %zu", &pages)) pages = 0;
+    fclose(fp);
+    return pages * (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return pages;
+#endif
+}
+
+/* malloc 当前分配出去的字节数（mallinfo2，含块头），不支持时返回 0 */
+inline size_t heap_bytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+/* 把空闲内存还给系统，让随后的 resident_bytes() 差值只反映新的分配 */
+inline void heap_trim() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+#endif
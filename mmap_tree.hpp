@@ -0,0 +1,159 @@
+/**
+ * @file mmap_tree.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief read-only map served straight from a file written by bst_map::save()
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __MMAP_TREE_HPP__
+#define __MMAP_TREE_HPP__
+#include "bst.hpp"
+
+#include <sys/stat.h>
+
+const char *MMAP_TREE = "mmap";
+
+/**
+ * 文件以只读、MAP_SHARED 方式映射，不做任何反序列化：
+ * 查找沿 record 中的 left/right 下标下降，迭代顺序扫描 record。
+ * record 按中序存放，下标就是 rank，以 pos 为根的子树占据一段连续的下标，
+ * 下降时维护这段区间 [lo, hi)，越界的孩子（包括 TREE_FILE_NIL）结束查找：
+ * 损坏的文件最多让查找提前结束，不会越界读，也不会因为环而死循环，打开时不必逐条检查。
+ * 多个进程打开同一个文件时共享同一份 page cache。
+ */
+template <typename keyType, typename valueType>
+class mmap_map {
+public:
+    typedef keyType                                     key_type;
+    typedef valueType                                   value_type;
+    typedef __tree_file_record<keyType, valueType>      record;
+    typedef const record                                *iterator;
+
+    size_t  size;
+
+    mmap_map() : size(0), addr(nullptr), bytes(0), records(nullptr), root(TREE_FILE_NIL) {}
+    ~mmap_map() { close_mmap(); }
+
+    mmap_map(const mmap_map &) = delete;
+    mmap_map &operator=(const mmap_map &) = delete;
+
+    /* 成功返回 0；文件不存在、格式或键值类型不匹配时返回 -1 */
+    int open_mmap(const char *path) {
+        struct stat st;
+        close_mmap();
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return -1;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(__tree_file_header)) {
+            close(fd);
+            return -1;
+        }
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == p) return -1;
+
+        /* 先除后比，count 很大时不会回绕；下标是 uint32_t，count 还要小于 TREE_FILE_NIL */
+        const __tree_file_header *hdr = (const __tree_file_header *)p;
+        if (memcmp(hdr->magic, TREE_FILE_MAGIC, sizeof(hdr->magic)) ||
+            hdr->key_size != sizeof(keyType) ||
+            hdr->value_size != sizeof(valueType) ||
+            hdr->record_size != sizeof(record) ||
+            hdr->count > ((size_t)st.st_size - sizeof(*hdr)) / sizeof(record) ||
+            hdr->count >= TREE_FILE_NIL) {
+            munmap(p, st.st_size);
+            return -1;
+        }
+
+        addr = p;
+        bytes = st.st_size;
+        records = (const record *)(hdr + 1);
+        size = hdr->count;
+        root = hdr->root;
+        return 0;
+    }
+
+    void close_mmap() {
+        if (addr) munmap(addr, bytes);
+        addr = nullptr;
+        bytes = 0;
+        records = nullptr;
+        size = 0;
+        root = TREE_FILE_NIL;
+    }
+
+    const record *find(const keyType &key) const {
+        uint32_t pos = root, lo = 0, hi = (uint32_t)size;
+        while (lo <= pos && pos < hi) {
+            const record &r = records[pos];
+            if (key < r.key) {
+                hi = pos;
+                pos = r.left;
+            } else if (r.key < key) {
+                lo = pos + 1;
+                pos = r.right;
+            } else
+                return &r;
+        }
+        return nullptr;
+    }
+
+    /* 第一个不小于 key 的位置 */
+    iterator lower_bound(const keyType &key) const {
+        uint32_t pos = root, lo = 0, hi = (uint32_t)size;
+        iterator result = end();
+        while (lo <= pos && pos < hi) {
+            const record &r = records[pos];
+            if (r.key < key) {
+                lo = pos + 1;
+                pos = r.right;
+            } else {
+                result = &r;
+                hi = pos;
+                pos = r.left;
+            }
+        }
+        return result;
+    }
+
+    iterator begin() const { return records; }
+    iterator end() const { return records + size; }
+
+    bool empty() const { return 0 == size; }
+
+    /* 元素按下标连续存放，按下标均分，块之间仍是键的顺序 */
+    template <typename Fn>
+    void parallel_for_each(Fn fn, thread_pool &pool = thread_pool::instance()) const {
+        __array_for_each(pool, records, size, fn, [](const record &) { return true; });
+    }
+
+    template <typename T, typename Map, typename Reduce>
+    T parallel_reduce(T init, Map map_fn, Reduce reduce_fn, thread_pool &pool = thread_pool::instance()) const {
+        return __array_reduce(pool, records, size, init, map_fn, reduce_fn, [](const record &) { return true; });
+    }
+
+    /* 映射的是 page cache，可被多个进程共享；文件头是 metadata，末页的零头是 overhead */
+    map_memory memory_usage() const {
+        map_memory m;
+        m.nodes = size * sizeof(record);
+        m.metadata = sizeof(*this);
+        if (addr) {
+            m.metadata += sizeof(__tree_file_header);
+            m.slack = bytes - sizeof(__tree_file_header) - m.nodes;
+            m.overhead = (MALLOC_PAGE - bytes % MALLOC_PAGE) % MALLOC_PAGE;
+        }
+        return m;
+    }
+
+    const char *name() const {
+        return MMAP_TREE;
+    }
+
+private:
+    void          *addr;
+    size_t         bytes;
+    const record  *records;
+    uint32_t       root;
+};
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * @file parallel_sort.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief fork-join helper and a parallel stable merge sort used by bulk construction
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __PARALLEL_SORT_HPP__
+#define __PARALLEL_SORT_HPP__
+#include <stddef.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/* 在 threads 个线程上执行 fn(0) ... fn(threads - 1)，fn(0) 在调用者线程上执行，全部结束后返回 */
+template <typename Fn>
+void __parallel_run(size_t threads, Fn fn) {
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; t++)
+        pool.emplace_back(fn, t);
+    fn(0);
+    for (auto &th : pool) th.join();
+}
+
+/* [0, n) 均分成 parts 段，第 i 段的起点 */
+inline size_t __split_point(size_t n, size_t parts, size_t i) {
+    return n / parts * i + (n % parts < i ? n % parts : i);
+}
+
+/**
+ * 输出的前 k 个元素里有几个来自 a（merge path），相等时 a 在前，保证归并稳定。
+ */
+template <typename T, typename Less>
+size_t __co_rank(size_t k, const T *a, size_t na, const T *b, size_t nb, Less less) {
+    size_t lo = k > nb ? k - nb : 0, hi = k < na ? k : na;
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2, j = k - i;
+        if (j > 0 && !less(b[j - 1], a[i]))     /* a[i] 应排在 b[j - 1] 之前 */
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+/**
+ * 稳定排序 data[0, n)，tmp 至少 n 个元素：
+ *   - 均分成 threads 段，各段 std::stable_sort；
+ *   - 相邻的段两两归并，共 ceil(log2 threads) 轮，每一轮把全部输出均分给所有线程，
+ *     每个线程用 __co_rank() 二分找到自己那一段在两个输入中的起止位置，各自 std::merge。
+ * 跨度 O(n/p log n + log p (n/p + log n))。结果留在 data 中。
+ */
+template <typename T, typename Less>
+void parallel_stable_sort(T *data, T *tmp, size_t n, size_t threads, Less less) {
+    if (threads < 1) threads = 1;
+    if (threads > n) threads = n ? n : 1;
+
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= threads; i++)
+        bounds.push_back(__split_point(n, threads, i));
+
+    __parallel_run(threads, [&](size_t t) {
+        std::stable_sort(data + bounds[t], data + bounds[t + 1], less);
+    });
+
+    T *src = data, *dst = tmp;
+    while (bounds.size() > 2) {
+        std::vector<size_t> next;
+        for (size_t i = 0; i + 1 < bounds.size(); i += 2)
+            next.push_back(bounds[i]);
+        next.push_back(n);
+
+        __parallel_run(threads, [&](size_t t) {
+            size_t from = __split_point(n, threads, t), to = __split_point(n, threads, t + 1);
+            for (size_t i = 0; i + 1 < bounds.size() && from < to; i += 2) {
+                size_t lo = bounds[i], mid = i + 2 < bounds.size() ? bounds[i + 1] : n;
+                size_t hi = i + 2 < bounds.size() ? bounds[i + 2] : n;
+                if (to <= lo || hi <= from) continue;
+
+                /* 本线程负责输出的 [s, e)，落在这一对 [lo, mid) + [mid, hi) 的归并结果里 */
+                size_t s = std::max(from, lo) - lo, e = std::min(to, hi) - lo;
+                const T *a = src + lo, *b = src + mid;
+                size_t na = mid - lo, nb = hi - mid;
+                size_t ia = __co_rank(s, a, na, b, nb, less), ja = __co_rank(e, a, na, b, nb, less);
+                std::merge(a + ia, a + ja, b + (s - ia), b + (e - ja), dst + lo + s, less);
+            }
+        });
+        std::swap(src, dst);
+        bounds.swap(next);
+    }
+    if (src != data)
+        __parallel_run(threads, [&](size_t t) {
+            size_t from = __split_point(n, threads, t), to = __split_point(n, threads, t + 1);
+            std::copy(src + from, src + to, data + from);
+        });
+}
+
+#endif
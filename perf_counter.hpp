@@ -0,0 +1,149 @@
+/**
+ * @file perf_counter.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief hardware performance counters (perf_event_open) for the benchmark harness
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __PERF_COUNTER_HPP__
+#define __PERF_COUNTER_HPP__
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define PERF_EVENTS 6
+
+const char *const PERF_NAMES[PERF_EVENTS] = {
+    "cycles", "instr", "L1D-miss", "LLC-miss", "dTLB-miss", "br-miss"
+};
+
+/**
+ * 本线程（不含内核态）的 cycles、instructions、L1D/LLC/dTLB 读缺失和分支预测失败。
+ *   - 每个事件单独打开，打不开的事件（虚拟机里没有 PMU、perf_event_paranoid 太高、
+ *     非 Linux）标记为缺失，其余照常计数；一个都打不开时 available() 为 false，
+ *     print() 什么也不输出，调用者退回只用 clock() 计时；
+ *   - 事件多于硬件计数器时内核会分时复用，读数按 time_enabled / time_running 放大。
+ * start() 清零并开始计数，stop() 停止并读出这一段的值。
+ */
+class perf_counters {
+public:
+    perf_counters() : opened(0), err(nullptr) {
+        memset(values, 0, sizeof(values));
+        for (int i = 0; i < PERF_EVENTS; i++) fds[i] = -1;
+#ifdef __linux__
+        static const uint32_t types[PERF_EVENTS] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+            PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+        };
+        static const uint64_t configs[PERF_EVENTS] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            cache(PERF_COUNT_HW_CACHE_L1D),
+            cache(PERF_COUNT_HW_CACHE_LL),
+            cache(PERF_COUNT_HW_CACHE_DTLB),
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for (int i = 0; i < PERF_EVENTS; i++) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fds[i] >= 0)
+                opened++;
+            else if (nullptr == err)
+                err = strerror(errno);
+        }
+#else
+        err = "perf_event_open is Linux only";
+#endif
+    }
+
+    ~perf_counters() {
+#ifdef __linux__
+        for (int i = 0; i < PERF_EVENTS; i++)
+            if (fds[i] >= 0) close(fds[i]);
+#endif
+    }
+
+    perf_counters(const perf_counters &) = delete;
+    perf_counters &operator=(const perf_counters &) = delete;
+
+    bool available() const { return opened > 0; }
+    bool has(int i) const { return fds[i] >= 0; }
+
+    /* 第一个打不开的事件的原因 */
+    const char *error() const { return err ? err : "ok"; }
+
+    void start() {
+#ifdef __linux__
+        for (int i = 0; i < PERF_EVENTS; i++) {
+            if (fds[i] < 0) continue;
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void stop() {
+#ifdef __linux__
+        for (int i = 0; i < PERF_EVENTS; i++)
+            if (fds[i] >= 0) ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        for (int i = 0; i < PERF_EVENTS; i++) {
+            uint64_t data[3] = {0, 0, 0};      /* value, time_enabled, time_running */
+            values[i] = 0;
+            if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != (ssize_t)sizeof(data))
+                continue;
+            values[i] = data[2] ? (double)data[0] * data[1] / data[2] : 0;
+        }
+#endif
+    }
+
+    /* 上一次 start() 到 stop() 之间的计数 */
+    double value(int i) const { return values[i]; }
+
+    /* "\tcycles/op\tinstr/op..."，缺失的事件输出 "-" */
+    void print_header(FILE *out) const {
+        if (!available()) return;
+        for (int i = 0; i < PERF_EVENTS; i++)
+            fprintf(out, "\t%s/op", PERF_NAMES[i]);
+    }
+
+    void print(FILE *out, size_t ops) const {
+        if (!available()) return;
+        for (int i = 0; i < PERF_EVENTS; i++) {
+            if (has(i) && ops)
+                fprintf(out, "\t%.2f", values[i] / ops);
+            else
+                fprintf(out, "\t-");
+        }
+    }
+
+private:
+    int         fds[PERF_EVENTS];
+    int         opened;
+    const char *err;
+    double      values[PERF_EVENTS];
+
+#ifdef __linux__
+    static constexpr uint64_t cache(uint64_t id) {
+        return id | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+#endif
+};
+
+#endif
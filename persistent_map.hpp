@@ -0,0 +1,325 @@
+/**
+ * @file persistent_map.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief path-copying AVL map with reference-counted nodes and O(1) snapshots
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __PERSISTENT_MAP_HPP__
+#define __PERSISTENT_MAP_HPP__
+#include "bst.hpp"
+
+#include <atomic>
+
+#ifndef MAX
+#define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
+#endif
+
+const char *PERSISTENT_MAP = "pavl";
+
+/**
+ * 节点没有 parent 指针，带一个引用计数，计数等于指向它的指针个数（父节点、map 的根或快照的根）。
+ *   - snapshot() 只给根加一次引用，O(1)；
+ *   - insert/remove 自根向下，遇到计数为 1 的节点说明只有当前版本在用，直接原地修改；
+ *     遇到被共享的节点就复制一份（孩子的计数各加一），只复制 O(log n) 条路径，
+ *     没有快照时与普通 AVL 一样不复制任何节点；
+ *   - 快照里的节点永远不会被原地修改，快照可以交给其它线程读，读者不加锁、不阻塞写者，
+ *     最后一个引用消失的线程负责释放。
+ * insert/remove/snapshot() 只能在写者线程中调用；snapshot 对象可以在任意线程中拷贝和销毁。
+ */
+template <typename keyType, typename valueType>
+struct __pnode {
+    typedef __pnode *link_type;
+
+    __pnode(const keyType &k, const valueType &v)
+        : refs(1), left(nullptr), right(nullptr), height(1), key(k), value(v) {}
+
+    std::atomic<size_t> refs;
+    link_type   left;
+    link_type   right;
+    size_t      height;
+    keyType     key;
+    valueType   value;
+};
+
+template <typename keyType, typename valueType>
+class persistent_map {
+public:
+    typedef keyType                             key_type;
+    typedef valueType                           value_type;
+    typedef __pnode<keyType, valueType>         NODE;
+    typedef NODE                                *link_type;
+
+    /* 没有 parent 指针，中序迭代用一个栈记下尚未访问的祖先 */
+    struct iterator {
+        std::vector<link_type> stack;
+
+        iterator() {}
+        explicit iterator(link_type root) { push_left(root); }
+
+        const keyType &key() const { return stack.back()->key; }
+        const valueType &operator*() const { return stack.back()->value; }
+        const valueType *operator->() const { return &stack.back()->value; }
+
+        iterator& operator++() {
+            link_type node = stack.back();
+            stack.pop_back();
+            push_left(node->right);
+            return *this;
+        }
+
+        bool operator==(const iterator &x) const {
+            if (stack.empty() || x.stack.empty()) return stack.empty() == x.stack.empty();
+            return stack.back() == x.stack.back();
+        }
+        bool operator!=(const iterator &x) const {
+            return !(*this == x);
+        }
+
+    private:
+        void push_left(link_type node) {
+            for (; node; node = node->left) stack.push_back(node);
+        }
+    };
+
+    /* 某一时刻的只读视图，持有根的一个引用 */
+    class snapshot {
+    public:
+        snapshot() : root(nullptr), count(0) {}
+        snapshot(const snapshot &x) : root(acquire(x.root)), count(x.count) {}
+        ~snapshot() { release(root); }
+
+        snapshot &operator=(snapshot x) {
+            std::swap(root, x.root);
+            std::swap(count, x.count);
+            return *this;
+        }
+
+        const valueType *find(const keyType &key) const {
+            link_type node = persistent_map::search(root, key);
+            return node ? &node->value : nullptr;
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return 0 == count; }
+
+        iterator begin() const { return iterator(root); }
+        iterator end() const { return iterator(); }
+
+    private:
+        friend class persistent_map;
+        link_type root;
+        size_t    count;
+
+        snapshot(link_type r, size_t n) : root(acquire(r)), count(n) {}
+    };
+
+    size_t  size;
+    size_t  copies;     /* 因共享而复制的节点总数，用来衡量写放大 */
+
+    persistent_map() : size(0), copies(0), root(nullptr) {}
+    ~persistent_map() { release(root); }
+
+    persistent_map(const persistent_map &) = delete;
+    persistent_map &operator=(const persistent_map &) = delete;
+
+    void insert(const keyType &key, const valueType &value) {
+        if (insert_at(root, key, value)) size++;
+    }
+
+    /* 删除成功返回 true；键不存在时不复制任何节点 */
+    bool remove(const keyType &key) {
+        if (nullptr == search(root, key)) return false;
+        remove_at(root, key);
+        size--;
+        return true;
+    }
+
+    const valueType *find(const keyType &key) const {
+        link_type node = search(root, key);
+        return node ? &node->value : nullptr;
+    }
+
+    snapshot snap() const {
+        return snapshot(root, size);
+    }
+
+    void clear() {
+        release(root);
+        root = nullptr;
+        size = 0;
+    }
+
+    bool empty() const {
+        return 0 == size;
+    }
+
+    /* 迭代当前版本，下一次写入后失效 */
+    iterator begin() const { return iterator(root); }
+    iterator end() const { return iterator(); }
+
+    /* 只算当前版本的节点，仅被快照引用的旧节点不在其中 */
+    map_memory memory_usage() const {
+        map_memory m;
+        m.nodes = size * sizeof(NODE);
+        m.overhead = size * malloc_overhead(sizeof(NODE));
+        m.metadata = sizeof(*this);
+        return m;
+    }
+
+    const char *name() const {
+        return PERSISTENT_MAP;
+    }
+
+private:
+    link_type root;
+
+    static link_type acquire(link_type node) {
+        if (node) node->refs.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    /* 去掉一个引用，归零时释放并递归地去掉它对孩子的引用 */
+    static void release(link_type node) {
+        while (node && 1 == node->refs.fetch_sub(1, std::memory_order_acq_rel)) {
+            release(node->left);
+            link_type right = node->right;
+            delete node;
+            node = right;
+        }
+    }
+
+    static link_type search(link_type pos, const keyType &key) {
+        while (pos) {
+            if (key < pos->key)
+                pos = pos->left;
+            else if (pos->key < key)
+                pos = pos->right;
+            else
+                return pos;
+        }
+        return nullptr;
+    }
+
+    /* 保证 slot 指向的节点只被当前版本引用，必要时复制 */
+    void own(link_type &slot) {
+        link_type node = slot;
+        if (1 == node->refs.load(std::memory_order_acquire)) return;
+        link_type copy = new NODE(node->key, node->value);
+        copy->left = acquire(node->left);
+        copy->right = acquire(node->right);
+        copy->height = node->height;
+        release(node);
+        slot = copy;
+        copies++;
+    }
+
+    static size_t height(link_type node) {
+        return node ? node->height : 0;
+    }
+
+    static void update(link_type node) {
+        node->height = 1 + MAX(height(node->left), height(node->right));
+    }
+
+    /* 旋转只是交换指针，每个节点被指向的次数不变，计数无需调整 */
+    void rotate_right(link_type &slot) {
+        link_type y = slot;
+        own(y->left);
+        link_type x = y->left;
+        y->left = x->right;
+        x->right = y;
+        update(y);
+        update(x);
+        slot = x;
+    }
+
+    void rotate_left(link_type &slot) {
+        link_type x = slot;
+        own(x->right);
+        link_type y = x->right;
+        x->right = y->left;
+        y->left = x;
+        update(x);
+        update(y);
+        slot = y;
+    }
+
+    /* slot 已归当前版本所有 */
+    void rebalance(link_type &slot) {
+        link_type node = slot;
+        long diff = (long)height(node->left) - (long)height(node->right);
+        if (diff > 1) {
+            if (height(node->left->left) < height(node->left->right)) {
+                own(node->left);
+                rotate_left(node->left);
+            }
+            rotate_right(slot);
+        } else if (diff < -1) {
+            if (height(node->right->right) < height(node->right->left)) {
+                own(node->right);
+                rotate_right(node->right);
+            }
+            rotate_left(slot);
+        } else
+            update(node);
+    }
+
+    /* 新增返回 true，覆盖已有的值返回 false */
+    bool insert_at(link_type &slot, const keyType &key, const valueType &value) {
+        if (nullptr == slot) {
+            slot = new NODE(key, value);
+            return true;
+        }
+        own(slot);
+        link_type node = slot;
+        bool added;
+        if (key < node->key)
+            added = insert_at(node->left, key, value);
+        else if (node->key < key)
+            added = insert_at(node->right, key, value);
+        else {
+            node->value = value;
+            return false;
+        }
+        if (added) rebalance(slot);
+        return added;
+    }
+
+    /* key 一定存在 */
+    void remove_at(link_type &slot, const keyType &key) {
+        link_type node = slot;
+        if (key < node->key || node->key < key) {
+            own(slot);
+            node = slot;
+            remove_at(key < node->key ? node->left : node->right, key);
+        } else if (nullptr == node->left || nullptr == node->right) {
+            slot = acquire(node->left ? node->left : node->right);
+            release(node);
+            return;
+        } else {
+            own(slot);
+            node = slot;
+            remove_min(node->right, node->key, node->value);
+        }
+        rebalance(slot);
+    }
+
+    /* 摘下最小的节点，把它的键值交给 key/value */
+    void remove_min(link_type &slot, keyType &key, valueType &value) {
+        link_type node = slot;
+        if (nullptr == node->left) {
+            key = node->key;
+            value = node->value;
+            slot = acquire(node->right);
+            release(node);
+            return;
+        }
+        own(slot);
+        remove_min(slot->left, key, value);
+        rebalance(slot);
+    }
+};
+
+#endif
@@ -20,6 +20,12 @@
 #define rbt_set_red(node)    ((node)->color = RB_RED)
 #define rbt_set_black(node)  ((node)->color = RB_BLACK)
 
+/* 传给 shape() 的红节点判断 */
+struct rbt_red {
+    template <typename Node>
+    bool operator()(const Node *node) const { return rbt_is_red(node); }
+};
+
 template <typename keyType, typename valueType>
 class rbt_map : public bst_map<keyType, valueType> {
 public:
@@ -27,19 +33,23 @@ public:
     typedef typename base::link_type link_type;
     typedef typename base::iterator iterator;
 
+    // 只重写了其中一个重载，其余重载要显式引入，否则会被隐藏
+    using base::insert;
+    using base::remove;
+
     virtual iterator insert(link_type node) {
         link_type &root = base::getRoot();
         link_type *pos = &root;
         link_type parent = nullptr;
         while (*pos) {
             parent = *pos;
-            if (node->key < (*pos)->key)
+            if (MAP_LESS(this, node->key, (*pos)->key))
                 pos = &((*pos)->left);
-            else if (node->key > (*pos)->key)
+            else if (MAP_LESS(this, (*pos)->key, node->key))
                 pos = &((*pos)->right);
             else {
                 (*pos)->value = node->value;
-                delete node;
+                this->destroy_node(node);
                 return iterator(*pos);
             }
         }
@@ -58,7 +68,7 @@ public:
         if (nullptr == node) return itor;
         ++itor;
         _remove_replace(&root, node, &parent, &child, &color);
-        delete(node);
+        this->destroy_node(node);
         base::dec();
         if (color == RB_BLACK) 
             rbt_erase_fixup(&root, child, parent);
@@ -69,6 +79,72 @@ public:
         return RB_TREE;
     }
 
+protected:
+    /* 完美平衡的形状，最底层染红 */
+    virtual link_type link_sorted(link_type nodes, size_t n) {
+        size_t red_depth;
+        halving_colors(n, &red_depth);
+        return __link_halving(nodes, 0, n, 0, red_depth);
+    }
+
+    virtual bool halving_colors(size_t n, size_t *red_depth) const {
+        size_t height = 0;
+        for (size_t i = n; i; i >>= 1) height++;
+        *red_depth = height > 1 ? height - 1 : (size_t)-1;
+        return true;
+    }
+
+    /* join 的秩是黑高：根到空指针路径上黑节点的个数（含根，不含空指针），空树为 0 */
+    virtual bool join_rank(link_type root, size_t *rank) const {
+        *rank = 0;
+        for (; root; root = root->left)
+            if (rbt_is_black(root)) (*rank)++;
+        return true;
+    }
+
+    virtual size_t child_rank(link_type parent, size_t rank, link_type) const {
+        return rbt_is_black(parent) ? rank - 1 : rank;
+    }
+
+    /**
+     * Just Join for Parallel Ordered Sets 中的红黑树 join：黑高相等时以 k 为根，
+     * 两边都是黑根则 k 染红，否则染黑；黑高不等时沿较高一侧的边缘下降到黑高相等的黑节点，
+     * 以红色的 k 接上，回溯时遇到连续的两个红节点就旋转一次，最后根若是红且有红孩子则染黑。
+     */
+    virtual link_type join_node(link_type l, size_t rl, link_type k, link_type r, size_t rr, size_t *rank) {
+        if (rl > rr) {
+            link_type t = join_right(l, rl, k, r, rr);
+            *rank = rl;
+            if (rbt_is_red(t) && t->right && rbt_is_red(t->right)) {
+                rbt_set_black(t);
+                (*rank)++;
+            }
+            return t;
+        }
+        if (rr > rl) {
+            link_type t = join_left(l, rl, k, r, rr);
+            *rank = rr;
+            if (rbt_is_red(t) && t->left && rbt_is_red(t->left)) {
+                rbt_set_black(t);
+                (*rank)++;
+            }
+            return t;
+        }
+        base::__join_attach(l, k, r);
+        if (join_black(l) && join_black(r)) {
+            rbt_set_red(k);
+            *rank = rl;
+        } else {
+            rbt_set_black(k);
+            *rank = rl + 1;
+        }
+        return k;
+    }
+
+    virtual void join_finish(link_type root) {
+        rbt_set_black(root);
+    }
+
 
 ////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////
@@ -81,22 +157,24 @@ private:
         T1   T2     Left Rotation(x)     T2   T3
     */
     link_type rbtree_right_rotate(link_type y) {
+        MAP_STAT(this, rotations, 1);
         link_type x = y->left;
         link_type T2 = x->right;
         link_type parent = y->parent;
 
-        x->right = y;
-        y->parent = x;
-
-        y->left = T2;
+        /* 先改写 y->left 再让 x 指向 y，读者不会在 x、y 之间绕圈 */
+        rcu_assign_pointer(y->left, T2);
         if (T2) T2->parent = y;
 
+        rcu_assign_pointer(x->right, y);
+        y->parent = x;
+
         x->parent = parent;
         if (parent) {
             if (parent->left == y)
-                parent->left = x;
+                rcu_assign_pointer(parent->left, x);
             else
-                parent->right = x;
+                rcu_assign_pointer(parent->right, x);
         } else {
             base::setRoot(x);
         }
@@ -105,33 +183,75 @@ private:
     }
 
     link_type rbtree_left_rotate(link_type x) {
+        MAP_STAT(this, rotations, 1);
         link_type y = x->right;
         link_type T2 = y->left;
         link_type parent = x->parent;
 
-        y->left = x;
-        x->parent = y;
-
-        x->right = T2;
+        rcu_assign_pointer(x->right, T2);
         if (T2) T2->parent = x;
 
+        rcu_assign_pointer(y->left, x);
+        x->parent = y;
+
         y->parent = parent;
         if (parent) {
             if (parent->left == x)
-                parent->left = y;
+                rcu_assign_pointer(parent->left, y);
             else
-                parent->right = y;
+                rcu_assign_pointer(parent->right, y);
         } else {
             base::setRoot(y);
         }
         return y;
     }
 
+    /* 以下用于 join，作用在已经摘下的子树上，不碰 root，返回新的子树根 */
+    static bool join_black(link_type node) {
+        return nullptr == node || rbt_is_black(node);
+    }
+
+    static bool join_red(link_type node) {
+        return nullptr != node && rbt_is_red(node);
+    }
+
+    /* 黑高 rl > rr，返回的子树黑高仍为 rl，根可能是红色且有红孩子 */
+    static link_type join_right(link_type l, size_t rl, link_type k, link_type r, size_t rr) {
+        if (rl == rr && join_black(l)) {
+            rbt_set_red(k);
+            return base::__join_attach(l, k, r);
+        }
+        link_type t = base::__join_attach(l->left, l, join_right(l->right, rbt_is_black(l) ? rl - 1 : rl, k, r, rr));
+        if (rbt_is_black(t) && join_red(t->right) && join_red(t->right->right)) {
+            link_type y = t->right;
+            rbt_set_black(y->right);
+            base::__join_attach(t->left, t, y->left);
+            return base::__join_attach(t, y, y->right);
+        }
+        return t;
+    }
+
+    static link_type join_left(link_type l, size_t rl, link_type k, link_type r, size_t rr) {
+        if (rl == rr && join_black(r)) {
+            rbt_set_red(k);
+            return base::__join_attach(l, k, r);
+        }
+        link_type t = base::__join_attach(join_left(l, rl, k, r->left, rbt_is_black(r) ? rr - 1 : rr), r, r->right);
+        if (rbt_is_black(t) && join_red(t->left) && join_red(t->left->left)) {
+            link_type x = t->left;
+            rbt_set_black(x->left);
+            base::__join_attach(x->right, t, t->right);
+            return base::__join_attach(x->left, x, t);
+        }
+        return t;
+    }
+
     void rbt_rebalance(link_type node) {
         link_type parent, gparent;
         // node->color = RB_RED;
         while ((parent = node->parent) && rbt_is_red(parent)) {
             gparent = parent->parent;
+            MAP_STAT(this, fixups, 1);
 
             if (parent == gparent->left) {
                 link_type uncle = gparent->right;
@@ -140,6 +260,7 @@ private:
                     rbt_set_black(uncle);
                     rbt_set_black(parent);
                     rbt_set_red(gparent);
+                    MAP_STAT(this, recolors, 3);
                     node = gparent;
                     continue;
                 }
@@ -154,6 +275,7 @@ private:
                 /* case 3 */
                 rbt_set_black(parent);
                 rbt_set_red(gparent);
+                MAP_STAT(this, recolors, 2);
                 rbtree_right_rotate(gparent);
             } else {
                 link_type uncle = gparent->left;
@@ -161,6 +283,7 @@ private:
                     rbt_set_black(uncle);
                     rbt_set_black(parent);
                     rbt_set_red(gparent);
+                    MAP_STAT(this, recolors, 3);
                     node = gparent;
                     continue;
                 }
@@ -175,6 +298,7 @@ private:
 
                 rbt_set_black(parent);
                 rbt_set_red(gparent);
+                MAP_STAT(this, recolors, 2);
                 rbtree_left_rotate(gparent);
             }
         }
@@ -187,17 +311,20 @@ private:
                                 link_type parent) {
         link_type other;
         while ((!node || rbt_is_black(node)) && node != *root) {
+            MAP_STAT(this, fixups, 1);
             if (parent->left == node) {
                 other = parent->right;
                 if (rbt_is_red(other)) {
                     rbt_set_black(other);
                     rbt_set_red(parent);
+                    MAP_STAT(this, recolors, 2);
                     rbtree_left_rotate(parent);
                     other = parent->right;
                 }
                 if ((!other->left || rbt_is_black(other->left)) &&
                     (!other->right || rbt_is_black(other->right))) {
                     rbt_set_red(other);
+                    MAP_STAT(this, recolors, 1);
                     node = parent;
                     parent = node->parent;
                 } else {
@@ -205,11 +332,13 @@ private:
                         link_type o_left;
                         if ((o_left = other->left)) rbt_set_black(o_left);
                         rbt_set_red(other);
+                        MAP_STAT(this, recolors, 2);
                         rbtree_right_rotate(other);
                         other = parent->right;
                     }
                     other->color = parent->color;
                     rbt_set_black(parent);
+                    MAP_STAT(this, recolors, 3);
                     if (other->right) rbt_set_black(other->right);
                     rbtree_left_rotate(parent);
                     node = *root;
@@ -220,12 +349,14 @@ private:
                 if (rbt_is_red(other)) {
                     rbt_set_black(other);
                     rbt_set_red(parent);
+                    MAP_STAT(this, recolors, 2);
                     rbtree_right_rotate(parent);
                     other = parent->left;
                 }
                 if ((!other->left || rbt_is_black(other->left)) &&
                     (!other->right || rbt_is_black(other->right))) {
                     rbt_set_red(other);
+                    MAP_STAT(this, recolors, 1);
                     node = parent;
                     parent = node->parent;
                 } else {
@@ -233,11 +364,13 @@ private:
                         link_type o_right;
                         if ((o_right = other->right)) rbt_set_black(o_right);
                         rbt_set_red(other);
+                        MAP_STAT(this, recolors, 2);
                         rbtree_left_rotate(other);
                         other = parent->left;
                     }
                     other->color = parent->color;
                     rbt_set_black(parent);
+                    MAP_STAT(this, recolors, 3);
                     if (other->left) rbt_set_black(other->left);
                     rbtree_right_rotate(parent);
                     node = *root;
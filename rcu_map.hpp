@@ -0,0 +1,224 @@
+/**
+ * @file rcu_map.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief rbt_map with lock-less (seqlock) readers alongside a single writer
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __RCU_MAP_HPP__
+#define __RCU_MAP_HPP__
+#include "rb_tree.hpp"
+#include "epoch.hpp"
+
+#include <thread>
+
+const char *RCU_TREE = "rcu ";
+
+#define RCU_MAX_HOPS 128     /* 超过红黑树的最大可能深度，说明读到了变形中的树 */
+
+/**
+ * 一个写者线程照常 insert/remove，任意多个读者线程调用 lookup*()/scan()，读者不加锁，
+ * 但并不是 lock-free：seq 为奇数时读者让出 CPU 等写者改完，写者持续改动时读者可能反复重试。
+ *   - 写者只在真正改动结构时把 seq 改成奇数，改完再改回偶数（seqlock），
+ *     查找路径的搜索在这之外完成，奇数窗口很短；
+ *   - 子指针一律经 rcu_assign_pointer() 发布，读者用 acquire 读，最多走 RCU_MAX_HOPS 步，
+ *     旋转中途的形状不会让读者出界或死循环；
+ *   - 读者结束时 seq 没变才采用结果，否则重试，重试次数没有上限；
+ *   - 摘下的节点交给 epoch_domain，等摘下之前进来的读者都离开后才释放，
+ *     读者手里的指针始终指向有效内存。
+ * 读者拿到的是键值的拷贝，所以键值必须是平凡可拷贝的。
+ * compact()/assign_sorted() 等批量操作不在并发保护之内，只能在没有读者时调用。
+ */
+template <typename keyType, typename valueType>
+class rcu_rbt_map : public rbt_map<keyType, valueType> {
+public:
+    typedef rbt_map<keyType, valueType>         base;
+    typedef bst_map<keyType, valueType>         tree_type;
+    typedef typename base::link_type            link_type;
+    typedef typename base::iterator             iterator;
+
+    static_assert(std::is_trivially_copyable<keyType>::value &&
+                  std::is_trivially_copyable<valueType>::value,
+                  "seqlock readers copy keys and values");
+
+    using base::insert;
+    using base::remove;
+
+    rcu_rbt_map() : seq(0), domain(reclaim, this) {}
+
+    // 先在这里清空，此时 destroy_node() 仍是本类的版本，节点都经过 epoch 回收
+    ~rcu_rbt_map() {
+        this->clear();
+        domain.drain();
+    }
+
+    /* 写者接口：只能在一个线程中调用 */
+    virtual iterator insert(link_type node) {
+        link_type pos = tree_type::find(node->key);
+        if (pos) {
+            write_begin();
+            pos->value = node->value;
+            write_end();
+            tree_type::destroy_node(node);  /* 从未发布过，直接释放 */
+            return iterator(pos);
+        }
+        write_begin();
+        iterator itor = base::insert(node);
+        write_end();
+        return itor;
+    }
+
+    virtual iterator remove(link_type node) {
+        if (nullptr == node) return iterator(node);
+        write_begin();
+        iterator itor = base::remove(node);
+        write_end();
+        return itor;
+    }
+
+    /* 读者接口：可与写者并发调用 */
+    bool lookup(const keyType &key, valueType *value = nullptr) const {
+        return read([&](int &hops, keyType *, valueType *v) -> link_type {
+            link_type pos = load(this->root);
+            while (pos && ++hops <= RCU_MAX_HOPS) {
+                if (key < pos->key)
+                    pos = load(pos->left);
+                else if (pos->key < key)
+                    pos = load(pos->right);
+                else {
+                    *v = pos->value;
+                    return pos;
+                }
+            }
+            return nullptr;
+        }, nullptr, value);
+    }
+
+    /* 严格大于 key 的最小键 */
+    bool lookup_next(const keyType &key, keyType *next, valueType *value = nullptr) const {
+        return read([&](int &hops, keyType *k, valueType *v) -> link_type {
+            link_type pos = load(this->root), best = nullptr;
+            while (pos && ++hops <= RCU_MAX_HOPS) {
+                if (key < pos->key) {
+                    best = pos;
+                    pos = load(pos->left);
+                } else
+                    pos = load(pos->right);
+            }
+            if (best) {
+                *k = best->key;
+                *v = best->value;
+            }
+            return best;
+        }, next, value);
+    }
+
+    bool lookup_first(keyType *first, valueType *value = nullptr) const {
+        return read([&](int &hops, keyType *k, valueType *v) -> link_type {
+            link_type pos = load(this->root), best = nullptr;
+            while (pos && ++hops <= RCU_MAX_HOPS) {
+                best = pos;
+                pos = load(pos->left);
+            }
+            if (best) {
+                *k = best->key;
+                *v = best->value;
+            }
+            return best;
+        }, first, value);
+    }
+
+    /**
+     * 按键递增对每个元素调用 fn(key, value)，返回访问的个数。
+     * 每一步都是一次独立的 lookup_next()，不会拿到整体的快照，
+     * 但每个被访问的元素在那一刻确实存在，并且键严格递增、不重复。
+     */
+    template <typename Fn>
+    size_t scan(Fn fn) const {
+        keyType key = keyType();
+        valueType value = valueType();
+        size_t n = 0;
+        if (!lookup_first(&key, &value)) return 0;
+        do {
+            fn(key, value);
+            n++;
+        } while (lookup_next(key, &key, &value));
+        return n;
+    }
+
+    /* 等待 epoch 回收的节点数 */
+    size_t retired() {
+        return domain.pending();
+    }
+
+    /* 已摘下、等待读者离开的节点还占着内存，算作 slack，按单独 new 的节点估计 */
+    map_memory memory_usage() const {
+        map_memory m = tree_type::memory_usage();
+        size_t limbo = const_cast<epoch_domain &>(domain).pending();
+        m.slack += limbo * sizeof(typename tree_type::NODE);
+        m.overhead += limbo * malloc_overhead(sizeof(typename tree_type::NODE));
+        m.metadata += sizeof(*this) - sizeof(tree_type);
+        return m;
+    }
+
+    virtual const char *name() const {
+        return RCU_TREE;
+    }
+
+protected:
+    virtual void destroy_node(link_type node) {
+        domain.retire(node);
+    }
+
+    /* 批量 join 会把子树整个摘下再连回，读者可能走丢，apply_batch() 改为逐条经过上面的写者接口 */
+    virtual bool join_rank(link_type, size_t *) const {
+        return false;
+    }
+
+private:
+    std::atomic<unsigned>   seq;
+    epoch_domain            domain;
+
+    static void reclaim(void *ctx, void *ptr) {
+        static_cast<rcu_rbt_map *>(ctx)->tree_type::destroy_node(static_cast<link_type>(ptr));
+    }
+
+    static link_type load(const link_type &p) {
+        return __atomic_load_n(&p, __ATOMIC_ACQUIRE);
+    }
+
+    void write_begin() {
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void write_end() {
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /* 在 epoch 临界区内反复执行 body，直到读取期间 seq 没有变化 */
+    template <typename Body>
+    bool read(Body body, keyType *key, valueType *value) const {
+        epoch_guard guard(const_cast<epoch_domain &>(domain));
+        keyType k = keyType();
+        valueType v = valueType();
+        for (;;) {
+            unsigned s = seq.load(std::memory_order_acquire);
+            if (s & 1) {                    /* 写者正在改结构 */
+                std::this_thread::yield();
+                continue;
+            }
+            int hops = 0;
+            link_type pos = body(hops, &k, &v);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (hops <= RCU_MAX_HOPS && s == seq.load(std::memory_order_relaxed)) {
+                if (pos && key) *key = k;
+                if (pos && value) *value = v;
+                return nullptr != pos;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,289 @@
+/**
+ * @file serialize.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief streaming block serialization of bst_map and bulk loading
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __SERIALIZE_HPP__
+#define __SERIALIZE_HPP__
+#include "bst.hpp"
+
+#include <chrono>
+#include <sys/stat.h>
+
+/**
+ * 流格式：
+ *   __stream_header | block | block | ...
+ *   block = __stream_block | payload
+ * 每个 block 内的记录按键递增排列，整数键存放与前一个键的差值（block 内第一个与 0 相差），
+ * 打开 STREAM_VARINT 时差值再用 LEB128 变长编码；其它键和所有的值按原始字节存放。
+ * 每个 block 可以独立解码，读取时一次只读入一个 block。
+ */
+#define STREAM_MAGIC      "BSTSTRM1"
+#define STREAM_VARINT     (1u)
+#define STREAM_BLOCK_SIZE (64u << 10)
+
+struct __stream_header {
+    char     magic[8];
+    uint32_t flags;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+struct __stream_block {
+    uint32_t records;
+    uint32_t bytes;
+};
+
+/* 一次保存或加载的统计 */
+struct stream_stats {
+    size_t records;
+    size_t bytes;
+    double seconds;
+
+    double mb_per_second() const {
+        return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0;
+    }
+};
+
+template <typename keyType, typename valueType>
+class __stream_codec {
+public:
+    static const bool delta = std::is_integral<keyType>::value;
+    typedef typename std::conditional<delta, typename std::make_unsigned<
+        typename std::conditional<delta, keyType, int>::type>::type, keyType>::type ukey;
+
+    static_assert(std::is_trivially_copyable<keyType>::value &&
+                  std::is_trivially_copyable<valueType>::value,
+                  "streaming needs trivially copyable keys and values");
+
+    explicit __stream_codec(uint32_t f) : flags(f) {}
+
+    /* 单条记录编码后最少占用的字节数，用来检查头部的记录数是否放得进文件 */
+    size_t min_record() const {
+        size_t key = delta && (flags & STREAM_VARINT) ? 1 : sizeof(keyType);
+        return key + sizeof(valueType);
+    }
+
+    /* 单条记录编码后最多占用的字节数 */
+    static size_t max_record() {
+        return sizeof(keyType) + sizeof(keyType) / 7 + 1 + sizeof(valueType);
+    }
+
+    uint8_t *encode(uint8_t *out, const keyType &key, const valueType &value, const keyType *prev) {
+        if (delta) {
+            ukey d = (ukey)key - (prev ? (ukey)*prev : (ukey)0);
+            if (flags & STREAM_VARINT) {
+                while (d >= 0x80) {
+                    *out++ = (uint8_t)(d | 0x80);
+                    d >>= 7;
+                }
+                *out++ = (uint8_t)d;
+            } else {
+                memcpy(out, &d, sizeof(d));
+                out += sizeof(d);
+            }
+        } else {
+            memcpy(out, &key, sizeof(key));
+            out += sizeof(key);
+        }
+        memcpy(out, &value, sizeof(value));
+        return out + sizeof(value);
+    }
+
+    /* 越界返回 nullptr */
+    const uint8_t *decode(const uint8_t *in, const uint8_t *end,
+                          keyType &key, valueType &value, const keyType *prev) {
+        if (delta) {
+            ukey d = 0;
+            if (flags & STREAM_VARINT) {
+                for (unsigned shift = 0; ; shift += 7) {
+                    if (in == end || shift >= 8 * sizeof(ukey)) return nullptr;
+                    uint8_t byte = *in++;
+                    d |= (ukey)(byte & 0x7f) << shift;
+                    if (!(byte & 0x80)) break;
+                }
+            } else {
+                if ((size_t)(end - in) < sizeof(d)) return nullptr;
+                memcpy(&d, in, sizeof(d));
+                in += sizeof(d);
+            }
+            key = (keyType)((prev ? (ukey)*prev : (ukey)0) + d);
+        } else {
+            if ((size_t)(end - in) < sizeof(key)) return nullptr;
+            memcpy(&key, in, sizeof(key));
+            in += sizeof(key);
+        }
+        if ((size_t)(end - in) < sizeof(value)) return nullptr;
+        memcpy(&value, in, sizeof(value));
+        return in + sizeof(value);
+    }
+
+private:
+    uint32_t flags;
+};
+
+/**
+ * 按中序把 tree 写入 path，flags 可取 STREAM_VARINT。成功返回 0，失败返回 -1。
+ */
+template <typename keyType, typename valueType>
+int stream_save(bst_map<keyType, valueType> &tree, const char *path,
+                uint32_t flags = STREAM_VARINT, stream_stats *stats = nullptr) {
+    typedef __stream_codec<keyType, valueType> codec_type;
+    auto tic = std::chrono::steady_clock::now();
+    codec_type codec(flags);
+    FILE *fp = fopen(path, "wb");
+    if (nullptr == fp) return -1;
+
+    __stream_header hdr;
+    memcpy(hdr.magic, STREAM_MAGIC, sizeof(hdr.magic));
+    hdr.flags = flags;
+    hdr.key_size = sizeof(keyType);
+    hdr.value_size = sizeof(valueType);
+    hdr.reserved = 0;
+    hdr.count = tree.size;
+    bool ok = 1 == fwrite(&hdr, sizeof(hdr), 1, fp);
+    size_t bytes = sizeof(hdr);
+
+    std::vector<uint8_t> buf(STREAM_BLOCK_SIZE + codec_type::max_record());
+    uint8_t *out = buf.data();
+    __stream_block blk = {0, 0};
+    keyType prev = keyType();
+
+    for (auto i = tree.begin(); ok && i != tree.end(); ++i) {
+        out = codec.encode(out, i.node->key, i.node->value, blk.records ? &prev : nullptr);
+        prev = i.node->key;
+        blk.records++;
+        blk.bytes = out - buf.data();
+
+        auto next = i;
+        if (blk.bytes >= STREAM_BLOCK_SIZE || ++next == tree.end()) {
+            ok = 1 == fwrite(&blk, sizeof(blk), 1, fp) &&
+                 1 == fwrite(buf.data(), blk.bytes, 1, fp);
+            bytes += sizeof(blk) + blk.bytes;
+            blk.records = blk.bytes = 0;
+            out = buf.data();
+        }
+    }
+
+    if (fclose(fp)) ok = false;
+    if (stats) {
+        stats->records = tree.size;
+        stats->bytes = bytes;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tic).count();
+    }
+    return ok ? 0 : -1;
+}
+
+/* 从流中一条一条取出记录，一次只读入一个 block */
+template <typename keyType, typename valueType>
+class stream_reader {
+public:
+    typedef __stream_codec<keyType, valueType> codec_type;
+
+    uint64_t count;         /* 流中的记录总数 */
+    size_t   bytes;         /* 已读入的字节数 */
+    bool     error;
+
+    stream_reader() : count(0), bytes(0), error(false), fp(nullptr), codec(0),
+                      pos(nullptr), end(nullptr), left(0), first(true),
+                      read(false), prev() {}
+    ~stream_reader() { if (fp) fclose(fp); }
+
+    /* 头部的 count 不可信：超过文件剩余字节所能容纳的记录数时拒绝，调用者按 count 分配内存 */
+    int open(const char *path) {
+        __stream_header hdr;
+        struct stat st;
+        fp = fopen(path, "rb");
+        if (nullptr == fp) return -1;
+        if (fstat(fileno(fp), &st) < 0 ||
+            1 != fread(&hdr, sizeof(hdr), 1, fp) ||
+            memcmp(hdr.magic, STREAM_MAGIC, sizeof(hdr.magic)) ||
+            hdr.key_size != sizeof(keyType) || hdr.value_size != sizeof(valueType))
+            return -1;
+        codec = codec_type(hdr.flags);
+        if (hdr.count > ((uint64_t)st.st_size - sizeof(hdr)) / codec.min_record())
+            return -1;
+        count = hdr.count;
+        bytes = sizeof(hdr);
+        return 0;
+    }
+
+    /* 取下一条记录；流损坏、键不递增或提前结束时置 error 并返回 false */
+    bool next(keyType &key, valueType &value) {
+        if (error) return false;
+        if (0 == left && !read_block()) {
+            error = true;
+            return false;
+        }
+        const uint8_t *p = codec.decode(pos, end, key, value, first ? nullptr : &prev);
+        if (nullptr == p || (read && !(prev < key))) {
+            error = true;
+            return false;
+        }
+        pos = p;
+        prev = key;
+        first = false;
+        read = true;
+        left--;
+        return true;
+    }
+
+private:
+    FILE                 *fp;
+    codec_type            codec;
+    std::vector<uint8_t>  buf;
+    const uint8_t        *pos;
+    const uint8_t        *end;
+    uint32_t              left;     /* 当前 block 中剩余的记录数 */
+    bool                  first;    /* 下一条是否为 block 中的第一条 */
+    bool                  read;     /* prev 是否有效 */
+    keyType               prev;
+
+    bool read_block() {
+        __stream_block blk;
+        if (1 != fread(&blk, sizeof(blk), 1, fp) || 0 == blk.records) return false;
+        buf.resize(blk.bytes);
+        if (blk.bytes && 1 != fread(buf.data(), blk.bytes, 1, fp)) return false;
+        bytes += sizeof(blk) + blk.bytes;
+        pos = buf.data();
+        end = pos + blk.bytes;
+        left = blk.records;
+        first = true;
+        return true;
+    }
+};
+
+/**
+ * 读取 stream_save() 写出的文件，直接交给 assign_sorted() 线性时间建树，
+ * 不逐条 insert。成功返回 0；失败返回 -1，此时 tree 为空。
+ * 整个文件不会同时驻留内存，只有 tree 本身需要放得下。
+ */
+template <typename keyType, typename valueType>
+int stream_load(bst_map<keyType, valueType> &tree, const char *path,
+                stream_stats *stats = nullptr) {
+    auto tic = std::chrono::steady_clock::now();
+    stream_reader<keyType, valueType> reader;
+    if (reader.open(path)) {
+        tree.clear();
+        return -1;
+    }
+
+    if (!tree.assign_sorted(reader.count, [&reader](keyType &key, valueType &value) {
+            return reader.next(key, value);
+        }))
+        return -1;
+
+    if (stats) {
+        stats->records = reader.count;
+        stats->bytes = reader.bytes;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tic).count();
+    }
+    return 0;
+}
+
+#endif
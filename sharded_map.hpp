@@ -0,0 +1,210 @@
+/**
+ * @file sharded_map.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief thread-safe map split into shards, each behind its own reader-writer lock
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __SHARDED_MAP_HPP__
+#define __SHARDED_MAP_HPP__
+#include "rb_tree.hpp"
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <algorithm>
+
+const char *SHARDED_MAP = "shard";
+
+#define SHARD_DEFAULT 16
+
+/**
+ * 键按哈希或按区间分到 N 个 Engine（rbt_map、avl_map ...）里，每个分片一把 std::shared_mutex：
+ *   - 点操作只锁一个分片，find 取读锁，insert/remove 取写锁；
+ *   - find 在锁内把值拷出来，不返回节点指针，因为出了锁节点就可能被删掉；
+ *   - ordered() 按分片下标顺序对所有分片加读锁，再对各分片的中序做 k 路归并，
+ *     视图存在期间看到的是一致的快照，写者会被挡住，用完要尽快销毁。
+ *     点操作每次只拿一把锁，所以按固定顺序加锁不会死锁。
+ * 区间分片由 bounds 给出，分片 i 存放 [bounds[i-1], bounds[i]) 之间的键。
+ */
+template <typename keyType, typename valueType,
+          typename Engine = rbt_map<keyType, valueType> >
+class sharded_map {
+public:
+    typedef keyType                             key_type;
+    typedef valueType                           value_type;
+    typedef bst_map<keyType, valueType>         tree_type;
+    typedef typename tree_type::link_type       link_type;
+
+    /* 占满一条 cache line，相邻分片的锁不会互相伪共享 */
+    struct alignas(64) shard {
+        mutable std::shared_mutex   lock;
+        Engine                      tree;
+    };
+
+    /* 哈希分片 */
+    explicit sharded_map(size_t n = SHARD_DEFAULT)
+        : count(n ? n : 1), shards(new shard[count]) {}
+
+    /* 区间分片，共 bounds.size() + 1 个分片，bounds 须递增 */
+    explicit sharded_map(const std::vector<keyType> &b)
+        : count(b.size() + 1), shards(new shard[count]), bounds(b) {}
+
+    sharded_map(const sharded_map &) = delete;
+    sharded_map &operator=(const sharded_map &) = delete;
+
+    void insert(const keyType &key, const valueType &value) {
+        shard &s = shard_of(key);
+        std::unique_lock<std::shared_mutex> guard(s.lock);
+        s.tree.insert(key, value);
+    }
+
+    /* 删除成功返回 true */
+    bool remove(const keyType &key) {
+        shard &s = shard_of(key);
+        std::unique_lock<std::shared_mutex> guard(s.lock);
+        if (nullptr == s.tree.find(key)) return false;
+        s.tree.remove(key);
+        return true;
+    }
+
+    /* 找到时把值拷到 *value（可为 nullptr）并返回 true */
+    bool find(const keyType &key, valueType *value = nullptr) const {
+        const shard &s = shard_of(key);
+        std::shared_lock<std::shared_mutex> guard(s.lock);
+        link_type node = s.tree.find(key);
+        if (nullptr == node) return false;
+        if (value) *value = node->value;
+        return true;
+    }
+
+    /* 各分片大小之和，并发写入时只是一个近似值 */
+    size_t size() const {
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].lock);
+            n += shards[i].tree.size;
+        }
+        return n;
+    }
+
+    bool empty() const {
+        return 0 == size();
+    }
+
+    void clear() {
+        for (size_t i = 0; i < count; i++) {
+            std::unique_lock<std::shared_mutex> guard(shards[i].lock);
+            shards[i].tree.clear();
+        }
+    }
+
+    size_t shard_count() const {
+        return count;
+    }
+
+    /* 各分片中序的 k 路归并，堆顶是当前最小的节点 */
+    struct iterator {
+        std::vector<link_type> heap;
+
+        static bool greater(link_type a, link_type b) {
+            return b->key < a->key;
+        }
+
+        const keyType &key() const { return heap.front()->key; }
+        const valueType &operator*() const { return heap.front()->value; }
+        const valueType *operator->() const { return &heap.front()->value; }
+
+        iterator& operator++() {
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            link_type next = __node_base_next(heap.back());
+            if (next) {
+                heap.back() = next;
+                std::push_heap(heap.begin(), heap.end(), greater);
+            } else
+                heap.pop_back();
+            return *this;
+        }
+
+        bool operator==(const iterator &x) const {
+            if (heap.empty() || x.heap.empty()) return heap.empty() == x.heap.empty();
+            return heap.front() == x.heap.front();
+        }
+        bool operator!=(const iterator &x) const {
+            return !(*this == x);
+        }
+    };
+
+    /* 持有所有分片读锁的有序视图 */
+    class ordered_view {
+    public:
+        iterator begin() const {
+            iterator it;
+            for (size_t i = 0; i < map->count; i++)
+                if (map->shards[i].tree.root)
+                    it.heap.push_back(__node_base_first(map->shards[i].tree.root));
+            std::make_heap(it.heap.begin(), it.heap.end(), iterator::greater);
+            return it;
+        }
+
+        iterator end() const {
+            return iterator();
+        }
+
+    private:
+        friend class sharded_map;
+        const sharded_map *map;
+        std::vector<std::shared_lock<std::shared_mutex> > guards;
+
+        explicit ordered_view(const sharded_map *m) : map(m) {
+            guards.reserve(m->count);
+            for (size_t i = 0; i < m->count; i++)
+                guards.emplace_back(m->shards[i].lock);
+        }
+    };
+
+    ordered_view ordered() const {
+        return ordered_view(this);
+    }
+
+    /* 逐个分片加读锁累加；分片数组（含对齐填充和锁）与区间边界是 metadata */
+    map_memory memory_usage() const {
+        map_memory m;
+        for (size_t i = 0; i < count; i++) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].lock);
+            m += shards[i].tree.memory_usage();
+            m.metadata -= sizeof(Engine);
+        }
+        m.metadata += sizeof(*this) + count * sizeof(shard) + bounds.capacity() * sizeof(keyType);
+        m.overhead += malloc_overhead(count * sizeof(shard)) + malloc_overhead(bounds.capacity() * sizeof(keyType));
+        return m;
+    }
+
+    const char *name() const {
+        return SHARDED_MAP;
+    }
+
+private:
+    size_t                      count;
+    std::unique_ptr<shard[]>    shards;
+    std::vector<keyType>        bounds;     /* 为空时按哈希分片 */
+
+    size_t index_of(const keyType &key) const {
+        if (!bounds.empty())
+            return std::upper_bound(bounds.begin(), bounds.end(), key) - bounds.begin();
+        /* 先打散再取模，std::hash 对整数通常是恒等映射 */
+        uint64_t h = (uint64_t)std::hash<keyType>()(key) * 0x9E3779B97F4A7C15ull;
+        return (h >> 32) % count;
+    }
+
+    shard &shard_of(const keyType &key) {
+        return shards[index_of(key)];
+    }
+
+    const shard &shard_of(const keyType &key) const {
+        return shards[index_of(key)];
+    }
+};
+
+#endif
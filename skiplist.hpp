@@ -0,0 +1,319 @@
+/**
+ * @file skiplist.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief lock-free skip list map, the ordered baseline for the concurrent tree engines
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * M. Herlihy, N. Shavit. The Art of Multiprocessor Programming, 14.4 A Lock-Free Concurrent Skiplist.
+ */
+#ifndef __SKIPLIST_HPP__
+#define __SKIPLIST_HPP__
+#include "epoch.hpp"
+#include "memory_usage.hpp"
+
+#include <stdlib.h>
+#include <new>
+#include <type_traits>
+
+const char *SKIPLIST_MAP = "skip";
+
+#define SKIPLIST_MAX_LEVEL 16       /* 4^16 个元素以内层数够用 */
+
+/**
+ * 每层是一条有序单链表，next 指针的最低位是删除标记，标记之后这一层的 next 不再改变：
+ *   - 删除先从顶层到第 1 层逐层打标记，第 0 层打上标记的线程才是真正删除它的线程（线性化点），
+ *     随后再查找一次，把它从各层摘下；
+ *   - 查找时遇到带标记的节点顺手用 CAS 摘掉（find_path），只读的 find() 直接跳过，不写共享内存；
+ *   - 插入先链入第 0 层（线性化点），再自底向上链入更高层，发现自己已被标记就停下；
+ *   - 塔的链入和删除可能交错，节点带一个计数 2，插入者建完塔、删除者摘下后各减一，
+ *     归零时交给 epoch_domain，没有读者停在上面时再释放。
+ * 值用 std::atomic 保存，值必须是平凡可拷贝的；已有的键 insert 时原地覆盖。
+ */
+template <typename keyType, typename valueType>
+struct __skip_node {
+    typedef __skip_node *link_type;
+
+    std::atomic<int>        refs;
+    int                     level;
+    keyType                 key;
+    std::atomic<valueType>  value;
+    std::atomic<uintptr_t>  next[1];    /* 实际有 level 个 */
+
+    static size_t bytes(int level) {
+        return sizeof(__skip_node) + (level - 1) * sizeof(std::atomic<uintptr_t>);
+    }
+
+    static link_type create(const keyType &k, const valueType &v, int level) {
+        void *mem = ::operator new(bytes(level));
+        link_type node = static_cast<link_type>(mem);
+        new (&node->refs) std::atomic<int>(2);
+        node->level = level;
+        new (&node->key) keyType(k);
+        new (&node->value) std::atomic<valueType>(v);
+        for (int i = 0; i < level; i++)
+            new (&node->next[i]) std::atomic<uintptr_t>(0);
+        return node;
+    }
+
+    static void destroy(link_type node) {
+        node->key.~keyType();
+        ::operator delete(node);
+    }
+
+    static link_type ptr(uintptr_t p) { return reinterpret_cast<link_type>(p & ~(uintptr_t)1); }
+    static bool marked(uintptr_t p) { return p & 1; }
+};
+
+template <typename keyType, typename valueType>
+class skiplist_map {
+public:
+    typedef keyType                             key_type;
+    typedef valueType                           value_type;
+    typedef __skip_node<keyType, valueType>     NODE;
+    typedef NODE                                *link_type;
+
+    static_assert(std::is_trivially_copyable<valueType>::value,
+                  "values are stored in std::atomic");
+
+    /* 沿第 0 层前进，跳过已标记删除的节点；只在没有并发删除时使用，否则用 for_each() */
+    struct iterator {
+        link_type node;
+
+        explicit iterator(link_type x) : node(x) { skip(); }
+
+        const keyType &key() const { return node->key; }
+        valueType operator*() const { return node->value.load(std::memory_order_relaxed); }
+
+        iterator& operator++() {
+            node = NODE::ptr(node->next[0].load(std::memory_order_acquire));
+            skip();
+            return *this;
+        }
+
+        bool operator==(const iterator &x) const { return node == x.node; }
+        bool operator!=(const iterator &x) const { return node != x.node; }
+
+    private:
+        void skip() {
+            while (node && NODE::marked(node->next[0].load(std::memory_order_acquire)))
+                node = NODE::ptr(node->next[0].load(std::memory_order_acquire));
+        }
+    };
+
+    skiplist_map() : count(0), bytes(NODE::bytes(SKIPLIST_MAX_LEVEL)), domain(reclaim, this) {
+        head = NODE::create(keyType(), valueType(), SKIPLIST_MAX_LEVEL);
+    }
+
+    ~skiplist_map() {
+        domain.drain();
+        link_type node = head;
+        while (node) {
+            link_type next = NODE::ptr(node->next[0].load());
+            NODE::destroy(node);
+            node = next;
+        }
+    }
+
+    skiplist_map(const skiplist_map &) = delete;
+    skiplist_map &operator=(const skiplist_map &) = delete;
+
+    bool find(const keyType &key, valueType *value = nullptr) {
+        epoch_guard guard(domain);
+        link_type pred = head, curr = nullptr;
+        for (int i = SKIPLIST_MAX_LEVEL - 1; i >= 0; i--) {
+            curr = NODE::ptr(pred->next[i].load(std::memory_order_acquire));
+            while (curr) {
+                uintptr_t succ = curr->next[i].load(std::memory_order_acquire);
+                if (NODE::marked(succ)) {       /* 已删除，跳过 */
+                    curr = NODE::ptr(succ);
+                    continue;
+                }
+                if (!(curr->key < key)) break;
+                pred = curr;
+                curr = NODE::ptr(succ);
+            }
+        }
+        if (nullptr == curr || key < curr->key) return false;
+        if (NODE::marked(curr->next[0].load(std::memory_order_acquire))) return false;
+        if (value) *value = curr->value.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    /* 新增返回 true，覆盖已有的值返回 false */
+    bool insert(const keyType &key, const valueType &value) {
+        epoch_guard guard(domain);
+        link_type preds[SKIPLIST_MAX_LEVEL], succs[SKIPLIST_MAX_LEVEL];
+        int level = random_level();
+        link_type node = nullptr;
+        for (;;) {
+            if (find_path(key, preds, succs)) {
+                succs[0]->value.store(value, std::memory_order_relaxed);
+                if (node) NODE::destroy(node);  /* 从未发布过 */
+                return false;
+            }
+            if (nullptr == node) node = NODE::create(key, value, level);
+            for (int i = 0; i < level; i++)
+                node->next[i].store((uintptr_t)succs[i], std::memory_order_relaxed);
+            uintptr_t expect = (uintptr_t)succs[0];
+            if (preds[0]->next[0].compare_exchange_strong(expect, (uintptr_t)node))
+                break;
+        }
+        count.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(NODE::bytes(level), std::memory_order_relaxed);
+
+        for (int i = 1; i < level; i++) {
+            for (;;) {
+                uintptr_t next = node->next[i].load();
+                if (NODE::marked(next)) goto done;      /* 已被删除，不再往上链 */
+                if (NODE::ptr(next) != succs[i] &&
+                    !node->next[i].compare_exchange_strong(next, (uintptr_t)succs[i]))
+                    continue;
+                uintptr_t expect = (uintptr_t)succs[i];
+                if (preds[i]->next[i].compare_exchange_strong(expect, (uintptr_t)node))
+                    break;
+                find_path(key, preds, succs);
+                if (succs[0] != node) goto done;        /* 第 0 层已经摘下 */
+            }
+        }
+    done:
+        /* 删除者可能在链塔期间摘过一遍，再查一次把迟到链入的层摘掉 */
+        if (NODE::marked(node->next[0].load())) find_path(key, preds, succs);
+        unref(node);
+        return true;
+    }
+
+    /* 删除成功返回 true */
+    bool remove(const keyType &key) {
+        epoch_guard guard(domain);
+        link_type preds[SKIPLIST_MAX_LEVEL], succs[SKIPLIST_MAX_LEVEL];
+        if (!find_path(key, preds, succs)) return false;
+        link_type node = succs[0];
+
+        for (int i = node->level - 1; i >= 1; i--) {
+            uintptr_t next = node->next[i].load();
+            while (!NODE::marked(next))
+                node->next[i].compare_exchange_weak(next, next | 1);
+        }
+        uintptr_t next = node->next[0].load();
+        for (;;) {
+            if (NODE::marked(next)) return false;       /* 别的线程先删了 */
+            if (node->next[0].compare_exchange_weak(next, next | 1)) break;
+        }
+        find_path(key, preds, succs);
+        count.fetch_sub(1, std::memory_order_relaxed);
+        bytes.fetch_sub(NODE::bytes(node->level), std::memory_order_relaxed);
+        unref(node);
+        return true;
+    }
+
+    /* 并发修改时只是近似值 */
+    size_t size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        return 0 == size();
+    }
+
+    /* 节点（含头节点）占用的字节数，不含分配器开销 */
+    size_t memory() const {
+        return bytes.load(std::memory_order_relaxed);
+    }
+
+    /* 按键递增对每个元素调用 fn(key, value)，可与修改并发，看到的是弱一致的结果 */
+    template <typename Fn>
+    size_t for_each(Fn fn) {
+        epoch_guard guard(domain);
+        size_t n = 0;
+        for (iterator i = begin(); i != end(); ++i, n++)
+            fn(i.key(), *i);
+        return n;
+    }
+
+    iterator begin() { return iterator(NODE::ptr(head->next[0].load(std::memory_order_acquire))); }
+    iterator end() { return iterator(nullptr); }
+
+    /**
+     * 沿第 0 层遍历，已标记删除、尚未摘下的节点是 slack，头节点是 metadata；
+     * 等待 epoch 回收的节点层数未知，按 1 层估计。并发修改时是近似值。
+     */
+    map_memory memory_usage() const {
+        epoch_guard guard(const_cast<epoch_domain &>(domain));
+        map_memory m;
+        for (link_type node = NODE::ptr(head->next[0].load(std::memory_order_acquire)); node;) {
+            uintptr_t next = node->next[0].load(std::memory_order_acquire);
+            size_t n = NODE::bytes(node->level);
+            (NODE::marked(next) ? m.slack : m.nodes) += n;
+            m.overhead += malloc_overhead(n);
+            node = NODE::ptr(next);
+        }
+        size_t limbo = const_cast<epoch_domain &>(domain).pending();
+        m.slack += limbo * NODE::bytes(1);
+        m.overhead += limbo * malloc_overhead(NODE::bytes(1)) + malloc_overhead(NODE::bytes(SKIPLIST_MAX_LEVEL));
+        m.metadata = sizeof(*this) + NODE::bytes(SKIPLIST_MAX_LEVEL);
+        return m;
+    }
+
+    const char *name() const {
+        return SKIPLIST_MAP;
+    }
+
+private:
+    std::atomic<size_t> count;
+    std::atomic<size_t> bytes;
+    link_type           head;       /* 哨兵，SKIPLIST_MAX_LEVEL 层 */
+    epoch_domain        domain;
+
+    static void reclaim(void *, void *ptr) {
+        NODE::destroy(static_cast<link_type>(ptr));
+    }
+
+    void unref(link_type node) {
+        if (1 == node->refs.fetch_sub(1, std::memory_order_acq_rel))
+            domain.retire(node);
+    }
+
+    /* 每层以 1/4 的概率继续升高 */
+    static int random_level() {
+        static thread_local uint64_t seed = (uint64_t)(uintptr_t)&seed | 1;
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        int level = 1;
+        for (uint64_t r = seed; (r & 3) == 0 && level < SKIPLIST_MAX_LEVEL; r >>= 2)
+            level++;
+        return level;
+    }
+
+    /**
+     * 求出每层中 key 的前驱 preds[i] 和第一个不小于 key 的节点 succs[i]，
+     * 路上遇到带标记的节点就摘下，CAS 失败说明前驱也变了，从头再来。
+     * 第 0 层找到了未删除的 key 时返回 true。
+     */
+    bool find_path(const keyType &key, link_type *preds, link_type *succs) {
+    retry:
+        link_type pred = head, curr = nullptr;
+        for (int i = SKIPLIST_MAX_LEVEL - 1; i >= 0; i--) {
+            curr = NODE::ptr(pred->next[i].load(std::memory_order_acquire));
+            while (curr) {
+                uintptr_t succ = curr->next[i].load(std::memory_order_acquire);
+                if (NODE::marked(succ)) {
+                    uintptr_t expect = (uintptr_t)curr;
+                    if (!pred->next[i].compare_exchange_strong(expect, succ & ~(uintptr_t)1))
+                        goto retry;
+                    curr = NODE::ptr(succ);
+                    continue;
+                }
+                if (!(curr->key < key)) break;
+                pred = curr;
+                curr = NODE::ptr(succ);
+            }
+            preds[i] = pred;
+            succs[i] = curr;
+        }
+        return curr && !(key < curr->key);
+    }
+};
+
+#endif
@@ -0,0 +1,225 @@
+/**
+ * @file small_map.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief map that keeps up to N entries in an inline sorted array
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ */
+#ifndef __SMALL_MAP_HPP__
+#define __SMALL_MAP_HPP__
+#include "rb_tree.hpp"
+
+const char *SMALL_MAP = "small";
+
+/**
+ * 元素不超过 N 个时，键和值分别存放在对象内部的有序数组里，不做任何堆分配；
+ * 查找是对整个键数组的无分支计数（统计比 key 小的个数），整数键可被编译器向量化。
+ * 超过 N 个时整体搬进 Engine（rbt_map、avl_map ...），
+ * 删除到 N/2 个以下再搬回数组，留出余量避免在 N 附近来回搬动。
+ */
+template <typename keyType, typename valueType, size_t N = 16,
+          typename Engine = rbt_map<keyType, valueType> >
+class small_map {
+public:
+    typedef keyType                             key_type;
+    typedef valueType                           value_type;
+    typedef valueType&                          reference;
+    typedef bst_map<keyType, valueType>         tree_type;
+    typedef typename tree_type::link_type       link_type;
+
+    /* 数组模式下用下标，树模式下用节点 */
+    struct iterator {
+        small_map       *map;
+        size_t           index;
+        link_type        node;
+
+        const keyType &key() const {
+            return map->tree ? node->key : map->keys[index];
+        }
+
+        reference operator*() const {
+            return map->tree ? node->value : map->values[index];
+        }
+
+        valueType *operator->() const {
+            return &**this;
+        }
+
+        iterator& operator++() {
+            if (map->tree)
+                node = __node_base_next(node);
+            else
+                index++;
+            return *this;
+        }
+
+        bool operator==(const iterator &x) const {
+            return index == x.index && node == x.node;
+        }
+        bool operator!=(const iterator &x) const {
+            return !(*this == x);
+        }
+    };
+
+    size_t  size;
+
+    small_map() : size(0), tree(nullptr) {}
+    ~small_map() { delete tree; }
+
+    small_map(const small_map &) = delete;
+    small_map &operator=(const small_map &) = delete;
+
+    reference operator[](const keyType &key) {
+        valueType *pos = find(key);
+        if (pos) return *pos;
+        insert(key, valueType());
+        return *find(key);
+    }
+
+    void insert(const keyType &key, const valueType &value) {
+        if (tree) {
+            tree->insert(key, value);
+            size = tree->size;
+            return;
+        }
+
+        size_t pos = lower_bound(key);
+        if (pos < size && !(key < keys[pos])) {
+            values[pos] = value;
+            return;
+        }
+        if (size == N) {
+            promote();
+            insert(key, value);
+            return;
+        }
+        for (size_t i = size; i > pos; i--) {
+            keys[i] = keys[i - 1];
+            values[i] = values[i - 1];
+        }
+        keys[pos] = key;
+        values[pos] = value;
+        size++;
+    }
+
+    void remove(const keyType &key) {
+        if (tree) {
+            if (tree->find(key)) tree->remove(key);
+            size = tree->size;
+            if (size <= N / 2) demote();
+            return;
+        }
+
+        size_t pos = lower_bound(key);
+        if (pos == size || key < keys[pos]) return;
+        for (size_t i = pos + 1; i < size; i++) {
+            keys[i - 1] = keys[i];
+            values[i - 1] = values[i];
+        }
+        size--;
+    }
+
+    valueType *find(const keyType &key) {
+        if (tree) {
+            link_type node = tree->find(key);
+            return node ? &node->value : nullptr;
+        }
+        size_t pos = lower_bound(key);
+        if (pos < size && !(key < keys[pos])) return &values[pos];
+        return nullptr;
+    }
+
+    void clear() {
+        delete tree;
+        tree = nullptr;
+        size = 0;
+    }
+
+    bool empty() const {
+        return 0 == size;
+    }
+
+    /* 是否已经搬进了树 */
+    bool promoted() const {
+        return nullptr != tree;
+    }
+
+    iterator begin() {
+        if (tree) return iterator{this, 0, __node_base_first(tree->root)};
+        return iterator{this, 0, nullptr};
+    }
+
+    iterator end() {
+        if (tree) return iterator{this, 0, nullptr};
+        return iterator{this, size, nullptr};
+    }
+
+    /* 数组模式下最多 N 个元素，不值得分给别的线程，直接顺序执行 */
+    template <typename Fn>
+    void parallel_for_each(Fn fn, thread_pool &pool = thread_pool::instance()) {
+        if (tree) return tree->parallel_for_each(fn, pool);
+        for (size_t i = 0; i < size; i++) fn(keys[i], values[i]);
+    }
+
+    template <typename T, typename Map, typename Reduce>
+    T parallel_reduce(T init, Map map_fn, Reduce reduce_fn, thread_pool &pool = thread_pool::instance()) {
+        if (tree) return tree->parallel_reduce(init, map_fn, reduce_fn, pool);
+        T acc = init;
+        for (size_t i = 0; i < size; i++) acc = reduce_fn(acc, map_fn(keys[i], values[i]));
+        return acc;
+    }
+
+    /* 数组模式下没有堆分配，空着的槽位是 slack；树模式下数组整个闲置 */
+    map_memory memory_usage() const {
+        const size_t pair = sizeof(keyType) + sizeof(valueType);
+        map_memory m;
+        if (tree) {
+            m = tree->memory_usage();
+            m.overhead += malloc_overhead(sizeof(Engine));
+            m.metadata += sizeof(Engine) - sizeof(tree_type);
+            m.slack += N * pair;
+        } else {
+            m.nodes = size * pair;
+            m.slack = (N - size) * pair;
+        }
+        m.metadata += sizeof(*this) - N * pair;
+        return m;
+    }
+
+    const char *name() const {
+        return SMALL_MAP;
+    }
+
+private:
+    keyType     keys[N];
+    valueType   values[N];
+    tree_type  *tree;
+
+    /* 比 key 小的元素个数，也就是 key 应当插入的位置 */
+    size_t lower_bound(const keyType &key) const {
+        size_t cnt = 0;
+        for (size_t i = 0; i < size; i++)
+            cnt += keys[i] < key;
+        return cnt;
+    }
+
+    void promote() {
+        tree = new Engine();
+        for (size_t i = 0; i < size; i++)
+            tree->insert(keys[i], values[i]);
+    }
+
+    void demote() {
+        size_t n = 0;
+        for (auto i = tree->begin(); i != tree->end(); ++i, ++n) {
+            keys[n] = i.node->key;
+            values[n] = i.node->value;
+        }
+        delete tree;
+        tree = nullptr;
+        size = n;
+    }
+};
+
+#endif
@@ -0,0 +1,429 @@
+/**
+ * @file thread_pool.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief work-stealing scheduler: Chase-Lev deques, fork/join task groups and ordered parallel traversal helpers
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * D. Chase, Y. Lev. Dynamic Circular Work-Stealing Deque. SPAA 2005.
+ * N. M. Lê, A. Pop, A. Cohen, F. Zappa Nardelli. Correct and Efficient Work-Stealing for Weak Memory Models. PPoPP 2013.
+ */
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef THREAD_POOL_WORKERS
+#define THREAD_POOL_WORKERS 0   /* thread_pool::instance() 的工作线程数，0 表示硬件线程数减一 */
+#endif
+
+#define PARALLEL_SPLIT      4   /* 每个线程平均分到的块数，块多一些，快的线程才有东西可偷 */
+#define CHASE_LEV_CAPACITY  64  /* 双端队列的初始容量，满了翻倍 */
+#define POOL_SPINS          64  /* 工作线程找不到任务时先让出 CPU 这么多次，再去睡眠 */
+#define POOL_HELP_DEPTH     16  /* sync() 嵌套超过这么多层后只做自己队列里的任务，不再去偷 */
+
+/**
+ * 单个所有者的双端队列：所有者在底部 push/take（后进先出），其它线程在顶部 steal（先进先出）。
+ * 只有队列里剩最后一个元素时所有者才需要和窃取者 CAS 竞争 top，其余情况下所有者不用原子读改写。
+ * 元素放在环形数组里，满了换一个两倍大的，旧数组可能还有窃取者在读，留到析构时释放。
+ * T 必须是平凡可拷贝的（这里是任务指针）。
+ */
+template <typename T>
+class chase_lev_deque {
+public:
+    chase_lev_deque() : top(0), bottom(0), array(new ring(CHASE_LEV_CAPACITY)) {}
+
+    ~chase_lev_deque() {
+        delete array.load();
+        for (ring *r : retired) delete r;
+    }
+
+    chase_lev_deque(const chase_lev_deque &) = delete;
+    chase_lev_deque &operator=(const chase_lev_deque &) = delete;
+
+    /* 只能由所有者调用 */
+    void push(T x) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        ring *a = array.load(std::memory_order_relaxed);
+        if (b - t >= (int64_t)a->size) {
+            retired.push_back(a);
+            a = a->grow(t, b);
+            array.store(a, std::memory_order_release);
+        }
+        a->put(b, x);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    /* 只能由所有者调用，空时返回 false */
+    bool take(T &x) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        ring *a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_seq_cst);     /* 先占住底部，再看 top，两者不能重排 */
+        int64_t t = top.load(std::memory_order_seq_cst);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        x = a->get(b);
+        if (t < b) return true;
+
+        /* 最后一个元素，和窃取者抢 */
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    /* 任意线程调用，空或者被别人抢先时返回 false */
+    bool steal(T &x) {
+        int64_t t = top.load(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_seq_cst);
+        if (t >= b) return false;
+        ring *a = array.load(std::memory_order_acquire);
+        x = a->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        return bottom.load(std::memory_order_seq_cst) <= top.load(std::memory_order_seq_cst);
+    }
+
+private:
+    struct ring {
+        size_t                          size;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit ring(size_t n) : size(n), slots(new std::atomic<T>[n]) {}
+
+        T get(int64_t i) const { return slots[i & (size - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t i, T x) { slots[i & (size - 1)].store(x, std::memory_order_relaxed); }
+
+        ring *grow(int64_t t, int64_t b) const {
+            ring *r = new ring(size * 2);
+            for (int64_t i = t; i < b; i++) r->put(i, get(i));
+            return r;
+        }
+    };
+
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::atomic<ring *>              array;
+    std::vector<ring *>              retired;   /* 只有所有者访问 */
+};
+
+/* 一个待执行的任务，闭包和计数指针分配在一起 */
+struct __task {
+    std::atomic<size_t> *pending;       /* 所属 task_group 未完成的任务数 */
+
+    virtual ~__task() {}
+    virtual void run() = 0;
+};
+
+template <typename Fn>
+struct __task_fn : __task {
+    Fn fn;
+
+    explicit __task_fn(Fn &&f) : fn(std::move(f)) {}
+    virtual void run() { fn(); }
+};
+
+/**
+ * 每个工作线程一个 chase_lev_deque：
+ *   - 工作线程中 spawn 的任务进自己的队列底部，工作线程总是先做自己最近 spawn 的任务；
+ *   - 自己的队列空了，依次从别的队列顶部偷，偷到的是较早 spawn 的、通常也是较大的任务；
+ *   - 池外的线程 spawn 的任务进一个加锁的注入队列，工作线程从头部取；
+ *   - sync() 的调用者在等待期间也执行任务（自己的队列、偷、注入队列），嵌套的 fork/join 不会死锁；
+ *     偷来的任务里又会 sync()，层层嵌套下去栈会无限加深，所以嵌套超过 POOL_HELP_DEPTH 层后只做自己队列里的，
+ *     那些正是本组尚未被偷走的孩子，被偷走的由偷的线程负责完成；
+ *   - 连续 POOL_SPINS 次找不到任务的工作线程在条件变量上睡眠，spawn 发现有人睡着才去唤醒。
+ */
+class thread_pool {
+public:
+    /* n 为 0 时取硬件线程数减一，sync() 的调用者自己算一个 */
+    explicit thread_pool(size_t n = 0) : injected_size(0), outside_steals(0), sleeping(0), stop(false) {
+        if (0 == n) {
+            size_t hw = std::thread::hardware_concurrency();
+            n = hw > 1 ? hw - 1 : 1;
+        }
+        for (size_t i = 0; i < n; i++)
+            workers.emplace_back(new worker());
+        for (size_t i = 0; i < n; i++)
+            threads.emplace_back(&thread_pool::run, this, i);
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &t : threads) t.join();
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    /* 全局共享的池，工作线程数由 THREAD_POOL_WORKERS 决定 */
+    static thread_pool &instance() {
+        static thread_pool pool(THREAD_POOL_WORKERS);
+        return pool;
+    }
+
+    /* 工作线程个数，加上 sync() 的调用者就是并行度 */
+    size_t size() const {
+        return workers.size();
+    }
+
+    /* 自创建以来成功偷到的任务数，用来衡量负载是否均衡、粒度是否合适 */
+    size_t steals() const {
+        size_t n = outside_steals.load(std::memory_order_relaxed);
+        for (auto &w : workers) n += w->stolen.load(std::memory_order_relaxed);
+        return n;
+    }
+
+private:
+    friend class task_group;
+
+    struct alignas(64) worker {
+        chase_lev_deque<__task *>   deque;
+        std::atomic<size_t>         stolen;     /* 只有所有者写 */
+
+        worker() : stolen(0) {}
+    };
+
+    /* 当前线程是哪个池的第几个工作线程 */
+    struct __current {
+        thread_pool *pool;
+        size_t       index;
+        size_t       helping;       /* 嵌套在几层 help() 中 */
+    };
+
+    static __current &current() {
+        static thread_local __current self = {nullptr, 0, 0};
+        return self;
+    }
+
+    std::vector<std::unique_ptr<worker>> workers;
+    std::vector<std::thread>    threads;
+    std::mutex                  inject_lock;
+    std::deque<__task *>        injected;       /* 池外线程 spawn 的任务 */
+    std::atomic<size_t>         injected_size;
+    std::atomic<size_t>         outside_steals;
+    std::mutex                  lock;           /* 保护 stop，配合 wake 让工作线程睡眠 */
+    std::condition_variable     wake;
+    std::atomic<size_t>         sleeping;
+    bool                        stop;
+
+    void push(__task *task) {
+        __current &self = current();
+        if (self.pool == this) {
+            workers[self.index]->deque.push(task);
+        } else {
+            std::lock_guard<std::mutex> guard(inject_lock);
+            injected.push_back(task);
+            injected_size.fetch_add(1, std::memory_order_relaxed);
+        }
+        /*
+         * 读改写而不是普通读：与睡眠者的 sleeping++ 在同一个变量上全序，
+         * 要么这里看到它要睡，要么它在 ++ 之后一定看到刚放进去的任务。
+         */
+        if (sleeping.fetch_add(0, std::memory_order_acq_rel)) {
+            std::lock_guard<std::mutex> guard(lock);
+            wake.notify_one();
+        }
+    }
+
+    bool has_work() const {
+        if (injected_size.load(std::memory_order_seq_cst)) return true;
+        for (auto &w : workers)
+            if (!w->deque.empty()) return true;
+        return false;
+    }
+
+    bool find(__task *&task) {
+        __current &self = current();
+        bool inside = self.pool == this;
+        if (inside && workers[self.index]->deque.take(task)) return true;
+
+        /*
+         * 池外的线程 spawn 的孩子在注入队列里，对它来说注入队列就是自己的队列：
+         * 不受嵌套层数限制，并且和 take() 一样从尾部取最近放进去的；工作线程从头部取。
+         */
+        size_t from = inside ? self.index + 1 : 0;
+        for (size_t i = 0; i < workers.size() && self.helping <= POOL_HELP_DEPTH; i++) {
+            worker &victim = *workers[(from + i) % workers.size()];
+            if (&victim == (inside ? workers[self.index].get() : nullptr)) continue;
+            if (victim.deque.steal(task)) {
+                if (inside)
+                    workers[self.index]->stolen.fetch_add(1, std::memory_order_relaxed);
+                else
+                    outside_steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        if (inside && self.helping > POOL_HELP_DEPTH) return false;
+        if (0 == injected_size.load(std::memory_order_relaxed)) return false;
+        std::lock_guard<std::mutex> guard(inject_lock);
+        if (injected.empty()) return false;
+        if (inside) {
+            task = injected.front();
+            injected.pop_front();
+        } else {
+            task = injected.back();
+            injected.pop_back();
+        }
+        injected_size.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    static void execute(__task *task) {
+        std::atomic<size_t> *pending = task->pending;
+        task->run();
+        delete task;
+        pending->fetch_sub(1, std::memory_order_release);
+    }
+
+    /* sync() 的调用者等待期间也在干活 */
+    void help(std::atomic<size_t> &pending) {
+        __current &self = current();
+        __task *task;
+        self.helping++;
+        while (pending.load(std::memory_order_acquire)) {
+            if (find(task))
+                execute(task);
+            else
+                std::this_thread::yield();
+        }
+        self.helping--;
+    }
+
+    void run(size_t index) {
+        current() = __current{this, index, 0};
+        size_t idle = 0;
+        __task *task;
+        for (;;) {
+            if (find(task)) {
+                execute(task);
+                idle = 0;
+                continue;
+            }
+            if (++idle < POOL_SPINS) {
+                std::this_thread::yield();
+                continue;
+            }
+            idle = 0;
+            std::unique_lock<std::mutex> guard(lock);
+            sleeping.fetch_add(1, std::memory_order_acq_rel);
+            if (!stop && !has_work()) wake.wait(guard);
+            sleeping.fetch_sub(1, std::memory_order_relaxed);
+            if (stop) return;
+        }
+    }
+};
+
+/**
+ * fork/join：spawn() 的任务可能在任意线程上执行，sync() 返回时本组 spawn 的任务全部完成。
+ * 任务里可以再建自己的 task_group，嵌套任意层。析构时隐式 sync()。
+ */
+class task_group {
+public:
+    explicit task_group(thread_pool &p = thread_pool::instance()) : pool(p), pending(0) {}
+    ~task_group() { sync(); }
+
+    task_group(const task_group &) = delete;
+    task_group &operator=(const task_group &) = delete;
+
+    template <typename Fn>
+    void spawn(Fn fn) {
+        __task *task = new __task_fn<Fn>(std::move(fn));
+        task->pending = &pending;
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.push(task);
+    }
+
+    void sync() {
+        pool.help(pending);
+    }
+
+private:
+    thread_pool         &pool;
+    std::atomic<size_t>  pending;
+};
+
+/* fork 为真时 a 交给线程池，与调用者线程上的 b 同时执行，否则依次执行；两者都结束后返回 */
+template <typename A, typename B>
+void __parallel_do(bool fork, A a, B b) {
+    if (!fork) {
+        a();
+        b();
+        return;
+    }
+    task_group group;
+    group.spawn(a);
+    b();
+    group.sync();
+}
+
+/**
+ * 把 pieces 个有序的块交给线程池，part(i, acc) 把第 i 块的元素依次折叠进 acc 并返回是否遇到过元素。
+ * 各块的部分结果最后按下标顺序从 init 开始用 reduce 折叠，
+ * 因此只要 reduce 满足结合律，结果与顺序遍历相同，且与线程调度无关。
+ */
+template <typename T, typename Part, typename Reduce>
+T __ordered_reduce(thread_pool &pool, size_t pieces, T init, Part part, Reduce reduce) {
+    struct slot {       /* 不用 vector<T>，T 为 bool 时相邻元素共用一个字节 */
+        T    value;
+        bool has;
+    };
+    std::vector<slot> partial(pieces, slot{init, false});
+    task_group group(pool);
+    for (size_t i = 0; i < pieces; i++)
+        group.spawn([&, i]() { partial[i].has = part(i, partial[i].value); });
+    group.sync();
+
+    T acc = init;
+    for (size_t i = 0; i < pieces; i++)
+        if (partial[i].has) acc = reduce(acc, partial[i].value);
+    return acc;
+}
+
+/* 按下标连续存放的元素 first[0, n)，均分成块，live(entry) 为 false 的元素（墓碑）跳过 */
+template <typename Entry, typename Fn, typename Live>
+void __array_for_each(thread_pool &pool, Entry *first, size_t n, Fn fn, Live live) {
+    size_t pieces = (pool.size() + 1) * PARALLEL_SPLIT;
+    task_group group(pool);
+    for (size_t i = 0; i < pieces; i++)
+        group.spawn([=, &fn, &live]() {
+            for (size_t j = n * i / pieces; j < n * (i + 1) / pieces; j++)
+                if (live(first[j])) fn(first[j].key, first[j].value);
+        });
+    group.sync();
+}
+
+template <typename Entry, typename T, typename Map, typename Reduce, typename Live>
+T __array_reduce(thread_pool &pool, Entry *first, size_t n, T init, Map map_fn, Reduce reduce_fn,
+                 Live live) {
+    size_t pieces = (pool.size() + 1) * PARALLEL_SPLIT;
+    return __ordered_reduce(pool, pieces, init, [&](size_t i, T &acc) {
+        bool has = false;
+        for (size_t j = n * i / pieces; j < n * (i + 1) / pieces; j++) {
+            if (!live(first[j])) continue;
+            acc = has ? reduce_fn(acc, map_fn(first[j].key, first[j].value))
+                      : map_fn(first[j].key, first[j].value);
+            has = true;
+        }
+        return has;
+    }, reduce_fn);
+}
+
+#endif
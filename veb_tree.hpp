@@ -0,0 +1,195 @@
+/**
+ * @file veb_tree.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief immutable map in van Emde Boas layout, exported from any bst_map
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * https://erikdemaine.org/papers/FOCS2000b/paper.pdf
+ * https://arxiv.org/abs/1509.05053
+ */
+#ifndef __VAN_EMDE_BOAS_TREE_HPP__
+#define __VAN_EMDE_BOAS_TREE_HPP__
+#include "bst.hpp"
+
+#include <stdint.h>
+
+const char *VEB_TREE = "veb ";
+
+/**
+ * 只读快照。所有键值对按中序存放在 entries 中，用于迭代和返回结果；
+ * 另有一份只含键和孩子下标的索引树，按 van Emde Boas 顺序排布：
+ * 高度为 h 的子树拆成上半部 h/2 层和下面若干棵子树，各自递归地连续存放，
+ * 因此无论缓存行、页还是 TLB 的块大小是多少，一次查找只会触碰 O(log_B n) 个块。
+ *
+ * 索引树的形状固定为对中序区间 [lo, hi) 取中点 lo + (hi - lo) / 2 的二分树，
+ * 查找时顺带维护区间即可得到结果的中序下标，节点里不必存放 rank。
+ */
+template <typename keyType, typename valueType>
+class veb_map {
+public:
+    typedef keyType                         key_type;
+    typedef valueType                       value_type;
+
+    struct entry {
+        key_type   key;
+        value_type value;
+    };
+
+    typedef const entry *iterator;
+
+    entry  *entries;
+    size_t  size;
+
+    explicit veb_map(bst_map<keyType, valueType> &tree)
+        : entries(nullptr), size(tree.size), index(nullptr) {
+        assert(size < UINT32_MAX);
+        entries = new entry[size ? size : 1];
+        index = new index_node[size ? size : 1];
+
+        size_t n = 0;
+        for (auto i = tree.begin(); i != tree.end(); ++i, ++n) {
+            entries[n].key = i.node->key;
+            entries[n].value = i.node->value;
+        }
+        assert(n == size);
+        if (size) build();
+    }
+
+    ~veb_map() {
+        delete [] entries;
+        delete [] index;
+    }
+
+    /* 第一个不小于 key 的位置 */
+    iterator lower_bound(const keyType &key) const {
+        size_t lo = 0, hi = size, result = size;
+        uint32_t slot = 0;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            const index_node &node = index[slot];
+            if (!(node.key < key)) {
+                result = mid;
+                hi = mid;
+                slot = node.left;
+            } else {
+                lo = mid + 1;
+                slot = node.right;
+            }
+        }
+        return entries + result;
+    }
+
+    const entry *find(const keyType &key) const {
+        iterator pos = lower_bound(key);
+        if (pos != end() && !(key < pos->key)) return pos;
+        return nullptr;
+    }
+
+    iterator begin() const { return entries; }
+    iterator end() const { return entries + size; }
+
+    bool empty() const { return 0 == size; }
+
+    /* 元素按下标连续存放，按下标均分，块之间仍是键的顺序 */
+    template <typename Fn>
+    void parallel_for_each(Fn fn, thread_pool &pool = thread_pool::instance()) const {
+        __array_for_each(pool, entries, size, fn, [](const entry &) { return true; });
+    }
+
+    template <typename T, typename Map, typename Reduce>
+    T parallel_reduce(T init, Map map_fn, Reduce reduce_fn, thread_pool &pool = thread_pool::instance()) const {
+        return __array_reduce(pool, entries, size, init, map_fn, reduce_fn, [](const entry &) { return true; });
+    }
+
+    /* 索引是 metadata：每个元素再多一个 index_node */
+    map_memory memory_usage() const {
+        size_t slots = size ? size : 1;
+        map_memory m;
+        m.nodes = size * sizeof(entry);
+        m.slack = (slots - size) * sizeof(entry);
+        m.overhead = malloc_overhead(slots * sizeof(entry)) + malloc_overhead(slots * sizeof(index_node));
+        m.metadata = sizeof(*this) + slots * sizeof(index_node);
+        return m;
+    }
+
+    const char *name() const {
+        return VEB_TREE;
+    }
+
+private:
+    struct index_node {
+        key_type key;
+        uint32_t left;
+        uint32_t right;
+    };
+
+    /* 中序区间 [lo, hi) 对应的子树 */
+    struct range {
+        size_t lo, hi;
+    };
+
+    index_node *index;
+
+    static size_t range_height(size_t n) {
+        size_t h = 0;
+        while (n) {
+            n >>= 1;
+            h++;
+        }
+        return h;
+    }
+
+    /**
+     * 把子树 r 的前 h 层按 vEB 顺序写入 index[*next...]，挂在第 h 层之下的
+     * 非空子树按从左到右的顺序追加到 below 中，slot_of 记录每个 rank 的位置。
+     */
+    void layout(range r, size_t h, uint32_t *slot_of, uint32_t *next,
+                std::vector<range> &below) {
+        if (r.lo >= r.hi) return;
+        if (1 == h) {
+            size_t mid = r.lo + (r.hi - r.lo) / 2;
+            slot_of[mid] = (*next)++;
+            if (r.lo < mid) below.push_back(range{r.lo, mid});
+            if (mid + 1 < r.hi) below.push_back(range{mid + 1, r.hi});
+            return;
+        }
+
+        size_t top = h / 2;
+        std::vector<range> middle;
+        layout(r, top, slot_of, next, middle);
+        for (size_t i = 0; i < middle.size(); i++)
+            layout(middle[i], h - top, slot_of, next, below);
+    }
+
+    void build() {
+        uint32_t next = 0;
+        uint32_t *slot_of = new uint32_t[size];
+        std::vector<range> below;
+        layout(range{0, size}, range_height(size), slot_of, &next, below);
+        assert(next == size && below.empty());
+
+        /* 按同样的二分形状连接孩子下标，显式栈代替递归 */
+        range stack[64 * 2];
+        size_t top = 0;
+        stack[top++] = range{0, size};
+        while (top) {
+            range r = stack[--top];
+            size_t mid = r.lo + (r.hi - r.lo) / 2;
+            index_node &node = index[slot_of[mid]];
+            node.key = entries[mid].key;
+            node.left = node.right = 0;
+            if (r.lo < mid) {
+                node.left = slot_of[r.lo + (mid - r.lo) / 2];
+                stack[top++] = range{r.lo, mid};
+            }
+            if (mid + 1 < r.hi) {
+                node.right = slot_of[mid + 1 + (r.hi - mid - 1) / 2];
+                stack[top++] = range{mid + 1, r.hi};
+            }
+        }
+        delete [] slot_of;
+    }
+};
+
+#endif
@@ -0,0 +1,235 @@
+/**
+ * @file workload.hpp
+ * @author luuyiran (luuyiran@gmail.com)
+ * @brief seeded key distributions and YCSB-style operation mixes for the benchmark
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * B. F. Cooper et al. Benchmarking Cloud Serving Systems with YCSB. SoCC 2010.
+ * D. Blackman, S. Vigna. Scrambled Linear Pseudorandom Number Generators. 2018.
+ */
+#ifndef __WORKLOAD_HPP__
+#define __WORKLOAD_HPP__
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#define ZIPF_THETA      0.99
+#define CLUSTER_SIZE    64
+#define YCSB_MAX_SCAN   100
+
+/* 键的分布 */
+enum key_dist {
+    KEY_UNIFORM,            /* 64 位均匀随机 */
+    KEY_ZIPF,               /* Zipfian 名次经 mix64() 打散，热点散落在键空间里，有重复 */
+    KEY_ASCENDING,
+    KEY_DESCENDING,
+    KEY_NEARLY_SORTED,      /* 递增序列中 1% 的位置与 8 步以内的邻居交换 */
+    KEY_CLUSTERED,          /* 每 CLUSTER_SIZE 个连续的键一簇，簇的起点随机 */
+    KEY_DISTS
+};
+
+const char *const KEY_DIST_NAMES[KEY_DISTS] = {
+    "uniform", "zipf", "ascending", "descending", "nearly", "clustered"
+};
+
+/* splitmix64 的末端混合，64 位整数上的双射，用来把名次或序号打散成键 */
+inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t splitmix64(uint64_t &state) {
+    return mix64(state += 0x9e3779b97f4a7c15ull);
+}
+
+/* xoshiro256**，状态由 splitmix64 从一个 64 位种子展开 */
+struct xoshiro256 {
+    uint64_t s[4];
+
+    explicit xoshiro256(uint64_t seed) {
+        for (int i = 0; i < 4; i++) s[i] = splitmix64(seed);
+    }
+
+    uint64_t operator()() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    /* [0, n) 上均匀（Lemire 乘法取高位，偏差可忽略） */
+    uint64_t below(uint64_t n) {
+        return (uint64_t)(((__uint128_t)(*this)() * n) >> 64);
+    }
+
+    /* [0, 1) 上均匀 */
+    double uniform() {
+        return ((*this)() >> 11) * 0x1.0p-53;
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+/**
+ * YCSB 的 Zipfian 分布（Gray et al., SIGMOD 1994），返回 [0, n) 中的名次，0 最热。
+ * 构造时 O(n) 预计算 zeta(n)。
+ */
+struct zipf_gen {
+    size_t n;
+    double theta, zetan, alpha, eta, half;
+
+    explicit zipf_gen(size_t items, double skew = ZIPF_THETA) : n(items), theta(skew) {
+        zetan = 0;
+        for (size_t i = 1; i <= n; i++)
+            zetan += 1 / pow((double)i, theta);
+        half = 1 + pow(0.5, theta);
+        alpha = 1 / (1 - theta);
+        eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - half / zetan);
+    }
+
+    /* u 在 [0, 1) 上均匀 */
+    size_t operator()(double u) const {
+        double uz = u * zetan;
+        if (uz < 1) return 0;
+        if (uz < half) return 1;
+        size_t r = (size_t)(n * pow(eta * u - eta + 1, alpha));
+        return r < n ? r : n - 1;
+    }
+
+    size_t operator()(xoshiro256 &rng) const {
+        return (*this)(rng.uniform());
+    }
+};
+
+/* n 个键，按分布 dist 生成；KEY_ZIPF 的偏斜为 theta */
+inline std::vector<uint64_t> make_keys(key_dist dist, size_t n, uint64_t seed, double theta = ZIPF_THETA) {
+    std::vector<uint64_t> keys(n);
+    xoshiro256 rng(seed);
+    switch (dist) {
+    case KEY_UNIFORM:
+        for (auto &k : keys) k = rng();
+        break;
+    case KEY_ZIPF: {
+        zipf_gen z(n, theta);
+        for (auto &k : keys) k = mix64(z(rng));
+        break;
+    }
+    case KEY_ASCENDING:
+        for (size_t i = 0; i < n; i++) keys[i] = i;
+        break;
+    case KEY_DESCENDING:
+        for (size_t i = 0; i < n; i++) keys[i] = n - 1 - i;
+        break;
+    case KEY_NEARLY_SORTED:
+        for (size_t i = 0; i < n; i++) keys[i] = i;
+        for (size_t i = 0; n > 1 && i < n / 100; i++) {
+            size_t x = rng.below(n), y = x + 1 + rng.below(8);
+            std::swap(keys[x], keys[y < n ? y : n - 1]);
+        }
+        break;
+    case KEY_CLUSTERED: {
+        uint64_t base = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (0 == i % CLUSTER_SIZE) base = rng() & ~(uint64_t)(CLUSTER_SIZE - 1);
+            keys[i] = base + i % CLUSTER_SIZE;
+        }
+        break;
+    }
+    default:
+        keys.clear();
+    }
+    return keys;
+}
+
+/* n 个形如 "user" + 16 位十六进制的随机串 */
+inline std::vector<std::string> make_string_keys(size_t n, uint64_t seed) {
+    std::vector<std::string> keys;
+    xoshiro256 rng(seed);
+    char buf[21];
+    keys.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "user%016llx", (unsigned long long)rng());
+        keys.emplace_back(buf);
+    }
+    return keys;
+}
+
+/* YCSB 的操作 */
+enum ycsb_type { YCSB_READ, YCSB_UPDATE, YCSB_INSERT, YCSB_SCAN, YCSB_RMW };
+
+struct ycsb_op {
+    ycsb_type type;
+    uint64_t  key;
+    size_t    scan;     /* YCSB_SCAN 的长度 */
+};
+
+/**
+ * workload 'A' ~ 'F'：
+ *   A 50% read  50% update        zipfian
+ *   B 95% read   5% update        zipfian
+ *   C 100% read                   zipfian
+ *   D 95% read   5% insert        latest，越新插入的越热
+ *   E 95% scan   5% insert        zipfian，长度在 [1, YCSB_MAX_SCAN] 上均匀
+ *   F 50% read  50% rmw           zipfian
+ * 预先装载的第 i 条记录的键是 key(i)，insert 依次追加 key(records), key(records + 1) ...
+ * 未知的 workload 当作 C。
+ */
+class ycsb_workload {
+public:
+    ycsb_workload(char workload, size_t records, uint64_t seed)
+        : latest('D' == workload), count(records), zipf(records), rng(seed) {
+        static const int mixes[6][5] = {
+            /* read update insert scan rmw */
+            {50, 50, 0, 0, 0},
+            {95, 5, 0, 0, 0},
+            {100, 0, 0, 0, 0},
+            {95, 0, 5, 0, 0},
+            {0, 0, 5, 95, 0},
+            {50, 0, 0, 0, 50},
+        };
+        int w = workload >= 'A' && workload <= 'F' ? workload - 'A' : 2;
+        for (int i = 0; i < 5; i++) percent[i] = mixes[w][i];
+    }
+
+    static uint64_t key(size_t i) { return mix64(i); }
+
+    /* 已有的记录数，包括 insert 追加的 */
+    size_t records() const { return count; }
+
+    ycsb_op next() {
+        ycsb_op op;
+        int type = 0, dice = (int)rng.below(100);
+        while (dice >= percent[type]) dice -= percent[type++];
+        op.type = (ycsb_type)type;
+        op.scan = 0;
+        if (YCSB_INSERT == op.type) {
+            op.key = key(count++);
+            return op;
+        }
+        /* latest：名次 0 是最新插入的记录 */
+        size_t rank = zipf(rng);
+        op.key = latest ? key(count - 1 - (rank < count ? rank : count - 1)) : key(rank);
+        if (YCSB_SCAN == op.type)
+            op.scan = 1 + rng.below(YCSB_MAX_SCAN);
+        return op;
+    }
+
+private:
+    int         percent[5];     /* 按 YCSB_READ ... YCSB_RMW 的比例 */
+    bool        latest;
+    size_t      count;
+    zipf_gen    zipf;
+    xoshiro256  rng;
+};
+
+#endif